@@ -38,6 +38,13 @@ public:
 	 */
 	size_t size() const;
 
+	/**
+	 * @brief Prepares the maps for `count` elements, so inserting them doesn't rehash
+	 * 
+	 * @param count Expected number of elements
+	 */
+	void reserve(size_t count);
+
 	/**
 	 * @brief Insert pair `<K1, K2>`
 	 * 
@@ -122,6 +129,13 @@ inline size_t UnorderedBimap<K1, K2>::size() const
 	return data_.size();
 }
 
+template<typename K1, typename K2> requires (!std::is_same_v<K1, K2>)
+void UnorderedBimap<K1, K2>::reserve(size_t count)
+{
+	k1ToK2_.reserve(count);
+	k2ToK1_.reserve(count);
+}
+
 template<typename K1, typename K2> requires (!std::is_same_v<K1, K2>)
 bool UnorderedBimap<K1, K2>::insert(const K1& key1, const K2& key2)
 {
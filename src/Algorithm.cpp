@@ -1,4 +1,7 @@
 #include <Algorithm.hpp>
+#include <ConnectionScan.hpp>
+#include <TripBased.hpp>
+#include <TransferPatterns.hpp>
 #include <array>
 #include <limits>
 #include <vector>
@@ -7,40 +10,39 @@
 #include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <functional>
+#include <ranges>
+#include <bit>
+#include <atomic>
 
 namespace raptor
 {
-    RouteFinder::RouteFinder(const gtfs::Feed* feed) : num_stops_(feed->get_stops().size()), feed_(feed)
+    RouteFinder::RouteFinder(const gtfs::Feed* feed, const double transfer_radius) : num_stops_(feed->get_stops().size()), feed_(feed)
     {
-        auto [rd, sd] = GTFSFeedParser::parseFeed(*feed_);
+        buildTimetables(GTFSFeedParser::parseFeed(*feed_, transfer_radius));
+    }
+
+    RouteFinder::RouteFinder(const gtfs::Feed* feed, std::istream& stop_times, const double transfer_radius) : num_stops_(feed->get_stops().size()), feed_(feed)
+    {
+        buildTimetables(GTFSFeedParser::parseFeed(*feed_, stop_times, transfer_radius));
+    }
+
+    RouteFinder::RouteFinder(const gtfs::Feed* feed, const std::filesystem::path& stop_times, const double transfer_radius) : num_stops_(feed->get_stops().size()), feed_(feed)
+    {
+        buildTimetables(GTFSFeedParser::parseFeed(*feed_, stop_times, transfer_radius));
+    }
+
+    void RouteFinder::buildTimetables(Data data)
+    {
+        auto&& [rd, sd] = data;
         rt_ = std::move(rd);
         stops_ = std::move(sd);
+        calendar_ = ServiceCalendar(*feed_);
     }
     
     Time_t RouteFinder::distanceToTime(const double distance, WalkingSpeed speed)
     {
-        // seconds per km
-        short pace;
-        // error to account for longer real distance
-        constexpr double error = 1.2;
-        switch (speed)
-        {
-        case WalkingSpeed::Slow:
-            // 4 km/h
-            pace = 15*60;
-            break;
-        case WalkingSpeed::Normal:
-            // 5 km/h
-            pace = 12*60;
-            break;
-        case WalkingSpeed::Fast:
-            // 6 km/h
-            pace = 10*60;
-            break;
-        default:
-            pace = std::numeric_limits<short>::max();
-        }
-        return std::round(distance * pace * error);
+        return walkingTime(distance, speed);
     }
     
     void RouteFinder::setOptions(const WalkingSpeed new_speed, const std::string& service_id)
@@ -50,197 +52,1205 @@ namespace raptor
             if (!checkServiceIdInFeed(service_id))
                 throw IdException(service_id);
             options_.wanted_service_id = service_id;
+            getTimetable(IdTranslator::getInstance().at(service_id, IdTranslator::ServiceTag()));
         }
         options_.preferred_walking_speed = new_speed;
+        // connection scan engines have walking times of footpaths precomputed
+        std::lock_guard lock(timetables_mutex_);
+        engines_.clear();
+    }
+
+    void RouteFinder::setEngine(const Engine engine)
+    {
+        options_.engine = engine;
+        std::lock_guard lock(timetables_mutex_);
+        engines_.clear();
+    }
+
+    void RouteFinder::setGoalDirected(const bool goal_directed)
+    {
+        options_.goal_directed = goal_directed;
+    }
+
+    void RouteFinder::setScanThreads(const size_t thread_count, const size_t min_routes)
+    {
+        options_.scan_threads = thread_count;
+        parallel_scan_routes_ = min_routes;
+        scan_pool_ = thread_count == 1 ? nullptr : std::make_unique<ThreadPool>(thread_count);
+    }
+
+    const RoutingEngine& RouteFinder::getEngine(const ServiceId service) const
+    {
+        const ServiceTimetable& timetable = getTimetable(service);
+        EngineSlot* slot;
+        {
+            std::lock_guard lock(timetables_mutex_);
+            auto&& stored = engines_[service];
+            if (!stored)
+                stored = std::make_unique<EngineSlot>();
+            slot = stored.get();
+        }
+        // other services can be queried while this one precomputes
+        std::call_once(slot->built, [&]()
+        {
+            if (options_.engine == Engine::ConnectionScan)
+                slot->engine = std::make_unique<ConnectionScanEngine>(timetable.routes, timetable.stops, options_.preferred_walking_speed);
+            else if (options_.engine == Engine::TripBased)
+                slot->engine = std::make_unique<TripBasedEngine>(timetable.routes, timetable.stops, options_.preferred_walking_speed);
+            else if (options_.engine == Engine::TransferPatterns)
+                slot->engine = std::make_unique<TransferPatternsEngine>(timetable.routes, timetable.stops, options_.preferred_walking_speed);
+            else
+                slot->engine = std::make_unique<RaptorEngine>(*this, timetable);
+        });
+        return *slot->engine;
+    }
+
+    template<typename E>
+    void RouteFinder::saveEngine(const Engine kind, std::ostream& out) const
+    {
+        const ServiceId service = IdTranslator::getInstance().at(options_.wanted_service_id, IdTranslator::ServiceTag());
+        if (options_.engine == kind)
+        {
+            static_cast<const E&>(getEngine(service)).save(out);
+            return;
+        }
+        const ServiceTimetable& timetable = getTimetable(service);
+        E(timetable.routes, timetable.stops, options_.preferred_walking_speed).save(out);
+    }
+
+    template<typename E>
+    void RouteFinder::loadEngine(const Engine kind, std::istream& in)
+    {
+        const ServiceId service = IdTranslator::getInstance().at(options_.wanted_service_id, IdTranslator::ServiceTag());
+        const ServiceTimetable& timetable = getTimetable(service);
+        auto slot = std::make_unique<EngineSlot>();
+        std::call_once(slot->built, [&]()
+        {
+            slot->engine = std::make_unique<E>(timetable.routes, timetable.stops, options_.preferred_walking_speed, in);
+        });
+        std::lock_guard lock(timetables_mutex_);
+        if (options_.engine != kind)
+            engines_.clear();
+        options_.engine = kind;
+        engines_[service] = std::move(slot);
+    }
+
+    void RouteFinder::saveTripTransfers(std::ostream& out) const
+    {
+        saveEngine<TripBasedEngine>(Engine::TripBased, out);
+    }
+
+    void RouteFinder::loadTripTransfers(std::istream& in)
+    {
+        loadEngine<TripBasedEngine>(Engine::TripBased, in);
+    }
+
+    void RouteFinder::saveTransferPatterns(std::ostream& out) const
+    {
+        saveEngine<TransferPatternsEngine>(Engine::TransferPatterns, out);
+    }
+
+    void RouteFinder::loadTransferPatterns(std::istream& in)
+    {
+        loadEngine<TransferPatternsEngine>(Engine::TransferPatterns, in);
+    }
+
+    std::variant<path_t, std::string> RaptorEngine::findRoute(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure) const
+    {
+        thread_local QueryWorkspace workspace;
+        return findRoute(starts, ends, departure, workspace);
+    }
+
+    std::variant<path_t, std::string> RaptorEngine::findRoute(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure, QueryWorkspace& workspace) const
+    {
+        const RouteTraversal& routes = timetable_.routes;
+        // every trip in the timetable has the wanted service
+        auto find_trip = [&](const RouteId route, const size_t stop_index, const Time_t time)
+        {
+            return routes.earliestTripIndex(route, stop_index, time);
+        };
+        return finder_.search(routes, timetable_.stops, starts, ends, departure, workspace, find_trip, finder_.options_.goal_directed ? &bounds_ : nullptr);
+    }
+
+    const ServiceTimetable& RouteFinder::getTimetable(ServiceId service) const
+    {
+        std::lock_guard lock(timetables_mutex_);
+        auto&& timetable = timetables_[service];
+        if (!timetable)
+            timetable = std::make_unique<ServiceTimetable>(rt_, stops_, service);
+        return *timetable;
     }
     
+    const ReversedTimetable& RouteFinder::getReversedTimetable(ServiceId service) const
+    {
+        const ServiceTimetable& timetable = getTimetable(service);
+        std::lock_guard lock(timetables_mutex_);
+        if (!timetable.reversed)
+            timetable.reversed = std::make_unique<ReversedTimetable>(timetable.routes, timetable.stops);
+        return *timetable.reversed;
+    }
+
+    const RouteTraversal& RouteFinder::getTimeline() const
+    {
+        std::lock_guard lock(timetables_mutex_);
+        if (!timeline_)
+            timeline_ = std::make_unique<RouteTraversal>(rt_, timeline_days, IdTranslator::getInstance().service_count());
+        return *timeline_;
+    }
+
+    const ReversedTimetable& RouteFinder::getReversedTimeline() const
+    {
+        const RouteTraversal& timeline = getTimeline();
+        std::lock_guard lock(timetables_mutex_);
+        if (!reversed_timeline_)
+            reversed_timeline_ = std::make_unique<ReversedTimetable>(timeline, stops_);
+        return *reversed_timeline_;
+    }
+
+    const LowerBoundGraph& RouteFinder::getTimelineBounds() const
+    {
+        const RouteTraversal& timeline = getTimeline();
+        std::lock_guard lock(timetables_mutex_);
+        if (!timeline_bounds_)
+            timeline_bounds_ = std::make_unique<LowerBoundGraph>(timeline, stops_);
+        return *timeline_bounds_;
+    }
+
     bool RouteFinder::checkServiceIdInFeed(const std::string& id) const
     {
         return feed_->get_calendar(id).has_value();
     }
     
     std::variant<RouteFinder::result_t, std::string> RouteFinder::findRoute(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure) const
+    {
+        thread_local QueryWorkspace workspace;
+        return findRoute(starts, ends, departure, workspace);
+    }
+
+    std::variant<RouteFinder::result_t, std::string> RouteFinder::findRoute(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure, QueryWorkspace& workspace) const
     {
         if (!checkServiceIdInFeed(options_.wanted_service_id))
             throw IdException(options_.wanted_service_id);
+        const RoutingEngine& engine = getEngine(IdTranslator::getInstance().at(options_.wanted_service_id, IdTranslator::ServiceTag()));
+        if (auto raptor = dynamic_cast<const RaptorEngine*>(&engine))
+            return raptor->findRoute(starts, ends, departure, workspace);
+        return engine.findRoute(starts, ends, departure);
+    }
+
+    std::variant<RouteFinder::result_t, std::string> RouteFinder::findRoute(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure, const std::chrono::year_month_day date) const
+    {
+        thread_local QueryWorkspace workspace;
+        return findRoute(starts, ends, departure, date, workspace);
+    }
+
+    std::variant<RouteFinder::result_t, std::string> RouteFinder::findRoute(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure, const std::chrono::year_month_day date, QueryWorkspace& workspace) const
+    {
+        if (!activateServices(date, workspace.active_services))
+            return "Date is outside of the feed validity period\n";
+        const ServiceSet& active = workspace.active_services;
+        const RouteTraversal& timeline = getTimeline();
+        auto find_trip = [&](const RouteId route, const size_t stop_index, const Time_t time)
+        {
+            return timeline.earliestTripIndex(route, stop_index, time, [&](const ServiceId service) { return active.contains(service); });
+        };
+        return search(timeline, stops_, starts, ends, departure, workspace, find_trip, options_.goal_directed ? &getTimelineBounds() : nullptr);
+    }
+
+    bool RouteFinder::activateServices(const std::chrono::year_month_day date, ServiceSet& active) const
+    {
+        const auto day = calendar_.dayIndex(date);
+        if (!day.has_value())
+            return false;
+        const size_t service_count = IdTranslator::getInstance().service_count();
+        active.reset(timeline_days * service_count);
+        for (size_t offset = 0; offset < timeline_days; ++offset)
+        {
+            // copies of trips on timeline day `offset` run on calendar day `day + offset - 1`
+            const size_t calendar_day = day.value() + offset;
+            if (calendar_day == 0 || calendar_day > calendar_.dayCount())
+                continue;
+            for (size_t service = 0; service < service_count; ++service)
+            {
+                if (calendar_.isActive(service, calendar_day - 1))
+                    active.insert(offset * service_count + service);
+            }
+        }
+        return true;
+    }
+
+    std::variant<RouteFinder::profile_t, std::string> RouteFinder::findRoutes(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t first_departure, const Time_t last_departure) const
+    {
+        thread_local QueryWorkspace workspace;
+        return findRoutes(starts, ends, first_departure, last_departure, workspace);
+    }
+
+    std::variant<RouteFinder::profile_t, std::string> RouteFinder::findRoutes(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t first_departure, const Time_t last_departure, QueryWorkspace& workspace) const
+    {
+        if (!checkServiceIdInFeed(options_.wanted_service_id))
+            throw IdException(options_.wanted_service_id);
+        const ServiceTimetable& timetable = getTimetable(IdTranslator::getInstance().at(options_.wanted_service_id, IdTranslator::ServiceTag()));
+        return searchRange(timetable.routes, timetable.stops, starts, ends, first_departure, last_departure, workspace, [](const ServiceId) { return true; });
+    }
+
+    std::variant<RouteFinder::profile_t, std::string> RouteFinder::findRoutes(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t first_departure, const Time_t last_departure, const std::chrono::year_month_day date) const
+    {
+        thread_local QueryWorkspace workspace;
+        return findRoutes(starts, ends, first_departure, last_departure, date, workspace);
+    }
+
+    std::variant<RouteFinder::profile_t, std::string> RouteFinder::findRoutes(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t first_departure, const Time_t last_departure, const std::chrono::year_month_day date, QueryWorkspace& workspace) const
+    {
+        if (!activateServices(date, workspace.active_services))
+            return "Date is outside of the feed validity period\n";
+        const ServiceSet& active = workspace.active_services;
+        return searchRange(getTimeline(), stops_, starts, ends, first_departure, last_departure, workspace, [&](const ServiceId service) { return active.contains(service); });
+    }
+
+    std::variant<RouteFinder::pareto_t, std::string> RouteFinder::findParetoRoutes(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure) const
+    {
+        thread_local QueryWorkspace workspace;
+        return findParetoRoutes(starts, ends, departure, workspace);
+    }
+
+    std::variant<RouteFinder::pareto_t, std::string> RouteFinder::findParetoRoutes(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure, QueryWorkspace& workspace) const
+    {
+        if (!checkServiceIdInFeed(options_.wanted_service_id))
+            throw IdException(options_.wanted_service_id);
+        const ServiceTimetable& timetable = getTimetable(IdTranslator::getInstance().at(options_.wanted_service_id, IdTranslator::ServiceTag()));
+        return searchPareto(timetable.routes, timetable.stops, starts, ends, departure, workspace, [](const ServiceId) { return true; });
+    }
+
+    std::variant<RouteFinder::pareto_t, std::string> RouteFinder::findParetoRoutes(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure, const std::chrono::year_month_day date) const
+    {
+        thread_local QueryWorkspace workspace;
+        return findParetoRoutes(starts, ends, departure, date, workspace);
+    }
+
+    std::variant<RouteFinder::pareto_t, std::string> RouteFinder::findParetoRoutes(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure, const std::chrono::year_month_day date, QueryWorkspace& workspace) const
+    {
+        if (!activateServices(date, workspace.active_services))
+            return "Date is outside of the feed validity period\n";
+        const ServiceSet& active = workspace.active_services;
+        return searchPareto(getTimeline(), stops_, starts, ends, departure, workspace, [&](const ServiceId service) { return active.contains(service); });
+    }
+
+    std::variant<RouteFinder::Journey, std::string> RouteFinder::findRouteArriveBy(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t arrival) const
+    {
+        thread_local QueryWorkspace workspace;
+        return findRouteArriveBy(starts, ends, arrival, workspace);
+    }
+
+    std::variant<RouteFinder::Journey, std::string> RouteFinder::findRouteArriveBy(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t arrival, QueryWorkspace& workspace) const
+    {
+        if (!checkServiceIdInFeed(options_.wanted_service_id))
+            throw IdException(options_.wanted_service_id);
+        const ServiceId service = IdTranslator::getInstance().at(options_.wanted_service_id, IdTranslator::ServiceTag());
+        const ServiceTimetable& timetable = getTimetable(service);
+        const ReversedTimetable& reversed = getReversedTimetable(service);
+        const RouteTraversal& routes = reversed.routes;
+        auto find_trip = [&](const RouteId route, const size_t stop_index, const Time_t time)
+        {
+            return routes.earliestTripIndex(route, stop_index, time);
+        };
+        // the reversed search goes from the end stops to the start stops
+        auto found = search(routes, reversed.stops, ends, starts, reversedDeparture(arrival), workspace, find_trip);
+        if (std::holds_alternative<std::string>(found))
+            return std::get<std::string>(found);
+        return forwardJourney(timetable.routes, reversed, std::get<result_t>(found), arrival);
+    }
+
+    std::variant<RouteFinder::Journey, std::string> RouteFinder::findRouteArriveBy(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t arrival, const std::chrono::year_month_day date) const
+    {
+        thread_local QueryWorkspace workspace;
+        return findRouteArriveBy(starts, ends, arrival, date, workspace);
+    }
+
+    std::variant<RouteFinder::Journey, std::string> RouteFinder::findRouteArriveBy(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t arrival, const std::chrono::year_month_day date, QueryWorkspace& workspace) const
+    {
+        if (!activateServices(date, workspace.active_services))
+            return "Date is outside of the feed validity period\n";
+        const ServiceSet& active = workspace.active_services;
+        const ReversedTimetable& reversed = getReversedTimeline();
+        const RouteTraversal& routes = reversed.routes;
+        auto find_trip = [&](const RouteId route, const size_t stop_index, const Time_t time)
+        {
+            return routes.earliestTripIndex(route, stop_index, time, [&](const ServiceId service) { return active.contains(service); });
+        };
+        auto found = search(routes, reversed.stops, ends, starts, reversedDeparture(arrival), workspace, find_trip);
+        if (std::holds_alternative<std::string>(found))
+            return std::get<std::string>(found);
+        return forwardJourney(getTimeline(), reversed, std::get<result_t>(found), arrival);
+    }
+
+    std::vector<Time_t> RouteFinder::latestDepartures(const std::vector<StopId>& ends, const Time_t arrival) const
+    {
+        thread_local QueryWorkspace workspace;
+        return latestDepartures(ends, arrival, workspace);
+    }
+
+    std::vector<Time_t> RouteFinder::latestDepartures(const std::vector<StopId>& ends, const Time_t arrival, QueryWorkspace& workspace) const
+    {
+        if (!checkServiceIdInFeed(options_.wanted_service_id))
+            throw IdException(options_.wanted_service_id);
+        const ServiceId service = IdTranslator::getInstance().at(options_.wanted_service_id, IdTranslator::ServiceTag());
+        const ReversedTimetable& reversed = getReversedTimetable(service);
+        const RouteTraversal& routes = reversed.routes;
+        auto find_trip = [&](const RouteId route, const size_t stop_index, const Time_t time)
+        {
+            return routes.earliestTripIndex(route, stop_index, time);
+        };
+        const Time_t departure = reversedDeparture(arrival);
+        // nothing is pruned, every stop gets its latest departure
+        runRounds(routes, reversed.stops, ends, departure, workspace, find_trip, [&](const size_t) { return inf_time - departure; });
+        return readLatestDepartures(workspace, arrival);
+    }
+
+    std::vector<Time_t> RouteFinder::latestDepartures(const std::vector<StopId>& ends, const Time_t arrival, const std::chrono::year_month_day date) const
+    {
+        thread_local QueryWorkspace workspace;
+        return latestDepartures(ends, arrival, date, workspace);
+    }
+
+    std::vector<Time_t> RouteFinder::latestDepartures(const std::vector<StopId>& ends, const Time_t arrival, const std::chrono::year_month_day date, QueryWorkspace& workspace) const
+    {
+        if (!activateServices(date, workspace.active_services))
+            return std::vector<Time_t>(num_stops_, undefined_time);
+        const ServiceSet& active = workspace.active_services;
+        const ReversedTimetable& reversed = getReversedTimeline();
+        const RouteTraversal& routes = reversed.routes;
+        auto find_trip = [&](const RouteId route, const size_t stop_index, const Time_t time)
+        {
+            return routes.earliestTripIndex(route, stop_index, time, [&](const ServiceId service) { return active.contains(service); });
+        };
+        const Time_t departure = reversedDeparture(arrival);
+        runRounds(routes, reversed.stops, ends, departure, workspace, find_trip, [&](const size_t) { return inf_time - departure; });
+        return readLatestDepartures(workspace, arrival);
+    }
+
+    RouteFinder::Arrivals RouteFinder::earliestArrivals(const std::vector<StopId>& starts, const Time_t departure, const bool count_trips) const
+    {
+        thread_local QueryWorkspace workspace;
+        return earliestArrivals(starts, departure, workspace, count_trips);
+    }
+
+    RouteFinder::Arrivals RouteFinder::earliestArrivals(const std::vector<StopId>& starts, const Time_t departure, QueryWorkspace& workspace, const bool count_trips) const
+    {
+        return earliestArrivals(starts, {}, departure, workspace, count_trips);
+    }
+
+    RouteFinder::Arrivals RouteFinder::earliestArrivals(const std::vector<StopId>& starts, const Time_t departure, const std::chrono::year_month_day date, const bool count_trips) const
+    {
+        thread_local QueryWorkspace workspace;
+        return earliestArrivals(starts, departure, date, workspace, count_trips);
+    }
+
+    RouteFinder::Arrivals RouteFinder::earliestArrivals(const std::vector<StopId>& starts, const Time_t departure, const std::chrono::year_month_day date, QueryWorkspace& workspace, const bool count_trips) const
+    {
+        return earliestArrivals(starts, {}, departure, date, workspace, count_trips);
+    }
+
+    RouteFinder::Arrivals RouteFinder::earliestArrivals(const std::vector<StopId>& starts, const std::vector<StopId>& targets, const Time_t departure, const bool count_trips) const
+    {
+        thread_local QueryWorkspace workspace;
+        return earliestArrivals(starts, targets, departure, workspace, count_trips);
+    }
+
+    RouteFinder::Arrivals RouteFinder::earliestArrivals(const std::vector<StopId>& starts, const std::vector<StopId>& targets, const Time_t departure, QueryWorkspace& workspace, const bool count_trips) const
+    {
+        if (!checkServiceIdInFeed(options_.wanted_service_id))
+            throw IdException(options_.wanted_service_id);
+        const ServiceTimetable& timetable = getTimetable(IdTranslator::getInstance().at(options_.wanted_service_id, IdTranslator::ServiceTag()));
+        const RouteTraversal& routes = timetable.routes;
+        auto find_trip = [&](const RouteId route, const size_t stop_index, const Time_t time)
+        {
+            return routes.earliestTripIndex(route, stop_index, time);
+        };
+        return searchArrivals(routes, timetable.stops, starts, targets, departure, workspace, find_trip, count_trips);
+    }
+
+    RouteFinder::Arrivals RouteFinder::earliestArrivals(const std::vector<StopId>& starts, const std::vector<StopId>& targets, const Time_t departure, const std::chrono::year_month_day date, const bool count_trips) const
+    {
+        thread_local QueryWorkspace workspace;
+        return earliestArrivals(starts, targets, departure, date, workspace, count_trips);
+    }
+
+    RouteFinder::Arrivals RouteFinder::earliestArrivals(const std::vector<StopId>& starts, const std::vector<StopId>& targets, const Time_t departure, const std::chrono::year_month_day date, QueryWorkspace& workspace, const bool count_trips) const
+    {
+        if (!activateServices(date, workspace.active_services))
+        {
+            const size_t size = targets.empty() ? num_stops_ : targets.size();
+            return Arrivals{ std::vector<Time_t>(size, inf_time), count_trips ? std::vector<size_t>(size, RoundLabels::npos) : std::vector<size_t>() };
+        }
+        const ServiceSet& active = workspace.active_services;
+        const RouteTraversal& timeline = getTimeline();
+        auto find_trip = [&](const RouteId route, const size_t stop_index, const Time_t time)
+        {
+            return timeline.earliestTripIndex(route, stop_index, time, [&](const ServiceId service) { return active.contains(service); });
+        };
+        return searchArrivals(timeline, stops_, starts, targets, departure, workspace, find_trip, count_trips);
+    }
+
+    template<typename F>
+    RouteFinder::Arrivals RouteFinder::searchArrivals(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& starts, const std::vector<StopId>& targets, const Time_t departure, QueryWorkspace& workspace, F&& find_trip, const bool count_trips) const
+    {
         const Time_t new_inf_time = inf_time - departure;
-        constexpr Time_t day = 24*60*60;
-        const auto w_speed = options_.preferred_walking_speed;
-        const Time_t max_travel_time = 10*60;
-        std::vector<std::vector<std::tuple<Time_t, StopId, std::optional<RouteTraversal::trip_iterator>>>> labels;
-        std::vector<Time_t> earliest_arrival(num_stops_, new_inf_time);
-        std::tuple<Time_t, StopId, size_t> earliest_arrival_end(new_inf_time, undefined::stop, 0);
-        earliest_arrival.shrink_to_fit();
-        std::vector<bool> marked(num_stops_, false);
-        marked.shrink_to_fit();
-        std::unordered_map<RouteId, StopId> potential_routes;
-        labels.emplace_back(num_stops_, std::tuple(new_inf_time, undefined::stop, std::nullopt));
-        labels[0].shrink_to_fit();
-        size_t num_marked = 0;
-        for (auto&& start : starts)
+        auto& earliest_arrival = workspace.earliest_arrival;
+        // a label later than every target can't improve any of them
+        auto end_bound = [&](const size_t)
         {
-            std::get<0>(labels[0][start]) = 0;
-            earliest_arrival[start] = 0;
-            marked[start] = true;        // mark starting stop
-            ++num_marked;
+            Time_t latest = targets.empty() ? new_inf_time : 0;
+            for (auto&& target : targets)
+                latest = std::max(latest, std::min(earliest_arrival[target], new_inf_time));
+            return latest;
+        };
+        runRounds(routes, stops, starts, departure, workspace, find_trip, end_bound);
+        return readArrivals(workspace, targets, departure, count_trips);
+    }
+
+    RouteFinder::Arrivals RouteFinder::readArrivals(const QueryWorkspace& workspace, const std::vector<StopId>& stops, const Time_t departure, const bool count_trips) const
+    {
+        Arrivals result;
+        const size_t size = stops.empty() ? num_stops_ : stops.size();
+        result.arrivals.reserve(size);
+        if (count_trips)
+            result.trips.reserve(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            const StopId stop = stops.empty() ? StopId(i) : stops[i];
+            const Time_t relative = workspace.earliest_arrival[stop];
+            result.arrivals.push_back(relative == inf_time ? inf_time : departure + relative);
+            if (count_trips)
+                result.trips.push_back(workspace.labels.lastRound(stop));
         }
-        labels.emplace_back(labels.back());
-        bool end_cond = false;    // end condition
-        auto early_end = [&]()
+        return result;
+    }
+
+    std::vector<RouteFinder::Arrivals> RouteFinder::earliestArrivalsForDepartures(const std::vector<StopId>& starts, const std::vector<Time_t>& departures) const
+    {
+        thread_local QueryWorkspace workspace;
+        return earliestArrivalsForDepartures(starts, departures, workspace);
+    }
+
+    std::vector<RouteFinder::Arrivals> RouteFinder::earliestArrivalsForDepartures(const std::vector<StopId>& starts, const std::vector<Time_t>& departures, QueryWorkspace& workspace) const
+    {
+        if (!checkServiceIdInFeed(options_.wanted_service_id))
+            throw IdException(options_.wanted_service_id);
+        const ServiceTimetable& timetable = getTimetable(IdTranslator::getInstance().at(options_.wanted_service_id, IdTranslator::ServiceTag()));
+        const RouteTraversal& routes = timetable.routes;
+        auto find_trip = [&](const RouteId route, const size_t stop_index, const Time_t time)
         {
-            if (starts.size() != ends.size())
-                return false;
-            for (size_t i = 0; i < starts.size(); ++i)
+            return routes.earliestTripIndex(route, stop_index, time);
+        };
+        return searchLanes(routes, timetable.stops, starts, departures, workspace, find_trip);
+    }
+
+    std::vector<RouteFinder::Arrivals> RouteFinder::earliestArrivalsForDepartures(const std::vector<StopId>& starts, const std::vector<Time_t>& departures, const std::chrono::year_month_day date) const
+    {
+        thread_local QueryWorkspace workspace;
+        return earliestArrivalsForDepartures(starts, departures, date, workspace);
+    }
+
+    std::vector<RouteFinder::Arrivals> RouteFinder::earliestArrivalsForDepartures(const std::vector<StopId>& starts, const std::vector<Time_t>& departures, const std::chrono::year_month_day date, QueryWorkspace& workspace) const
+    {
+        if (!activateServices(date, workspace.active_services))
+            return std::vector<Arrivals>(departures.size(), Arrivals{ std::vector<Time_t>(num_stops_, inf_time), std::vector<size_t>() });
+        const ServiceSet& active = workspace.active_services;
+        const RouteTraversal& timeline = getTimeline();
+        auto find_trip = [&](const RouteId route, const size_t stop_index, const Time_t time)
+        {
+            return timeline.earliestTripIndex(route, stop_index, time, [&](const ServiceId service) { return active.contains(service); });
+        };
+        return searchLanes(timeline, stops_, starts, departures, workspace, find_trip);
+    }
+
+    template<typename F>
+    std::vector<RouteFinder::Arrivals> RouteFinder::searchLanes(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& starts, const std::vector<Time_t>& departures, QueryWorkspace& workspace, F&& find_trip) const
+    {
+        std::vector<Arrivals> result(departures.size());
+        for (size_t first = 0; first < departures.size(); first += lane_count)
+        {
+            const size_t used = std::min(lane_count, departures.size() - first);
+            // unused lanes repeat the last departure, their results are dropped
+            TimeLanes lane_departures;
+            for (size_t lane = 0; lane < lane_count; ++lane)
+                lane_departures[lane] = departures[first + std::min(lane, used - 1)];
+            runLanes(routes, stops, starts, lane_departures, workspace, find_trip);
+            for (size_t lane = 0; lane < used; ++lane)
             {
-                if (starts[i] != ends[i])
-                    return false;
+                auto&& arrivals = result[first + lane].arrivals;
+                arrivals.reserve(num_stops_);
+                for (auto&& stop_arrivals : workspace.lanes.arrivals)
+                    arrivals.push_back(stop_arrivals[lane]);
             }
+        }
+        return result;
+    }
+
+    template<typename F>
+    void RouteFinder::runLanes(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& starts, const TimeLanes& departures, QueryWorkspace& workspace, F&& find_trip) const
+    {
+        workspace.prepare(num_stops_, routes.size(), inf_time);
+        auto& lanes = workspace.lanes;
+        auto& marked = workspace.marked;
+        lanes.reset(num_stops_);
+        TimeLanes unreached;
+        unreached.fill(inf_time);
+        for (auto&& start : starts)
+        {
+            lanes.arrivals[start] = departures;
+            marked.mark(start);
+        }
+        std::array<size_t, lane_count> curr_trip;
+        TimeLanes trip_times;
+        auto board = [&](const size_t, const StopId stop)
+        {
+            lanes.previous[stop] = lanes.arrivals[stop];
+            lanes.by_trip[stop] = 0;
             return true;
         };
-        if (early_end())
-            return "Start and end are the same stop\n";
-        for (size_t k = 1; !end_cond; ++k)
+        auto scan = [&](const size_t)
         {
-            auto recalculate_end_arrival = [&]()
+            for (auto&& [route, stop_index] : workspace.potential_routes)
             {
-                for (auto&& end : ends)
+                const Route& r = routes[route];
+                const size_t trips = r.trips();
+                curr_trip.fill(RouteTraversal::no_trip);
+                LaneMask boarded = 0;
+                for (size_t next_index = stop_index; next_index < r.stops_count; ++next_index)
                 {
-                    if (earliest_arrival[end] < std::get<0>(earliest_arrival_end))
-                        earliest_arrival_end = std::tuple(earliest_arrival[end], end, k);
-                }
-            };
-            potential_routes.clear();
-            for (size_t stop = 0; stop < marked.size(); ++stop)
-            {
-                if (marked[stop])
-                {
-                    for (auto&& route : stops_.getRoutes(StopId(stop)))
+                    const StopId next_stop = r.route_stops_ptr[next_index];
+                    const size_t column = next_index * trips;
+                    if (boarded != 0)
                     {
-                        auto&& [it, inserted] = potential_routes.emplace(route, StopId(stop));
-                        if (!inserted)
+                        for (size_t lane = 0; lane < lane_count; ++lane)
+                            trip_times[lane] = curr_trip[lane] == RouteTraversal::no_trip ? inf_time : r.arrivals_ptr[column + curr_trip[lane]];
+                        // a lane which reached the stop earlier by a walk still walks from its arrival by the trip
+                        const LaneMask improved = lessLanes(trip_times, lanes.trip_arrivals[next_stop]);
+                        if (improved != 0)
                         {
-                            auto&& [first, last] = rt_.getStops(route);
-                            auto is_earlier_stop = [&stop, &it](const StopId s) { return s == stop || s == it->second; };
-                            // will always find a stop
-                            it->second = *std::find_if(first, last, is_earlier_stop);
+                            minLanes(lanes.trip_arrivals[next_stop], trip_times);
+                            minLanes(lanes.arrivals[next_stop], trip_times);
+                            lanes.by_trip[next_stop] |= improved;
+                            marked.mark(next_stop);
+                        }
+                        for (size_t lane = 0; lane < lane_count; ++lane)
+                            trip_times[lane] = curr_trip[lane] == RouteTraversal::no_trip ? inf_time : r.departures_ptr[column + curr_trip[lane]];
+                    }
+                    else
+                        trip_times = unreached;
+                    const TimeLanes& old_arr = lanes.previous[next_stop];
+                    // lanes which reached the stop no later than their trip departs, unreached lanes are skipped
+                    LaneMask board_lanes = ~lessLanes(trip_times, old_arr) & lessLanes(old_arr, unreached) & all_lanes;
+                    // departures are often sorted, so neighbouring lanes share their arrival and their trip
+                    Time_t searched = inf_time;
+                    size_t found = RouteTraversal::no_trip;
+                    for (; board_lanes != 0; board_lanes &= board_lanes - 1)
+                    {
+                        const size_t lane = std::countr_zero(board_lanes);
+                        if (old_arr[lane] != searched)
+                        {
+                            searched = old_arr[lane];
+                            found = find_trip(route, next_index, searched);
+                        }
+                        if (found != RouteTraversal::no_trip)
+                        {
+                            curr_trip[lane] = found;
+                            boarded |= LaneMask(1) << lane;
                         }
                     }
-                    marked[stop] = false;
-                    --num_marked;
                 }
             }
-            for (auto&& [route, stop] : potential_routes)
+        };
+        auto walk = [&](const size_t, const StopId stop, const StopId target, const Time_t walk_time)
+        {
+            const LaneMask from_trip = lanes.by_trip[stop];
+            if (from_trip == 0)
+                return false;
+            TimeLanes with_walking = unreached;
+            for (size_t lane = 0; lane < lane_count; ++lane)
+            {
+                if ((from_trip >> lane) & 1)
+                    with_walking[lane] = lanes.trip_arrivals[stop][lane] + walk_time + RoutingEngine::transfer_penalty;
+            }
+            if (lessLanes(with_walking, lanes.arrivals[target]) == 0)
+                return false;
+            minLanes(lanes.arrivals[target], with_walking);
+            return true;
+        };
+        scanRounds(stops, workspace, board, scan, walk, [](const size_t) { });
+    }
+
+    Time_t RouteFinder::reversedDeparture(const Time_t arrival)
+    {
+        return ReversedTimetable::origin - arrival - 1;
+    }
+
+    std::vector<Time_t> RouteFinder::readLatestDepartures(const QueryWorkspace& workspace, const Time_t arrival) const
+    {
+        std::vector<Time_t> result(num_stops_, undefined_time);
+        for (size_t stop = 0; stop < num_stops_; ++stop)
+        {
+            const Time_t relative = workspace.earliest_arrival[stop];
+            if (relative == inf_time)
+                continue;
+            // end stops have label 0, which is a second after `arrival`
+            result[stop] = std::min(arrival, ReversedTimetable::toForward(reversedDeparture(arrival) + relative));
+        }
+        return result;
+    }
+
+    RouteFinder::Journey RouteFinder::forwardJourney(const RouteTraversal& forward, const ReversedTimetable& reversed, const result_t& path, const Time_t arrival)
+    {
+        result_t v;
+        size_t trips = 0;
+        RouteTraversal::trip_iterator reversed_trip = undefined_trip;
+        Time_t previous_relative = 0;
+        for (auto&& block : path | std::views::reverse)
+        {
+            if (std::holds_alternative<RouteTraversal::trip_iterator>(block))
+            {
+                reversed_trip = std::get<RouteTraversal::trip_iterator>(block);
+                const StopId boarding = std::get<0>(v.back()).first;
+                v.push_back(reversed.forwardTrip(forward, reversed_trip, boarding));
+                ++trips;
+                continue;
+            }
+            auto [stop, relative] = std::get<0>(block);
+            Time_t time;
+            if (v.empty())
+                // the latest departure from the start stop
+                time = ReversedTimetable::toForward(reversedDeparture(arrival) + relative);
+            else if (std::holds_alternative<RouteTraversal::trip_iterator>(v.back()))
+                // trip was boarded at this stop in reversed time
+                time = ReversedTimetable::toForward(reversed_trip->departure);
+            else
+                // walked here, the walk takes the same time in both directions
+                time = std::get<0>(v.back()).second + previous_relative - relative;
+            v.push_back(std::pair(stop, time));
+            previous_relative = relative;
+        }
+        const Time_t departure = std::get<0>(v.front()).second;
+        const Time_t end_arrival = std::get<0>(v.back()).second;
+        for (auto&& block : v)
+        {
+            if (std::holds_alternative<std::pair<StopId, Time_t>>(block))
+                std::get<0>(block).second -= departure;
+        }
+        return Journey{ departure, end_arrival, trips - 1, std::move(v) };
+    }
+
+    template<typename F>
+    std::variant<RouteFinder::pareto_t, std::string> RouteFinder::searchPareto(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure, QueryWorkspace& workspace, F&& accept) const
+    {
+        for (auto&& start : starts)
+        {
+            if (std::ranges::find(ends, start) != ends.end())
+                return "Start and end are the same stop\n";
+        }
+        // labels hold absolute times
+        workspace.prepare(num_stops_, routes.size(), inf_time);
+        auto& bags = workspace.bags;
+        auto& marked = workspace.marked;
+        bags.reset(num_stops_);
+        for (auto&& start : starts)
+        {
+            bags.add(ParetoLabel{ departure, 0, 0, start, ParetoBags::npos, std::nullopt });
+            marked.mark(start);
+        }
+        // a label is useless if a label at an end stop is not worse, following trips and walks only make it worse
+        auto dominated_by_end = [&](const Time_t arrival, const Time_t walking, const size_t round)
+        {
+            return std::ranges::any_of(ends, [&](const StopId end) { return bags.dominated(end, arrival, walking, round); });
+        };
+        /**
+         * @brief Trip in the bag of a route, with the label from which it was boarded
+         * 
+         */
+        struct RouteLabel
+        {
+            size_t trip;
+            size_t boarding_index;
+            Time_t walking;
+            size_t parent;
+        };
+        std::vector<RouteLabel> route_bag;
+        auto scan = [&](const size_t k)
+        {
+            for (auto&& [route, stop_index] : workspace.potential_routes)
             {
-                auto curr_trip = undefined_trip;
-                auto is_stop = [&stop](const StopId s){ return s == stop; };
-                auto&& [first, last] = rt_.getStops(route);
-                auto next = std::find_if(first, last, is_stop);
-                auto range = std::ranges::subrange(next, last);
-                auto prev_stop = stop;
-                size_t diff = 0;
-                for (auto&& next_stop : range)
+                const Route& r = routes[route];
+                const size_t trips = r.trips();
+                route_bag.clear();
+                for (size_t next_index = stop_index; next_index < r.stops_count; ++next_index)
                 {
-                    auto trip_iter = curr_trip + diff;
-                    while (trip_iter != undefined_trip && trip_iter->stopId != next_stop)
-                    {
-                        ++trip_iter;
-                        ++diff;
-                        if (trip_iter->tId != curr_trip->tId)
-                            trip_iter = undefined_trip;
-                    }
-                    assert(trip_iter == undefined_trip || (trip_iter->stopId == next_stop && trip_iter->tId == curr_trip->tId));
-                    const Time_t next_arrival = earliest_arrival[next_stop] == new_inf_time ? inf_time : (departure + earliest_arrival[next_stop]) % day;
-                    const Time_t end_arrival = std::get<0>(earliest_arrival_end) == new_inf_time ? inf_time : (departure + std::get<0>(earliest_arrival_end)) % day;
-                    const Time_t iter_arrival = trip_iter->arrival;
-                    if (curr_trip != undefined_trip && iter_arrival < std::min(next_arrival, end_arrival))
+                    const StopId next_stop = r.route_stops_ptr[next_index];
+                    const size_t column = next_index * trips;
+                    for (auto&& boarded : route_bag)
                     {
-                        const Time_t new_arrival = iter_arrival - departure;
-                        labels[k][next_stop] = std::tuple(new_arrival, prev_stop, curr_trip);
-                        earliest_arrival[next_stop] = new_arrival;
-                        recalculate_end_arrival();
-                        if (!marked[next_stop])
-                            ++num_marked;
-                        marked[next_stop] = true;
+                        const Time_t arrival = r.arrivals_ptr[column + boarded.trip];
+                        if (dominated_by_end(arrival, boarded.walking, k))
+                            continue;
+                        if (bags.add(ParetoLabel{ arrival, boarded.walking, k, next_stop, boarded.parent, routes.tripAt(route, boarded.trip, boarded.boarding_index) }))
+                            marked.mark(next_stop);
                     }
-                    
-                    const Time_t old_arr  = std::get<0>(labels[k-1][next_stop]) == new_inf_time ? inf_time : (departure + std::get<0>(labels[k-1][next_stop])) % day;
-                    if (old_arr <= trip_iter->departure)
+                    // labels from older rounds boarded this route already, when their stop was marked
+                    for (auto&& entry : bags.bag(next_stop))
                     {
-                        auto [first_trip, last_trip] = rt_.getTripsFromStop(route, next_stop);
-                        const auto arr = departure + std::get<0>(labels[k-1][next_stop]);
-                        auto earliest_trip = [&](const Trip& t){ return t.departure > arr && t.sId == IdTranslator::getInstance().at(options_.wanted_service_id, IdTranslator::ServiceTag()); };
-                        auto candidate_trip = std::find_if(first_trip, last_trip, earliest_trip);
-                        if (candidate_trip != last_trip)
+                        if (entry.round != k - 1)
+                            continue;
+                        const size_t trip = routes.earliestTripIndex(route, next_index, entry.arrival, accept);
+                        if (trip == RouteTraversal::no_trip)
+                            continue;
+                        const RouteLabel candidate{ trip, next_index, entry.walking, entry.label };
+                        // on one route a trip departing earlier is expected to arrive earlier
+                        auto not_worse = [&](const RouteLabel& a, const RouteLabel& b)
                         {
-                            curr_trip = candidate_trip;
-                            prev_stop = candidate_trip->stopId;
-                            diff = 0;
-                        }
+                            return r.departures_ptr[column + a.trip] <= r.departures_ptr[column + b.trip] && a.walking <= b.walking;
+                        };
+                        if (std::ranges::any_of(route_bag, [&](const RouteLabel& l) { return not_worse(l, candidate); }))
+                            continue;
+                        std::erase_if(route_bag, [&](const RouteLabel& l) { return not_worse(candidate, l); });
+                        route_bag.push_back(candidate);
                     }
                 }
             }
-            auto new_marked = marked;
-            for (size_t stop = 0; stop < marked.size(); ++stop)
+        };
+        auto walk = [&](const size_t k, const StopId stop, const StopId target, const Time_t walk_time)
+        {
+            bool improved = false;
+            for (auto&& entry : bags.bag(stop))
+            {
+                const ParetoLabel& from = bags.label(entry.label);
+                if (entry.round != k || !from.trip.has_value())
+                    continue;
+                const Time_t arrival = entry.arrival + walk_time + RoutingEngine::transfer_penalty;
+                if (dominated_by_end(arrival, entry.walking + walk_time, k))
+                    continue;
+                // the bag of `stop` itself is not changed, target is a different stop
+                improved = bags.add(ParetoLabel{ arrival, entry.walking + walk_time, k, target, entry.label, std::nullopt }) || improved;
+            }
+            return improved;
+        };
+        scanRounds(stops, workspace, [](const size_t, const StopId) { return true; }, scan, walk, [](const size_t) { });
+        std::vector<ParetoBags::Entry> found;
+        for (auto&& end : ends)
+            found.insert(found.end(), bags.bag(end).begin(), bags.bag(end).end());
+        if (found.empty())
+            return "End stop unreachable\n";
+        // bags of different end stops can dominate each other, a dominating entry is always sorted before the dominated one
+        std::ranges::sort(found, [](const ParetoBags::Entry& a, const ParetoBags::Entry& b) { return std::tie(a.arrival, a.round, a.walking) < std::tie(b.arrival, b.round, b.walking); });
+        std::vector<ParetoBags::Entry> kept;
+        pareto_t result;
+        for (auto&& entry : found)
+        {
+            if (std::ranges::any_of(kept, [&](const ParetoBags::Entry& e) { return e.dominates(entry); }))
+                continue;
+            kept.push_back(entry);
+            result_t v;
+            for (size_t index = entry.label; index != ParetoBags::npos; index = bags.label(index).parent)
+            {
+                const ParetoLabel& label = bags.label(index);
+                v.push_back(std::pair(label.stop, label.arrival - departure));
+                if (label.trip.has_value())
+                    v.push_back(label.trip.value());
+            }
+            result.push_back(ParetoJourney{ entry.arrival, entry.round - 1, entry.walking, result_t(v.rbegin(), v.rend()) });
+        }
+        return result;
+    }
+
+    template<typename F>
+    std::variant<RouteFinder::profile_t, std::string> RouteFinder::searchRange(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t first_departure, const Time_t last_departure, QueryWorkspace& workspace, F&& accept) const
+    {
+        if (first_departure > last_departure)
+            return "Empty departure window\n";
+        for (auto&& start : starts)
+        {
+            if (std::ranges::find(ends, start) != ends.end())
+                return "Start and end are the same stop\n";
+        }
+        // each departure of a trip from a start stop in the window is one iteration, the latest first
+        std::vector<Time_t> departures;
+        for (auto&& start : starts)
+        {
+            for (auto&& [route, stop_index] : stops.getRoutes(start))
+            {
+                const Route& r = routes[route];
+                const size_t trips = r.trips();
+                // nobody boards at the last stop
+                if (stop_index + 1 == r.stops_count)
+                    continue;
+                for (size_t trip = 0; trip < trips; ++trip)
+                {
+                    const Time_t trip_departure = r.departures_ptr[stop_index * trips + trip];
+                    if (trip_departure >= first_departure && trip_departure <= last_departure && accept(r.services_ptr[trip]))
+                        departures.push_back(trip_departure);
+                }
+            }
+        }
+        std::ranges::sort(departures, std::greater<>());
+        departures.erase(std::unique(departures.begin(), departures.end()), departures.end());
+
+        // labels hold absolute times and are kept between iterations, labels of a later departure stay valid for an earlier one
+        workspace.prepare(num_stops_, routes.size(), inf_time);
+        auto& labels = workspace.labels;
+        auto& trip_labels = workspace.trip_labels;
+        auto& marked = workspace.marked;
+        auto end_arrival = [&](const size_t round)
+        {
+            std::pair<Time_t, StopId> best(inf_time, undefined::stop);
+            for (auto&& end : ends)
+            {
+                if (labels.get(round, end).arrival < best.first)
+                    best = std::pair(labels.get(round, end).arrival, end);
+            }
+            return best;
+        };
+        auto find_trip = [&](const RouteId route, const size_t stop_index, const Time_t time)
+        {
+            return routes.earliestTripIndex(route, stop_index, time, accept);
+        };
+        // best arrival to an end stop with at most `k` trips found by previous iterations, index `k`
+        std::vector<Time_t> best_arrivals(1, inf_time);
+        auto scan = [&](const size_t k)
+        {
+            // pruning compares only with labels with at most `k` trips, so journeys with fewer transfers are kept
+            Time_t end_bound = end_arrival(k).first;
+            auto accept_label = [&](const StopId stop, const Time_t arrival)
+            {
+                return arrival < std::min(trip_labels.get(k, stop).arrival, end_bound);
+            };
+            auto improve = [&](const StopId stop, const Label& label)
+            {
+                trip_labels.set(k, stop, label);
+                if (label.arrival < labels.get(k, stop).arrival)
+                {
+                    labels.set(k, stop, label);
+                    if (std::ranges::find(ends, stop) != ends.end())
+                        end_bound = label.arrival;
+                }
+                marked.mark(stop);
+            };
+            for (auto&& [route, stop_index] : workspace.potential_routes)
+                scanRoute(routes, labels, route, stop_index, k, 0, find_trip, accept_label, improve);
+        };
+        auto walk = [&](const size_t k, const StopId stop, const StopId target, const Time_t walk_time)
+        {
+            const Time_t arrival_with_walking = trip_labels.get(k, stop).arrival + walk_time + RoutingEngine::transfer_penalty;
+            if (arrival_with_walking >= labels.get(k, target).arrival)
+                return false;
+            labels.set(k, target, Label{ arrival_with_walking, stop, std::nullopt });
+            return true;
+        };
+        auto end_round = [&](const size_t k)
+        {
+            if (k >= best_arrivals.size())
+                best_arrivals.push_back(inf_time);
+        };
+        profile_t result;
+        for (auto&& departure : departures)
+        {
+            // trips depart strictly after arrival to their stop, so the start is reached a second before `departure`
+            for (auto&& start : starts)
+            {
+                labels.set(0, start, Label{ departure - 1, undefined::stop, std::nullopt });
+                marked.mark(start);
+            }
+            scanRounds(stops, workspace, [](const size_t, const StopId) { return true; }, scan, walk, end_round);
+            // a journey is Pareto optimal if it is faster than journeys departing later and journeys with fewer trips
+            Time_t fewer_trips = inf_time;
+            for (size_t k = 1; k < best_arrivals.size(); ++k)
             {
-                if (marked[stop])
+                auto [arrival, end] = end_arrival(k);
+                if (arrival < fewer_trips && arrival < best_arrivals[k])
                 {
-                    for (auto&& transfer : stops_.getTransfers(stop))
+                    result_t path = reconstruct(labels, trip_labels, end, k, departure);
+                    // the journey can start with a trip of a later departure, it was already found or it is outside of the window
+                    if (std::get<RouteTraversal::trip_iterator>(path[1])->departure == departure)
                     {
-                        constexpr Time_t transfer_penalty = 60;
-                        const auto arrival_with_walking = std::get<0>(labels[k][stop]) + distanceToTime(transfer.distance, w_speed) + transfer_penalty;
-                        const auto arrival_without = std::get<0>(labels[k][transfer.target_stop]);
-                        if (arrival_with_walking < arrival_without && distanceToTime(transfer.distance, w_speed) < max_travel_time && std::get<2>(labels[k][stop]).has_value())
-                        {
-                            labels[k][transfer.target_stop] = std::tuple(arrival_with_walking, stop, std::nullopt);
-                            earliest_arrival[transfer.target_stop] = arrival_with_walking;
-                            if (!new_marked[transfer.target_stop])
-                                ++num_marked;
-                            new_marked[transfer.target_stop] = true;
-                        }
+                        std::get<0>(path.front()).second = 0;
+                        result.push_back(Journey{ departure, arrival, k - 1, std::move(path) });
                     }
                 }
+                best_arrivals[k] = arrival;
+                fewer_trips = std::min(fewer_trips, arrival);
             }
-            recalculate_end_arrival();
-            marked = std::move(new_marked);
-            end_cond = num_marked == 0;
-            if (!end_cond)
+        }
+        std::ranges::stable_sort(result, std::less<>(), &Journey::departure);
+        return result;
+    }
+
+    template<typename F>
+    std::variant<RouteFinder::result_t, std::string> RouteFinder::search(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure, QueryWorkspace& workspace, F&& find_trip, const LowerBoundGraph* bounds) const
+    {
+        auto early_end = [&]()
+        {
+            if (starts.size() != ends.size())
+                return false;
+            for (size_t i = 0; i < starts.size(); ++i)
             {
-                labels.push_back(labels.back());
+                if (starts[i] != ends[i])
+                    return false;
             }
-        }
-        labels.pop_back();
-        result_t v;
+            return true;
+        };
+        if (early_end())
+            return "Start and end are the same stop\n";
+        auto& earliest_arrival = workspace.earliest_arrival;
+        std::tuple<Time_t, StopId, size_t> earliest_arrival_end(inf_time - departure, undefined::stop, 0);
+        // labels worse than the best end stop can't lead to a faster connection
+        auto& remaining = workspace.remaining;
+        remaining.clear();
+        auto end_bound = [&](const size_t round)
+        {
+            for (auto&& end : ends)
+            {
+                if (earliest_arrival[end] < std::get<0>(earliest_arrival_end))
+                    earliest_arrival_end = std::tuple(earliest_arrival[end], end, round);
+            }
+            // lower bounds are needed only up to the first arrival to an end, later ones are earlier
+            if (bounds && remaining.empty() && std::get<1>(earliest_arrival_end) != undefined::stop)
+                bounds->remainingTimes(ends, std::get<0>(earliest_arrival_end), remaining);
+            return std::get<0>(earliest_arrival_end);
+        };
+        runRounds(routes, stops, starts, departure, workspace, find_trip, end_bound, &remaining);
         if (std::get<1>(earliest_arrival_end) == undefined::stop)
             return "End stop unreachable\n";
         auto&& [time, end, last_round] = earliest_arrival_end;
-        assert(std::get<0>(labels[last_round][end]) == time);
-        v.push_back(std::pair(end, std::get<0>(labels[last_round][end])));
-        StopId prev = std::get<1>(labels[last_round][end]);
-        if (std::get<2>(labels[last_round][end]).has_value())
-            v.push_back(std::get<2>(labels[last_round][end]).value());
+        assert(workspace.labels.get(last_round, end).arrival == time);
+        return reconstruct(workspace.labels, workspace.trip_labels, end, last_round, 0);
+    }
+
+    template<typename S, typename M>
+    void RouteFinder::scanParallel(QueryWorkspace& workspace, S&& scan, M&& merge) const
+    {
+        const size_t route_count = workspace.potential_routes.size();
+        // a few chunks for each thread, so threads which get short routes take more of them
+        const size_t chunk_routes = std::clamp<size_t>(route_count / (4 * scan_pool_->size()), 1, scan_chunk_routes);
+        const size_t chunk_count = (route_count + chunk_routes - 1) / chunk_routes;
+        auto& buffers = workspace.scan_buffers;
+        auto& chunks = workspace.scan_chunks;
+        buffers.resize(scan_pool_->size());
+        for (auto&& buffer : buffers)
+        {
+            if (buffer.best.size() != num_stops_)
+                buffer.best.assign(num_stops_, inf_time);
+        }
+        chunks.resize(chunk_count);
+        std::atomic<size_t> next_chunk = 0;
+        // every thread takes the next chunk, so chunks of one thread are in the order of routes
+        scan_pool_->run([&](const size_t worker)
+        {
+            RouteScanBuffer& buffer = buffers[worker];
+            for (size_t chunk = next_chunk++; chunk < chunk_count; chunk = next_chunk++)
+            {
+                const size_t begin = buffer.improvements.size();
+                for (size_t route_index = chunk * chunk_routes; route_index < std::min(route_count, (chunk + 1) * chunk_routes); ++route_index)
+                    scan(route_index, buffer);
+                chunks[chunk] = ScanChunk{ worker, begin, buffer.improvements.size() };
+            }
+        });
+        for (auto&& chunk : chunks)
+        {
+            for (size_t i = chunk.begin; i < chunk.end; ++i)
+                merge(buffers[chunk.buffer].improvements[i].first, buffers[chunk.buffer].improvements[i].second);
+        }
+        for (auto&& buffer : buffers)
+        {
+            for (auto&& [stop, label] : buffer.improvements)
+                buffer.best[stop] = inf_time;
+            buffer.improvements.clear();
+        }
+    }
+
+    template<typename B, typename S, typename W, typename E>
+    void RouteFinder::scanRounds(const Stops& stops, QueryWorkspace& workspace, B&& board, S&& scan, W&& walk, E&& end_round) const
+    {
+        const auto w_speed = options_.preferred_walking_speed;
+        auto& marked = workspace.marked;
+        auto& new_marked = workspace.new_marked;
+        auto& potential_routes = workspace.potential_routes;
+        for (size_t k = 1; !marked.empty(); ++k)
+        {
+            potential_routes.clear();
+            marked.forEach([&](const StopId stop)
+            {
+                if (!board(k, stop))
+                    return;
+                for (auto&& [route, stop_index] : stops.getRoutes(stop))
+                {
+                    potential_routes.add(route, stop_index);
+                }
+            });
+            marked.clear();
+            scan(k);
+            marked.forEach([&](const StopId stop)
+            {
+                for (auto&& transfer : stops.getTransfers(stop))
+                {
+                    const Time_t walk_time = distanceToTime(transfer.distance, w_speed);
+                    if (walk_time < RoutingEngine::max_walking_time && walk(k, stop, transfer.target_stop, walk_time))
+                        new_marked.mark(transfer.target_stop);
+                }
+            });
+            new_marked.forEach([&](const StopId stop) { marked.mark(stop); });
+            new_marked.clear();
+            end_round(k);
+        }
+    }
+
+    template<typename F, typename A, typename I>
+    void RouteFinder::scanRoute(const RouteTraversal& routes, const RoundLabels& labels, const RouteId route, const size_t stop_index, const size_t round, const Time_t departure, F&& find_trip, A&& accept, I&& improve)
+    {
+        // only columns of the route are read, trip records are used just for labels
+        const Route& r = routes[route];
+        const size_t trips = r.trips();
+        size_t curr_trip = RouteTraversal::no_trip;
+        size_t boarding_index = stop_index;
+        StopId prev_stop = r.route_stops_ptr[stop_index];
+        for (size_t next_index = stop_index; next_index < r.stops_count; ++next_index)
+        {
+            const StopId next_stop = r.route_stops_ptr[next_index];
+            const size_t column = next_index * trips;
+            // times of trips are on one timeline, so they are compared with labels relative to `departure`
+            if (curr_trip != RouteTraversal::no_trip && accept(next_stop, r.arrivals_ptr[column + curr_trip] - departure))
+            {
+                const Time_t new_arrival = r.arrivals_ptr[column + curr_trip] - departure;
+                improve(next_stop, Label{ new_arrival, prev_stop, routes.tripAt(route, curr_trip, boarding_index) });
+            }
+            
+            // unreached stops have `inf_time - departure`, so `old_arr` is `inf_time` for them
+            const Time_t old_arr = departure + labels.get(round-1, next_stop).arrival;
+            const Time_t trip_departure = curr_trip == RouteTraversal::no_trip ? inf_time : r.departures_ptr[column + curr_trip];
+            if (old_arr <= trip_departure)
+            {
+                const size_t candidate_trip = find_trip(route, next_index, old_arr);
+                if (candidate_trip != RouteTraversal::no_trip)
+                {
+                    curr_trip = candidate_trip;
+                    boarding_index = next_index;
+                    prev_stop = next_stop;
+                }
+            }
+        }
+    }
+
+    template<typename F, typename B>
+    void RouteFinder::runRounds(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& starts, const Time_t departure, QueryWorkspace& workspace, F&& find_trip, B&& end_bound, const std::vector<Time_t>* remaining) const
+    {
+        const Time_t new_inf_time = inf_time - departure;
+        workspace.prepare(num_stops_, routes.size(), new_inf_time);
+        auto& labels = workspace.labels;
+        auto& trip_labels = workspace.trip_labels;
+        auto& earliest_arrival = workspace.earliest_arrival;
+        auto& marked = workspace.marked;
+        for (auto&& start : starts)
+        {
+            labels.set(0, start, Label{ 0, undefined::stop, std::nullopt });
+            earliest_arrival[start] = 0;
+            marked.mark(start);        // mark starting stop
+        }
+        Time_t bound = new_inf_time;
+        // even the fastest continuation from the stop can't reach an end before `bound`
+        auto hopeless = [&](const StopId stop, const Time_t arrival)
+        {
+            return remaining && !remaining->empty() && ((*remaining)[stop] == inf_time || arrival + (*remaining)[stop] >= bound);
+        };
+        auto board = [&](const size_t k, const StopId stop)
+        {
+            // the bound may have dropped since the stop was marked
+            return !hopeless(stop, labels.get(k-1, stop).arrival);
+        };
+        auto scan = [&](const size_t k)
+        {
+            // a stop reached earlier by a walk is still marked, walks start from its arrival by the trip
+            auto accept = [&](const StopId stop, const Time_t arrival)
+            {
+                return arrival < std::min(trip_labels.get(k, stop).arrival, bound) && !hopeless(stop, arrival);
+            };
+            auto improve = [&](const StopId stop, const Label& label)
+            {
+                trip_labels.set(k, stop, label);
+                if (label.arrival < earliest_arrival[stop])
+                {
+                    labels.set(k, stop, label);
+                    earliest_arrival[stop] = label.arrival;
+                    bound = end_bound(k);
+                }
+                marked.mark(stop);
+            };
+            if (scan_pool_ && workspace.potential_routes.size() >= parallel_scan_routes_)
+                scanParallel(workspace, [&](const size_t route_index, RouteScanBuffer& buffer)
+                {
+                    auto [route, stop_index] = *(workspace.potential_routes.begin() + route_index);
+                    // labels and the bound don't change until the merge, so a thread keeps at least all labels the sequential scan would set
+                    scanRoute(routes, labels, route, stop_index, k, departure, find_trip, [&](const StopId stop, const Time_t arrival)
+                    {
+                        return arrival < buffer.best[stop] && accept(stop, arrival);
+                    }, [&](const StopId stop, const Label& label)
+                    {
+                        buffer.best[stop] = label.arrival;
+                        buffer.improvements.emplace_back(stop, label);
+                    });
+                }, [&](const StopId stop, const Label& label)
+                {
+                    // merged in the order of routes, so the result is the same as of the sequential scan
+                    if (accept(stop, label.arrival))
+                        improve(stop, label);
+                });
+            else
+            {
+                for (auto&& [route, stop_index] : workspace.potential_routes)
+                    scanRoute(routes, labels, route, stop_index, k, departure, find_trip, accept, improve);
+            }
+        };
+        auto walk = [&](const size_t k, const StopId stop, const StopId target, const Time_t walk_time)
+        {
+            const Time_t arrival_with_walking = trip_labels.get(k, stop).arrival + walk_time + RoutingEngine::transfer_penalty;
+            if (arrival_with_walking >= earliest_arrival[target] || hopeless(target, arrival_with_walking))
+                return false;
+            labels.set(k, target, Label{ arrival_with_walking, stop, std::nullopt });
+            earliest_arrival[target] = arrival_with_walking;
+            return true;
+        };
+        scanRounds(stops, workspace, board, scan, walk, [&](const size_t k) { bound = end_bound(k); });
+    }
+
+    RouteFinder::result_t RouteFinder::reconstruct(const RoundLabels& labels, const RoundLabels& trip_labels, const StopId end, const size_t last_round, const Time_t base)
+    {
+        result_t v;
+        const Label& end_label = labels.get(last_round, end);
+        v.push_back(std::pair(end, end_label.arrival - base));
+        StopId prev = end_label.parent;
+        if (end_label.trip.has_value())
+            v.push_back(end_label.trip.value());
         else
         {
-            v.push_back(std::pair(prev, std::get<0>(labels[last_round][prev])));
-            if (std::get<2>(labels[last_round][prev]).has_value())
-                v.push_back(std::get<2>(labels[last_round][prev]).value());
-            prev = std::get<1>(labels[last_round][prev]);
+            // the walk started from the arrival by a trip, the stop itself may have been reached earlier
+            const Label& prev_label = trip_labels.get(last_round, prev);
+            v.push_back(std::pair(prev, prev_label.arrival - base));
+            if (prev_label.trip.has_value())
+                v.push_back(prev_label.trip.value());
+            prev = prev_label.parent;
         }
-        for (auto&& round : std::ranges::subrange(labels.rbegin()+labels.size()-last_round, labels.rend()))
+        // labels reused by range queries can reach the start in fewer rounds
+        for (size_t round = last_round; round-- > 0 && prev != undefined::stop;)
         {
-            auto&& [arrival, s, iter] = round[prev];
-            v.push_back(std::pair(prev, arrival));
-            if (iter.has_value())
+            const Label& label = labels.get(round, prev);
+            StopId s = label.parent;
+            v.push_back(std::pair(prev, label.arrival - base));
+            if (label.trip.has_value())
             {
-                v.push_back(iter.value());
+                v.push_back(label.trip.value());
             }
             // I walked to here
             else if (s != undefined::stop)
             {
-                auto&& [p_arrival, p_s, p_iter] = round[s];
-                v.push_back(std::pair(s, p_arrival));
-                if (p_iter.has_value())
-                    v.push_back(p_iter.value());
-                s = p_s;
+                const Label& p_label = trip_labels.get(round, s);
+                v.push_back(std::pair(s, p_label.arrival - base));
+                if (p_label.trip.has_value())
+                    v.push_back(p_label.trip.value());
+                s = p_label.parent;
             }
             prev = s;
         }
@@ -2,23 +2,20 @@
 #define ALGORITHM_HPP_
 
 #include <DataStructures.hpp>
+#include <QueryStructures.hpp>
+#include <RoutingEngine.hpp>
+#include <LowerBounds.hpp>
+#include <ThreadPool.hpp>
 #include <variant>
 #include <iostream>
 #include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <chrono>
 
 namespace raptor
 {
-    /**
-     * @brief Enum representing different walking speed
-     * 
-     */
-    enum class WalkingSpeed
-    {
-        Fast, /**< Fast walking speed, 6 km/h */
-        Normal, /**< Normal walking speed, 5 km/h */
-        Slow /**< Slow walking speed, 4 km/h*/
-    };
-    
     /**
      * @brief Options for `raptor::RouteFinder`
      * 
@@ -39,6 +36,29 @@ namespace raptor
          * @see raptor::WalkingSpeed
          */
         WalkingSpeed preferred_walking_speed = WalkingSpeed::Normal;
+
+        /**
+         * @brief Algorithm used by `raptor::RouteFinder::findRoute` with a service
+         * 
+         * Default `raptor::Engine::Raptor`
+         * @see raptor::Engine
+         */
+        Engine engine = Engine::Raptor;
+
+        /**
+         * @brief Prune RAPTOR searches by lower bounds of the time to the end stops
+         * 
+         * Default false
+         * @see raptor::LowerBoundGraph
+         */
+        bool goal_directed = false;
+
+        /**
+         * @brief Number of threads scanning routes of one round of RAPTOR, 0 for the number of hardware threads
+         * 
+         * Default 1
+         */
+        size_t scan_threads = 1;
     };
     
     /**
@@ -98,6 +118,63 @@ namespace raptor
          */
         const gtfs::Feed* feed_;
 
+        /**
+         * @brief Number of days in `timeline_`: the previous, the current and the next day
+         * 
+         */
+        static constexpr size_t timeline_days = 3;
+
+        /**
+         * @brief Trips of all services copied to `timeline_days` days on one timeline, created on the first query with a date
+         * 
+         * Copy of a trip on day `d` has service `d * service_count + service`,
+         * see `raptor::RouteTraversal::RouteTraversal(const RouteTraversal&, size_t, size_t)`
+         * 
+         */
+        mutable std::unique_ptr<RouteTraversal> timeline_;
+
+        /**
+         * @brief `timeline_` running backwards in time, created on the first arrive-by query with a date
+         * 
+         * @see raptor::ReversedTimetable
+         * 
+         */
+        mutable std::unique_ptr<ReversedTimetable> reversed_timeline_;
+
+        /**
+         * @brief Lower bounds of travel times over `timeline_`, used to prune searches with a date, created on first use
+         * 
+         */
+        mutable std::unique_ptr<LowerBoundGraph> timeline_bounds_;
+
+        /**
+         * @brief Threads scanning routes of a round in parallel, nullptr if they are scanned by the calling thread
+         * 
+         * Queries from more threads share it and their parallel rounds run one after another.
+         * 
+         */
+        std::unique_ptr<ThreadPool> scan_pool_;
+
+        /**
+         * @brief Rounds with fewer routes are scanned by the calling thread even with `scan_pool_`
+         * 
+         */
+        size_t parallel_scan_routes_ = 256;
+
+        /**
+         * @brief Maximal number of routes a thread takes at once in a parallel round
+         * 
+         */
+        static constexpr size_t scan_chunk_routes = 16;
+
+        /**
+         * @brief Days on which services of the feed run
+         * 
+         * @see raptor::ServiceCalendar
+         * 
+         */
+        ServiceCalendar calendar_;
+
         /**
          * @brief Options which affect route search
          * 
@@ -106,6 +183,105 @@ namespace raptor
          */
         Options options_;
 
+        /**
+         * @brief Timetables with trips of one service, created on first use
+         * 
+         * @see raptor::ServiceTimetable
+         * 
+         */
+        mutable std::unordered_map<ServiceId, std::unique_ptr<ServiceTimetable>> timetables_;
+
+        /**
+         * @brief Guards `timetables_` and timetables of the timeline, so queries from more threads can create them
+         * 
+         */
+        mutable std::mutex timetables_mutex_;
+
+        /**
+         * @brief Engine of one service, built once outside of `timetables_mutex_`
+         * 
+         * Precomputation of an engine can take minutes, only queries for the same service wait for it
+         * 
+         */
+        struct EngineSlot
+        {
+            std::once_flag built;
+            std::unique_ptr<RoutingEngine> engine;
+        };
+
+        /**
+         * @brief Engines of `options_.engine` for timetables in `timetables_`, created on first use
+         * 
+         * The map is guarded by `timetables_mutex_`, engines are dropped when options change
+         * 
+         */
+        mutable std::unordered_map<ServiceId, std::unique_ptr<EngineSlot>> engines_;
+
+        /**
+         * @brief Returns engine for `service`, creates it if it does not exist yet
+         * 
+         * @param service A service
+         * @return Engine of `options_.engine` over the timetable of `service`
+         */
+        const RoutingEngine& getEngine(ServiceId service) const;
+
+        /**
+         * @brief Saves precomputed data of engine `E` of kind `kind` for the wanted service
+         * 
+         * @param kind Engine which is `E`
+         * @param out Stream opened in binary mode
+         */
+        template<typename E>
+        void saveEngine(Engine kind, std::ostream& out) const;
+
+        /**
+         * @brief Loads precomputed data of engine `E` of kind `kind` for the wanted service and switches to it
+         * 
+         * @param kind Engine which is `E`
+         * @param in Stream opened in binary mode
+         */
+        template<typename E>
+        void loadEngine(Engine kind, std::istream& in);
+
+        friend class RaptorEngine;
+
+        /**
+         * @brief Returns timetable for `service`, creates it if it does not exist yet
+         * 
+         * @param service A service
+         * @return Timetable with only trips of `service`
+         */
+        const ServiceTimetable& getTimetable(ServiceId service) const;
+
+        /**
+         * @brief Returns the reversed timetable of `service`, creates it if it does not exist yet
+         * 
+         * @param service A service
+         * @return `reversed` of the timetable of `service`
+         */
+        const ReversedTimetable& getReversedTimetable(ServiceId service) const;
+
+        /**
+         * @brief Returns trips of all services on `timeline_days` days, creates them if they do not exist yet
+         * 
+         * @return Routes of `timeline_`
+         */
+        const RouteTraversal& getTimeline() const;
+
+        /**
+         * @brief Returns the reversed timeline, creates it if it does not exist yet
+         * 
+         * @return Timetable of `reversed_timeline_`
+         */
+        const ReversedTimetable& getReversedTimeline() const;
+
+        /**
+         * @brief Returns lower bounds of travel times over the timeline, creates them if they do not exist yet
+         * 
+         * @return Graph of `timeline_bounds_`
+         */
+        const LowerBoundGraph& getTimelineBounds() const;
+
         /**
          * @brief Calculates approximate time in which the distance will be covered based on walking speed
          * 
@@ -123,6 +299,13 @@ namespace raptor
          * @return false The id is invalid
          */
         bool checkServiceIdInFeed(const std::string& id) const;
+
+        /**
+         * @brief Builds the timetables from data parsed from `feed_`
+         * 
+         * @param data Result of `raptor::GTFSFeedParser::parseFeed`
+         */
+        void buildTimetables(Data data);
     public:
         /**
          * @brief Type for result of a search
@@ -132,13 +315,138 @@ namespace raptor
          * trip_iterator comes only after a pair, there are data about the trip we used to get to the next stop.
          * Two trip_iterators can't come after each other.
          */
-        using result_t = std::vector<std::variant<std::pair<StopId, Time_t>, RouteTraversal::trip_iterator>>;
-        RouteFinder() : rt_(), stops_(), num_stops_(), feed_() { }
-        RouteFinder(const gtfs::Feed* feed);
+        using result_t = path_t;
+
+        /**
+         * @brief One journey of a range query
+         * 
+         */
+        struct Journey
+        {
+            /**
+             * @brief Departure from the start stop
+             * 
+             */
+            Time_t departure;
+
+            /**
+             * @brief Arrival to the end stop
+             * 
+             */
+            Time_t arrival;
+
+            /**
+             * @brief Number of transfers between trips
+             * 
+             */
+            size_t transfers;
+
+            /**
+             * @brief The connection, times in it are relative to `departure`
+             * 
+             */
+            result_t path;
+        };
+
+        /**
+         * @brief Type for result of a range query
+         * 
+         * Journeys are sorted by departure. No journey departs later, arrives earlier and has fewer transfers than another journey.
+         */
+        using profile_t = std::vector<Journey>;
+
+        /**
+         * @brief One journey of a multi-criteria query
+         * 
+         */
+        struct ParetoJourney
+        {
+            /**
+             * @brief Arrival to the end stop
+             * 
+             */
+            Time_t arrival;
+
+            /**
+             * @brief Number of transfers between trips
+             * 
+             */
+            size_t transfers;
+
+            /**
+             * @brief Time spent by walking between stops
+             * 
+             */
+            Time_t walking;
+
+            /**
+             * @brief The connection, times in it are relative to the departure of the query
+             * 
+             */
+            result_t path;
+        };
+
+        /**
+         * @brief Type for result of a multi-criteria query
+         * 
+         * Journeys are sorted by arrival. No journey is better than another one in all of arrival, transfers and walking.
+         */
+        using pareto_t = std::vector<ParetoJourney>;
+
+        /**
+         * @brief Earliest arrivals of a one-to-all or one-to-many query
+         * 
+         */
+        struct Arrivals
+        {
+            /**
+             * @brief Earliest arrival for each asked stop, `raptor::inf_time` if the stop is unreachable
+             * 
+             */
+            std::vector<Time_t> arrivals;
+
+            /**
+             * @brief Number of trips used to reach each asked stop, empty if they were not requested
+             * 
+             * Value for an unreachable stop is `raptor::RoundLabels::npos`
+             */
+            std::vector<size_t> trips;
+        };
+        RouteFinder() : rt_(), stops_(), num_stops_(), feed_(), timeline_(), reversed_timeline_(), timeline_bounds_(), scan_pool_(), calendar_() { }
+
+        /**
+         * @brief Builds the timetable from `feed`, which must outlive the finder
+         * 
+         * @param feed Loaded feed
+         * @param transfer_radius Stops closer than this are connected by a transfer, in kilometers
+         */
+        RouteFinder(const gtfs::Feed* feed, double transfer_radius = GTFSFeedParser::default_transfer_radius);
+
+        /**
+         * @brief Builds the timetable from `feed` and stop times streamed from `stop_times`, `feed` must outlive the finder
+         * 
+         * @param feed Feed read by `raptor::GTFSFeedParser::readFeed`, its stop times are not used
+         * @param stop_times Content of stop_times.txt of the feed
+         * @param transfer_radius Stops closer than this are connected by a transfer, in kilometers
+         * @throws std::runtime_error If stop_times.txt is invalid
+         */
+        RouteFinder(const gtfs::Feed* feed, std::istream& stop_times, double transfer_radius = GTFSFeedParser::default_transfer_radius);
+
+        /**
+         * @brief Builds the timetable from `feed` and stop times mapped from file `stop_times`, `feed` must outlive the finder
+         * 
+         * @param feed Feed read by `raptor::GTFSFeedParser::readFeed`, its stop times are not used
+         * @param stop_times Path to stop_times.txt of the feed
+         * @param transfer_radius Stops closer than this are connected by a transfer, in kilometers
+         * @throws std::runtime_error If stop_times.txt can't be read or it is invalid
+         */
+        RouteFinder(const gtfs::Feed* feed, const std::filesystem::path& stop_times, double transfer_radius = GTFSFeedParser::default_transfer_radius);
 
         /**
          * @brief Set options for route search
          * 
+         * Also prepares the timetable for the new service, so following queries don't have to
+         * 
          * @param new_speed New walking speed
          * @param service_id New service id
          * 
@@ -146,10 +454,76 @@ namespace raptor
          */
         void setOptions(const WalkingSpeed new_speed = WalkingSpeed::Normal, const std::string& service_id = "");
 
+        /**
+         * @brief Sets the algorithm used by `findRoute` with a service
+         * 
+         * @param engine New engine
+         */
+        void setEngine(Engine engine);
+
+        /**
+         * @brief Sets whether searches of RAPTOR skip stops from which no end stop can be reached before the best arrival found so far
+         * 
+         * Pruned searches find the same arrivals, lower bounds are computed for each query once an end stop is reached.
+         * 
+         * @param goal_directed True to prune by lower bounds
+         */
+        void setGoalDirected(bool goal_directed);
+
+        /**
+         * @brief Sets the number of threads which scan routes of one round of RAPTOR
+         * 
+         * Each thread keeps the labels it finds in its own buffer and they are merged in the order of routes
+         * before footpaths, so results are the same for any number of threads.
+         * 
+         * @param thread_count Number of threads including the one running the query, 0 for the number of hardware threads
+         * @param min_routes Rounds with fewer routes are scanned only by the thread running the query
+         */
+        void setScanThreads(size_t thread_count, size_t min_routes = 256);
+
+        /**
+         * @brief Writes transfers of the trip based engine for the wanted service to `out`, precomputes them if needed
+         * 
+         * @param out Stream opened in binary mode
+         * @throws raptor::IdException If the wanted service doesn't exist
+         */
+        void saveTripTransfers(std::ostream& out) const;
+
+        /**
+         * @brief Loads transfers saved by `saveTripTransfers` for the wanted service and switches to `raptor::Engine::TripBased`
+         * 
+         * The feed, the wanted service and the walking speed must be the same as when the transfers were saved.
+         * 
+         * @param in Stream opened in binary mode
+         * @throws raptor::IdException If the wanted service doesn't exist
+         * @throws std::runtime_error If the transfers can't be read or they belong to a different timetable
+         */
+        void loadTripTransfers(std::istream& in);
+
+        /**
+         * @brief Writes transfer patterns of the wanted service to `out`, precomputes them if needed
+         * 
+         * @param out Stream opened in binary mode
+         * @throws raptor::IdException If the wanted service doesn't exist
+         */
+        void saveTransferPatterns(std::ostream& out) const;
+
+        /**
+         * @brief Loads patterns saved by `saveTransferPatterns` for the wanted service and switches to `raptor::Engine::TransferPatterns`
+         * 
+         * The feed, the wanted service and the walking speed must be the same as when the patterns were saved.
+         * 
+         * @param in Stream opened in binary mode
+         * @throws raptor::IdException If the wanted service doesn't exist
+         * @throws std::runtime_error If the patterns can't be read or they belong to a different timetable
+         */
+        void loadTransferPatterns(std::istream& in);
+
         /**
          * @brief Finds the fastest connection between a start stop and an end stop which leaves from start after `departure`
          * 
-         * Uses values in `options_` to modify the search
+         * Uses values in `options_` to modify the search.
+         * Memory for the search is taken from a workspace owned by the calling thread.
          * 
          * @param start Start stop (implementation detail: must be in vector, because feed can contain multiple stops with the same name)
          * @param end End stop (implementation detail: must be in vector, because feed can contain multiple stops with the same name)
@@ -158,6 +532,657 @@ namespace raptor
          * @return Data about the connection in a special format
          */
         std::variant<result_t, std::string> findRoute(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure) const;
+
+        /**
+         * @brief Same as `findRoute` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * The workspace holds RAPTOR state, the other engines always use their own memory of the calling thread.
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param departure Time of earliest departure from first stop
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return Data about the connection in a special format
+         */
+        std::variant<result_t, std::string> findRoute(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure, QueryWorkspace& workspace) const;
+
+        /**
+         * @brief Finds the fastest connection on `date` between a start stop and an end stop which leaves from start after `departure`
+         * 
+         * Uses trips of all services running on `date` according to `calendar.txt` and `calendar_dates.txt`,
+         * the service id in `options_` is ignored.
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param departure Time of earliest departure from first stop
+         * @param date Day of the journey
+         * @return Data about the connection in a special format or a message if `date` is outside of the feed validity period
+         */
+        std::variant<result_t, std::string> findRoute(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure, std::chrono::year_month_day date) const;
+
+        /**
+         * @brief Same as `findRoute` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param departure Time of earliest departure from first stop
+         * @param date Day of the journey
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @return Data about the connection in a special format or a message if `date` is outside of the feed validity period
+         */
+        std::variant<result_t, std::string> findRoute(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure, std::chrono::year_month_day date, QueryWorkspace& workspace) const;
+        /**
+         * @brief Finds all Pareto optimal connections between a start stop and an end stop which leave from start between `first_departure` and `last_departure`
+         * 
+         * Criteria are departure, arrival and number of transfers. Uses rRAPTOR, departures are processed from the latest one
+         * and labels of later departures are reused by earlier ones, so the query costs a small multiple of one `findRoute`.
+         * Uses values in `options_` to modify the search.
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param first_departure Earliest departure from the start stop
+         * @param last_departure Latest departure from the start stop
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return All Pareto optimal journeys or a message why there are none
+         */
+        std::variant<profile_t, std::string> findRoutes(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t first_departure, const Time_t last_departure) const;
+
+        /**
+         * @brief Same as `findRoutes` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param first_departure Earliest departure from the start stop
+         * @param last_departure Latest departure from the start stop
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return All Pareto optimal journeys or a message why there are none
+         */
+        std::variant<profile_t, std::string> findRoutes(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t first_departure, const Time_t last_departure, QueryWorkspace& workspace) const;
+
+        /**
+         * @brief Same as `findRoutes` above, but uses trips of all services running on `date`
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param first_departure Earliest departure from the start stop
+         * @param last_departure Latest departure from the start stop
+         * @param date Day of the journey
+         * @return All Pareto optimal journeys or a message why there are none
+         */
+        std::variant<profile_t, std::string> findRoutes(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t first_departure, const Time_t last_departure, std::chrono::year_month_day date) const;
+
+        /**
+         * @brief Same as `findRoutes` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param first_departure Earliest departure from the start stop
+         * @param last_departure Latest departure from the start stop
+         * @param date Day of the journey
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @return All Pareto optimal journeys or a message why there are none
+         */
+        std::variant<profile_t, std::string> findRoutes(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t first_departure, const Time_t last_departure, std::chrono::year_month_day date, QueryWorkspace& workspace) const;
+        /**
+         * @brief Finds all Pareto optimal connections between a start stop and an end stop which leave from start after `departure`
+         * 
+         * Criteria are arrival, number of transfers and walking time. Uses McRAPTOR with a bag of labels for each stop.
+         * Uses values in `options_` to modify the search.
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param departure Time of earliest departure from first stop
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return All Pareto optimal journeys or a message why there are none
+         */
+        std::variant<pareto_t, std::string> findParetoRoutes(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure) const;
+
+        /**
+         * @brief Same as `findParetoRoutes` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param departure Time of earliest departure from first stop
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return All Pareto optimal journeys or a message why there are none
+         */
+        std::variant<pareto_t, std::string> findParetoRoutes(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure, QueryWorkspace& workspace) const;
+
+        /**
+         * @brief Same as `findParetoRoutes` above, but uses trips of all services running on `date`
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param departure Time of earliest departure from first stop
+         * @param date Day of the journey
+         * @return All Pareto optimal journeys or a message why there are none
+         */
+        std::variant<pareto_t, std::string> findParetoRoutes(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure, std::chrono::year_month_day date) const;
+
+        /**
+         * @brief Same as `findParetoRoutes` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param departure Time of earliest departure from first stop
+         * @param date Day of the journey
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @return All Pareto optimal journeys or a message why there are none
+         */
+        std::variant<pareto_t, std::string> findParetoRoutes(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure, std::chrono::year_month_day date, QueryWorkspace& workspace) const;
+
+        /**
+         * @brief Finds the connection between a start stop and an end stop which arrives to end at `arrival` or earlier and leaves from start as late as possible
+         * 
+         * Searches from the end stops backwards in time over `raptor::ReversedTimetable`.
+         * Walking is allowed only between trips and at the start, the same as in `findRoute`.
+         * Uses values in `options_` to modify the search.
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param arrival Latest arrival to the end stop
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return The journey, times in its path are relative to its departure, or a message why there is none
+         */
+        std::variant<Journey, std::string> findRouteArriveBy(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t arrival) const;
+
+        /**
+         * @brief Same as `findRouteArriveBy` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param arrival Latest arrival to the end stop
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return The journey, times in its path are relative to its departure, or a message why there is none
+         */
+        std::variant<Journey, std::string> findRouteArriveBy(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t arrival, QueryWorkspace& workspace) const;
+
+        /**
+         * @brief Same as `findRouteArriveBy` above, but uses trips of all services running on `date`
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param arrival Latest arrival to the end stop
+         * @param date Day of the arrival
+         * @return The journey, times in its path are relative to its departure, or a message why there is none
+         */
+        std::variant<Journey, std::string> findRouteArriveBy(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t arrival, std::chrono::year_month_day date) const;
+
+        /**
+         * @brief Same as `findRouteArriveBy` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param arrival Latest arrival to the end stop
+         * @param date Day of the arrival
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @return The journey, times in its path are relative to its departure, or a message why there is none
+         */
+        std::variant<Journey, std::string> findRouteArriveBy(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t arrival, std::chrono::year_month_day date, QueryWorkspace& workspace) const;
+
+        /**
+         * @brief Finds the latest departure from every stop which arrives to an end stop at `arrival` or earlier
+         * 
+         * One backward search without pruning, so it costs about the same as one `findRouteArriveBy`.
+         * Uses values in `options_` to modify the search.
+         * 
+         * @param end End stop
+         * @param arrival Latest arrival to the end stop
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return Latest departure for each `raptor::StopId`, `raptor::undefined_time` for stops from which the end is unreachable
+         */
+        std::vector<Time_t> latestDepartures(const std::vector<StopId>& end, const Time_t arrival) const;
+
+        /**
+         * @brief Same as `latestDepartures` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param end End stop
+         * @param arrival Latest arrival to the end stop
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return Latest departure for each `raptor::StopId`, `raptor::undefined_time` for stops from which the end is unreachable
+         */
+        std::vector<Time_t> latestDepartures(const std::vector<StopId>& end, const Time_t arrival, QueryWorkspace& workspace) const;
+
+        /**
+         * @brief Same as `latestDepartures` above, but uses trips of all services running on `date`
+         * 
+         * @param end End stop
+         * @param arrival Latest arrival to the end stop
+         * @param date Day of the arrival
+         * @return Latest departure for each `raptor::StopId`, all `raptor::undefined_time` if `date` is outside of the feed validity period
+         */
+        std::vector<Time_t> latestDepartures(const std::vector<StopId>& end, const Time_t arrival, std::chrono::year_month_day date) const;
+
+        /**
+         * @brief Same as `latestDepartures` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param end End stop
+         * @param arrival Latest arrival to the end stop
+         * @param date Day of the arrival
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @return Latest departure for each `raptor::StopId`, all `raptor::undefined_time` if `date` is outside of the feed validity period
+         */
+        std::vector<Time_t> latestDepartures(const std::vector<StopId>& end, const Time_t arrival, std::chrono::year_month_day date, QueryWorkspace& workspace) const;
+
+        /**
+         * @brief Finds the earliest arrival to every stop from a start stop leaving after `departure`
+         * 
+         * No end stop prunes the search and no connection is reconstructed,
+         * so it is much cheaper than one `findRoute` for every stop.
+         * Uses values in `options_` to modify the search.
+         * 
+         * @param start Start stop
+         * @param departure Time of earliest departure from first stop
+         * @param count_trips Also return number of trips used to reach each stop
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return Arrivals indexed by `raptor::StopId`
+         */
+        Arrivals earliestArrivals(const std::vector<StopId>& start, const Time_t departure, bool count_trips = false) const;
+
+        /**
+         * @brief Same as `earliestArrivals` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param departure Time of earliest departure from first stop
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @param count_trips Also return number of trips used to reach each stop
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return Arrivals indexed by `raptor::StopId`
+         */
+        Arrivals earliestArrivals(const std::vector<StopId>& start, const Time_t departure, QueryWorkspace& workspace, bool count_trips = false) const;
+
+        /**
+         * @brief Same as `earliestArrivals` above, but uses trips of all services running on `date`
+         * 
+         * @param start Start stop
+         * @param departure Time of earliest departure from first stop
+         * @param date Day of the journey
+         * @param count_trips Also return number of trips used to reach each stop
+         * @return Arrivals indexed by `raptor::StopId`, every stop is unreachable if `date` is outside of the feed validity period
+         */
+        Arrivals earliestArrivals(const std::vector<StopId>& start, const Time_t departure, std::chrono::year_month_day date, bool count_trips = false) const;
+
+        /**
+         * @brief Same as `earliestArrivals` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param departure Time of earliest departure from first stop
+         * @param date Day of the journey
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @param count_trips Also return number of trips used to reach each stop
+         * @return Arrivals indexed by `raptor::StopId`, every stop is unreachable if `date` is outside of the feed validity period
+         */
+        Arrivals earliestArrivals(const std::vector<StopId>& start, const Time_t departure, std::chrono::year_month_day date, QueryWorkspace& workspace, bool count_trips = false) const;
+
+        /**
+         * @brief Finds the earliest arrival to each of `targets` from a start stop leaving after `departure`
+         * 
+         * Once every target is reached, labels later than the latest target are pruned,
+         * so the search ends as soon as arrivals to all targets are final.
+         * Uses values in `options_` to modify the search.
+         * 
+         * @param start Start stop
+         * @param targets Wanted stops
+         * @param departure Time of earliest departure from first stop
+         * @param count_trips Also return number of trips used to reach each target
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return Arrivals in the order of `targets`
+         */
+        Arrivals earliestArrivals(const std::vector<StopId>& start, const std::vector<StopId>& targets, const Time_t departure, bool count_trips = false) const;
+
+        /**
+         * @brief Same as `earliestArrivals` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param targets Wanted stops
+         * @param departure Time of earliest departure from first stop
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @param count_trips Also return number of trips used to reach each target
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return Arrivals in the order of `targets`
+         */
+        Arrivals earliestArrivals(const std::vector<StopId>& start, const std::vector<StopId>& targets, const Time_t departure, QueryWorkspace& workspace, bool count_trips = false) const;
+
+        /**
+         * @brief Same as `earliestArrivals` above, but uses trips of all services running on `date`
+         * 
+         * @param start Start stop
+         * @param targets Wanted stops
+         * @param departure Time of earliest departure from first stop
+         * @param date Day of the journey
+         * @param count_trips Also return number of trips used to reach each target
+         * @return Arrivals in the order of `targets`, every target is unreachable if `date` is outside of the feed validity period
+         */
+        Arrivals earliestArrivals(const std::vector<StopId>& start, const std::vector<StopId>& targets, const Time_t departure, std::chrono::year_month_day date, bool count_trips = false) const;
+
+        /**
+         * @brief Same as `earliestArrivals` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param targets Wanted stops
+         * @param departure Time of earliest departure from first stop
+         * @param date Day of the journey
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @param count_trips Also return number of trips used to reach each target
+         * @return Arrivals in the order of `targets`, every target is unreachable if `date` is outside of the feed validity period
+         */
+        Arrivals earliestArrivals(const std::vector<StopId>& start, const std::vector<StopId>& targets, const Time_t departure, std::chrono::year_month_day date, QueryWorkspace& workspace, bool count_trips = false) const;
+
+        /**
+         * @brief Same as one-to-all `earliestArrivals` for each of `departures`, but `raptor::lane_count` departures share one search
+         * 
+         * Every stop has a vector of arrivals with one lane for each departure, they are relaxed by vector instructions.
+         * Each route is scanned once for all lanes, so a profile with a departure every minute is much faster than separate queries.
+         * Uses values in `options_` to modify the search.
+         * 
+         * @param start Start stop
+         * @param departures Times of earliest departure from first stop
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return Arrivals for each departure in the order of `departures`, without numbers of trips
+         */
+        std::vector<Arrivals> earliestArrivalsForDepartures(const std::vector<StopId>& start, const std::vector<Time_t>& departures) const;
+
+        /**
+         * @brief Same as `earliestArrivalsForDepartures` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param departures Times of earliest departure from first stop
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @throws raptor::IdException If configured `service_id` is invalid, it's value will be stored in exception message
+         * @return Arrivals for each departure in the order of `departures`, without numbers of trips
+         */
+        std::vector<Arrivals> earliestArrivalsForDepartures(const std::vector<StopId>& start, const std::vector<Time_t>& departures, QueryWorkspace& workspace) const;
+
+        /**
+         * @brief Same as `earliestArrivalsForDepartures` above, but uses trips of all services running on `date`
+         * 
+         * @param start Start stop
+         * @param departures Times of earliest departure from first stop
+         * @param date Day of the journey
+         * @return Arrivals for each departure in the order of `departures`, every stop is unreachable if `date` is outside of the feed validity period
+         */
+        std::vector<Arrivals> earliestArrivalsForDepartures(const std::vector<StopId>& start, const std::vector<Time_t>& departures, std::chrono::year_month_day date) const;
+
+        /**
+         * @brief Same as `earliestArrivalsForDepartures` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param departures Times of earliest departure from first stop
+         * @param date Day of the journey
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @return Arrivals for each departure in the order of `departures`, every stop is unreachable if `date` is outside of the feed validity period
+         */
+        std::vector<Arrivals> earliestArrivalsForDepartures(const std::vector<StopId>& start, const std::vector<Time_t>& departures, std::chrono::year_month_day date, QueryWorkspace& workspace) const;
+    private:
+        /**
+         * @brief Fills `active` with services of `timeline_` which run on `date`
+         * 
+         * @param date A date
+         * @param active Set to fill
+         * @return false If `date` is outside of the feed validity period
+         */
+        bool activateServices(std::chrono::year_month_day date, ServiceSet& active) const;
+
+        /**
+         * @brief Creates the connection to `end` from labels
+         * 
+         * @param labels Labels after a search
+         * @param trip_labels Labels of arrivals by a trip after the search
+         * @param end Reached end stop
+         * @param last_round Round in which `end` was reached
+         * @param base Time subtracted from arrivals in labels
+         * @return Data about the connection in a special format
+         */
+        static result_t reconstruct(const RoundLabels& labels, const RoundLabels& trip_labels, StopId end, size_t last_round, Time_t base);
+
+        /**
+         * @brief Time in the reversed search at which the end stops are reached
+         * 
+         * Trips in the reversed search depart strictly after it, so trips arriving exactly at `arrival` can be used
+         * 
+         * @param arrival Latest arrival to the end stop
+         * @return Departure of the reversed search
+         */
+        static Time_t reversedDeparture(Time_t arrival);
+
+        /**
+         * @brief Converts the connection found by a search over `reversed` to a journey in `forward`
+         * 
+         * @param forward Routes of the forward timetable
+         * @param reversed The same timetable reversed
+         * @param path Connection from an end stop to a start stop in `reversed`, times relative to `reversedDeparture(arrival)`
+         * @param arrival Latest arrival to the end stop
+         * @return The same connection from the start stop to the end stop
+         */
+        static Journey forwardJourney(const RouteTraversal& forward, const ReversedTimetable& reversed, const result_t& path, Time_t arrival);
+
+        /**
+         * @brief Reads latest departures from labels of a search over a reversed timetable
+         * 
+         * @param workspace Workspace of the finished search
+         * @param arrival Latest arrival to the end stop
+         * @return Latest departure for each `raptor::StopId`
+         */
+        std::vector<Time_t> readLatestDepartures(const QueryWorkspace& workspace, Time_t arrival) const;
+
+        /**
+         * @brief Reads earliest arrivals from labels of a finished search
+         * 
+         * @param workspace Workspace of the finished search
+         * @param stops Stops to read, all stops if it is empty
+         * @param departure Departure of the search
+         * @param count_trips Also read number of trips
+         * @return Arrivals in the order of `stops`
+         */
+        Arrivals readArrivals(const QueryWorkspace& workspace, const std::vector<StopId>& stops, Time_t departure, bool count_trips) const;
+
+        /**
+         * @brief Runs the search without reconstruction of connections, see `earliestArrivals`
+         * 
+         * @tparam F Callable `size_t(RouteId, size_t, Time_t)` with the same meaning as `raptor::RouteTraversal::earliestTripIndex`
+         * @param routes Routes used for the search
+         * @param stops Stops used for the search
+         * @param start Start stop
+         * @param targets Wanted stops, all stops if it is empty
+         * @param departure Time of earliest departure from first stop
+         * @param workspace Memory for the query
+         * @param find_trip Returns index of the earliest usable trip of a route at a stop
+         * @param count_trips Also return number of trips
+         * @return Arrivals in the order of `targets`
+         */
+        template<typename F>
+        Arrivals searchArrivals(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& start, const std::vector<StopId>& targets, const Time_t departure, QueryWorkspace& workspace, F&& find_trip, bool count_trips) const;
+
+        /**
+         * @brief Runs the multi-criteria search over `routes` and `stops`
+         * 
+         * @tparam F Predicate on `raptor::ServiceId`, decides which trips can be used
+         * @param routes Routes used for the search
+         * @param stops Stops used for the search
+         * @param start Start stop
+         * @param end End stop
+         * @param departure Time of earliest departure from first stop
+         * @param workspace Memory for the query
+         * @param accept Returns true for services whose trips can be used
+         * @return All Pareto optimal journeys or a message why there are none
+         */
+        template<typename F>
+        std::variant<pareto_t, std::string> searchPareto(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure, QueryWorkspace& workspace, F&& accept) const;
+
+        /**
+         * @brief Runs the range search over `routes` and `stops`
+         * 
+         * @tparam F Predicate on `raptor::ServiceId`, decides which trips can be used
+         * @param routes Routes used for the search
+         * @param stops Stops used for the search
+         * @param start Start stop
+         * @param end End stop
+         * @param first_departure Earliest departure from the start stop
+         * @param last_departure Latest departure from the start stop
+         * @param workspace Memory for the query
+         * @param accept Returns true for services whose trips can be used
+         * @return All Pareto optimal journeys or a message why there are none
+         */
+        template<typename F>
+        std::variant<profile_t, std::string> searchRange(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t first_departure, const Time_t last_departure, QueryWorkspace& workspace, F&& accept) const;
+
+        /**
+         * @brief Runs the search over `routes` and `stops`
+         * 
+         * @tparam F Callable `size_t(RouteId, size_t, Time_t)` with the same meaning as `raptor::RouteTraversal::earliestTripIndex`
+         * @param routes Routes used for the search
+         * @param stops Stops used for the search
+         * @param start Start stop
+         * @param end End stop
+         * @param departure Time of earliest departure from first stop
+         * @param workspace Memory for the query
+         * @param find_trip Returns index of the earliest usable trip of a route at a stop
+         * @param bounds Graph of `routes` and `stops` whose lower bounds prune stops that can't lead to an earlier arrival, nullptr to search without them
+         * @return Data about the connection in a special format
+         */
+        template<typename F>
+        std::variant<result_t, std::string> search(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure, QueryWorkspace& workspace, F&& find_trip, const LowerBoundGraph* bounds = nullptr) const;
+
+        /**
+         * @brief Runs the search for `raptor::lane_count` departures at once over `routes` and `stops`
+         * 
+         * Labels are left in `workspace.lanes`, arrivals in them are absolute.
+         * 
+         * @tparam F Callable `size_t(RouteId, size_t, Time_t)` with the same meaning as `raptor::RouteTraversal::earliestTripIndex`
+         * @param routes Routes used for the search
+         * @param stops Stops used for the search
+         * @param start Start stop
+         * @param departures One departure for each lane
+         * @param workspace Memory for the query
+         * @param find_trip Returns index of the earliest usable trip of a route at a stop
+         */
+        template<typename F>
+        void runLanes(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& start, const TimeLanes& departures, QueryWorkspace& workspace, F&& find_trip) const;
+
+        /**
+         * @brief Splits `departures` to groups of `raptor::lane_count` and runs `runLanes` for each group
+         * 
+         * @tparam F Callable `size_t(RouteId, size_t, Time_t)` with the same meaning as `raptor::RouteTraversal::earliestTripIndex`
+         * @param routes Routes used for the search
+         * @param stops Stops used for the search
+         * @param start Start stop
+         * @param departures Times of earliest departure from first stop
+         * @param workspace Memory for the query
+         * @param find_trip Returns index of the earliest usable trip of a route at a stop
+         * @return Arrivals for each departure in the order of `departures`
+         */
+        template<typename F>
+        std::vector<Arrivals> searchLanes(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& start, const std::vector<Time_t>& departures, QueryWorkspace& workspace, F&& find_trip) const;
+
+        /**
+         * @brief Scans routes of `workspace.potential_routes` by threads of `scan_pool_` and merges found labels in the order of routes
+         * 
+         * @tparam S Callable `void(size_t, RouteScanBuffer&)`
+         * @tparam M Callable `void(StopId, const Label&)`
+         * @param workspace Memory for the query
+         * @param scan Scans the route with the given index in `workspace.potential_routes`, keeps found labels in the buffer of its thread
+         * @param merge Called for found labels in the order of routes after all routes are scanned
+         */
+        template<typename S, typename M>
+        void scanParallel(QueryWorkspace& workspace, S&& scan, M&& merge) const;
+
+        /**
+         * @brief Runs rounds shared by all searches until no stop is marked
+         *
+         * A round queues routes of stops in `workspace.marked`, lets `scan` scan them and then tries walks from stops
+         * which `scan` marked. Labels are kept only by the callbacks, so every search handles its own labels.
+         *
+         * @tparam B Callable `bool(size_t, StopId)`
+         * @tparam S Callable `void(size_t)`
+         * @tparam W Callable `bool(size_t, StopId, StopId, Time_t)`
+         * @tparam E Callable `void(size_t)`
+         * @param stops Stops used for the search
+         * @param workspace Memory for the query, start stops must be marked
+         * @param board Called with the round and a marked stop, returns false if routes of the stop are not queued
+         * @param scan Called with the round to scan `workspace.potential_routes` and mark improved stops
+         * @param walk Called with the round, a marked stop, a target and a walk shorter than `RoutingEngine::max_walking_time`, returns true if the target improved
+         * @param end_round Called with the round after walks
+         */
+        template<typename B, typename S, typename W, typename E>
+        void scanRounds(const Stops& stops, QueryWorkspace& workspace, B&& board, S&& scan, W&& walk, E&& end_round) const;
+
+        /**
+         * @brief Scans one route for a search with one label per stop and round
+         *
+         * @tparam F Callable `size_t(RouteId, size_t, Time_t)` with the same meaning as `raptor::RouteTraversal::earliestTripIndex`
+         * @tparam A Callable `bool(StopId, Time_t)`
+         * @tparam I Callable `void(StopId, const Label&)`
+         * @param routes Routes used for the search
+         * @param labels Labels of the search, trips are boarded from labels of round `round - 1`
+         * @param route Scanned route
+         * @param stop_index Index of the first marked stop of the route
+         * @param round Current round
+         * @param departure Time subtracted from times of trips, arrivals in `labels` are relative to it
+         * @param find_trip Returns index of the earliest usable trip of a route at a stop
+         * @param accept Returns true if the arrival to the stop should become its label
+         * @param improve Called with accepted labels
+         */
+        template<typename F, typename A, typename I>
+        static void scanRoute(const RouteTraversal& routes, const RoundLabels& labels, RouteId route, size_t stop_index, size_t round, Time_t departure, F&& find_trip, A&& accept, I&& improve);
+
+        /**
+         * @brief Runs rounds of the search over `routes` and `stops` until no stop is improved
+         * 
+         * Labels are left in `workspace`, arrivals in them are relative to `departure`.
+         * 
+         * @tparam F Callable `size_t(RouteId, size_t, Time_t)` with the same meaning as `raptor::RouteTraversal::earliestTripIndex`
+         * @tparam B Callable `Time_t(size_t)`
+         * @param routes Routes used for the search
+         * @param stops Stops used for the search
+         * @param start Start stop
+         * @param departure Time of earliest departure from first stop
+         * @param workspace Memory for the query
+         * @param find_trip Returns index of the earliest usable trip of a route at a stop
+         * @param end_bound Called with the current round after labels change, returns relative arrival from which labels are pruned
+         * @param remaining Lower bound of the time from each stop to the ends, may be filled by `end_bound`, labels which can't arrive before the bound with it are pruned, nullptr or empty to prune without it
+         */
+        template<typename F, typename B>
+        void runRounds(const RouteTraversal& routes, const Stops& stops, const std::vector<StopId>& start, const Time_t departure, QueryWorkspace& workspace, F&& find_trip, B&& end_bound, const std::vector<Time_t>* remaining = nullptr) const;
+    };
+
+    /**
+     * @brief RAPTOR over a `raptor::ServiceTimetable`, runs `raptor::RouteFinder::findRoute`
+     * 
+     * Walking speed is taken from the options of the `raptor::RouteFinder`.
+     * 
+     */
+    class RaptorEngine final : public RoutingEngine
+    {
+    private:
+        const RouteFinder& finder_;
+        const ServiceTimetable& timetable_;
+        LowerBoundGraph bounds_;
+    public:
+        /**
+         * @brief Creates the engine for `timetable`, both arguments must outlive the engine
+         * 
+         * @param finder Finder which runs the search
+         * @param timetable Timetable to search
+         */
+        RaptorEngine(const RouteFinder& finder, const ServiceTimetable& timetable) : finder_(finder), timetable_(timetable), bounds_(timetable.routes, timetable.stops) { }
+
+        std::variant<path_t, std::string> findRoute(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure) const override;
+
+        /**
+         * @brief Same as `findRoute` above, but uses memory from `workspace` instead of a thread local one
+         * 
+         * @param start Start stop
+         * @param end End stop
+         * @param departure Time of earliest departure from first stop
+         * @param workspace Memory for the query, it can be reused by the following queries
+         * @return Data about the connection in a special format or a message why there is none
+         */
+        std::variant<path_t, std::string> findRoute(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure, QueryWorkspace& workspace) const;
     };
 }
 
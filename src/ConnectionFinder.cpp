@@ -1,7 +1,9 @@
 #include <Algorithm.hpp>
 #include <iostream>
+#include <filesystem>
 #include <sstream>
 #include <optional>
+#include <chrono>
 #include <unordered_set>
 
 using namespace std;
@@ -122,7 +124,7 @@ vector<StopId> find_stops_by_name(const std::string& stop_name, const gtfs::Feed
  * 
  * If some input data is invalid, it won't calculate anything and print error message
  * 
- * @param args First position start stop, second end stop, third departure time
+ * @param args First position start stop, second end stop, third departure time, optional fourth date
  * @param rf 
  * @param feed 
  */
@@ -133,7 +135,7 @@ void find_route(com_args_t::second_type& args, const RouteFinder& rf, const gtfs
         cout << "Missing arguments for 'findroute' command!\n";
         return;
     }
-    if (args->size() > 3)
+    if (args->size() > 4)
     {
         cout << "Provided too many arguments for 'findroute' command!\n";
         return;
@@ -161,9 +163,22 @@ void find_route(com_args_t::second_type& args, const RouteFinder& rf, const gtfs
         cout << "Invalid departure time!\n";
         return;
     }
+    optional<chrono::year_month_day> date;
+    if (arguments.size() == 4)
+    {
+        try
+        {
+            date = toDate(arguments[3]);
+        }
+        catch (exception&)
+        {
+            cout << "Invalid date!\n";
+            return;
+        }
+    }
     try
     {
-        auto result = rf.findRoute(start_stops, end_stops, departure_time);
+        auto result = date ? rf.findRoute(start_stops, end_stops, departure_time, date.value()) : rf.findRoute(start_stops, end_stops, departure_time);
         visit([&](auto&& arg)
         {
             using T = decay_t<decltype(arg)>;
@@ -193,7 +208,8 @@ void print_help()
     cout << prefix << "Usage...\n";
     cout << prefix << "At startup you need to type full path to a directory containing a GTFS feed.\n\n";
     cout << prefix << "Commands... 'name'|'alias' (arguments) \n";
-    cout << prefix << "'findroute'|'fr' (start stop, end stop, departure time - hh:mm) --- Find route between specified 'stops' starting at 'departure time'. ";
+    cout << prefix << "'findroute'|'fr' (start stop, end stop, departure time - hh:mm, optional: date - YYYYMMDD) --- Find route between specified 'stops' starting at 'departure time'. ";
+    cout << "If 'date' is given, trips running on that day are used instead of the set service. ";
     cout << "Arguments should be separated by '-'.\n";
     cout << prefix << "'help'|'h' --- Prints this help message.\n";
     cout << prefix << "'liststops'|'ls' (optional: prefix) --- Print a list of all/stops starting with 'prefix' stops in feed.\n";
@@ -401,8 +417,18 @@ int main()
    string feed_location;
    cin >> feed_location;
    cout << "Parsing feed, this step could take a while...\n";
-   gtfs::Feed feed(feed_location);
-   while (feed.read_feed() != gtfs::OK)
+   // stop times are mapped to memory by the route finder, shapes and other unused files are not read at all
+   gtfs::Feed feed;
+   filesystem::path stop_times;
+   auto read_feed = [&]()
+   {
+       feed = gtfs::Feed(feed_location);
+       if (GTFSFeedParser::readFeed(feed) != gtfs::OK)
+           return false;
+       stop_times = filesystem::path(feed_location) / "stop_times.txt";
+       return filesystem::is_regular_file(stop_times);
+   };
+   while (!read_feed())
    {
        if (!cin)
            return handle_cin_error();
@@ -410,11 +436,18 @@ int main()
        cout << term_name << " ";
        cin >> feed_location;
        cout << "Parsing feed, this step could take a while...\n";
-       feed = gtfs::Feed(feed_location);
    }
    getline(cin, feed_location);
    cout << "Feed OK, proceeding to generate required data structures. This step might take a while...\n";
-   RouteFinder rf(&feed);
-   cout << "Data structures generated. You may enter your queries now.\n" << "Type 'h' or 'help' to show query syntax.\n";
-   return main_loop(rf, feed);
+   try
+   {
+       RouteFinder rf(&feed, stop_times);
+       cout << "Data structures generated. You may enter your queries now.\n" << "Type 'h' or 'help' to show query syntax.\n";
+       return main_loop(rf, feed);
+   }
+   catch (const runtime_error& e)
+   {
+       cerr << "Invalid feed: " << e.what() << '\n';
+       return 1;
+   }
 }
@@ -0,0 +1,133 @@
+#include <ConnectionScan.hpp>
+#include <algorithm>
+#include <tuple>
+
+namespace raptor
+{
+	ConnectionScanEngine::ConnectionScanEngine(const RouteTraversal& routes, const Stops& stops, WalkingSpeed speed) : trip_count_(0)
+	{
+		for (size_t route = 0; route < routes.size(); ++route)
+		{
+			const Route& r = routes[route];
+			const size_t trips = r.trips();
+			for (size_t trip = 0; trip < trips; ++trip)
+			{
+				for (size_t index = 0; index + 1 < r.stops_count; ++index)
+				{
+					const Time_t departure = r.departures_ptr[index * trips + trip];
+					const Time_t arrival = r.arrivals_ptr[(index + 1) * trips + trip];
+					connections_.push_back(Connection{ r.route_stops_ptr[index], r.route_stops_ptr[index + 1], departure, arrival,
+						static_cast<uint32_t>(trip_count_ + trip), &*routes.tripAt(route, trip, index) });
+				}
+			}
+			trip_count_ += trips;
+		}
+		// a connection with zero duration comes before the following connection of its trip
+		std::ranges::stable_sort(connections_, [](const Connection& a, const Connection& b) { return std::tie(a.departure, a.arrival) < std::tie(b.departure, b.arrival); });
+
+		footpath_offsets_.reserve(stops.size() + 1);
+		for (size_t stop = 0; stop < stops.size(); ++stop)
+		{
+			footpath_offsets_.push_back(footpaths_.size());
+			for (auto&& transfer : stops.getTransfers(stop))
+			{
+				const Time_t walk = walkingTime(transfer.distance, speed);
+				if (walk < max_walking_time)
+					footpaths_.push_back(Footpath{ transfer.target_stop, walk + transfer_penalty });
+			}
+		}
+		footpath_offsets_.push_back(footpaths_.size());
+	}
+
+	StopId ConnectionScanEngine::scan(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure, ScanWorkspace& workspace) const
+	{
+		const size_t stop_count = footpath_offsets_.size() - 1;
+		auto& labels = workspace.labels;
+		auto& entered = workspace.trip_entered;
+		labels.assign(stop_count, ScanLabel{ inf_time, ScanLabel::npos, ScanLabel::npos, inf_time });
+		entered.assign(trip_count_, ScanLabel::npos);
+		Time_t end_arrival = inf_time;
+		StopId best_end = undefined::stop;
+		for (auto&& start : starts)
+		{
+			labels[start].arrival = departure;
+			if (std::ranges::find(ends, start) != ends.end())
+			{
+				end_arrival = departure;
+				best_end = start;
+			}
+		}
+		auto reach = [&](const StopId stop, const Time_t arrival, const size_t enter, const size_t exit)
+		{
+			labels[stop].arrival = arrival;
+			labels[stop].enter = enter;
+			labels[stop].exit = exit;
+			if (arrival < end_arrival && std::ranges::find(ends, stop) != ends.end())
+			{
+				end_arrival = arrival;
+				best_end = stop;
+			}
+		};
+		// trips depart strictly after arrival to their stop
+		auto first = std::ranges::upper_bound(connections_, departure, std::less<>(), &Connection::departure);
+		for (size_t index = first - connections_.begin(); index < connections_.size(); ++index)
+		{
+			const Connection& c = connections_[index];
+			// following connections can't arrive before the best end stop
+			if (c.departure >= end_arrival)
+				break;
+			if (entered[c.trip] == ScanLabel::npos)
+			{
+				if (labels[c.from].arrival >= c.departure)
+					continue;
+				entered[c.trip] = index;
+			}
+			// walks start from the arrival by a trip, even if the stop was reached earlier by a walk, see `RoutingEngine`
+			if (c.arrival >= labels[c.to].trip_arrival)
+				continue;
+			labels[c.to].trip_arrival = c.arrival;
+			if (c.arrival < labels[c.to].arrival)
+				reach(c.to, c.arrival, entered[c.trip], index);
+			for (size_t f = footpath_offsets_[c.to]; f < footpath_offsets_[c.to + 1]; ++f)
+			{
+				const Footpath& footpath = footpaths_[f];
+				if (c.arrival + footpath.time < labels[footpath.target].arrival)
+					reach(footpath.target, c.arrival + footpath.time, entered[c.trip], index);
+			}
+		}
+		return best_end;
+	}
+
+	const std::vector<ScanLabel>& ConnectionScanEngine::scanAll(const std::vector<StopId>& starts, const Time_t departure, ScanWorkspace& workspace) const
+	{
+		scan(starts, {}, departure, workspace);
+		return workspace.labels;
+	}
+
+	std::variant<path_t, std::string> ConnectionScanEngine::findRoute(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure) const
+	{
+		if (starts == ends)
+			return "Start and end are the same stop\n";
+		thread_local ScanWorkspace workspace;
+		const StopId best_end = scan(starts, ends, departure, workspace);
+		const auto& labels = workspace.labels;
+		if (best_end == undefined::stop)
+			return "End stop unreachable\n";
+		path_t v;
+		StopId stop = best_end;
+		// each label stores its whole leg, so the path does not depend on later changes of other labels
+		while (labels[stop].enter != ScanLabel::npos)
+		{
+			const ScanLabel& label = labels[stop];
+			const Connection& exit = connections_[label.exit];
+			const Connection& enter = connections_[label.enter];
+			v.push_back(std::pair(stop, label.arrival - departure));
+			if (exit.to != stop)
+				v.push_back(std::pair(exit.to, exit.arrival - departure));
+			v.push_back(RouteTraversal::trip_iterator(enter.record));
+			stop = enter.from;
+		}
+		v.push_back(std::pair(stop, labels[stop].arrival - departure));
+		return path_t(v.rbegin(), v.rend());
+	}
+}
@@ -0,0 +1,195 @@
+#ifndef CONNECTION_SCAN_HPP_
+#define CONNECTION_SCAN_HPP_
+
+#include <RoutingEngine.hpp>
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <limits>
+
+namespace raptor
+{
+	/**
+	 * @brief Ride of a trip between two following stops
+	 * 
+	 */
+	struct Connection
+	{
+		StopId from;
+		StopId to;
+		Time_t departure;
+		Time_t arrival;
+
+		/**
+		 * @brief Index of the trip among all trips of the timetable
+		 * 
+		 */
+		uint32_t trip;
+
+		/**
+		 * @brief Record of the trip at `from`
+		 * 
+		 */
+		const Trip* record;
+	};
+
+	/**
+	 * @brief Label of a stop in the connection scan, see `raptor::ConnectionScanEngine`
+	 * 
+	 */
+	struct ScanLabel
+	{
+		static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+		/**
+		 * @brief Absolute arrival to the stop, `raptor::inf_time` if not reached
+		 * 
+		 */
+		Time_t arrival;
+
+		/**
+		 * @brief Connection where the last trip was boarded, `npos` for start stops
+		 * 
+		 */
+		size_t enter;
+
+		/**
+		 * @brief Connection where the last trip was left, from its stop we walked here if it is not this stop
+		 * 
+		 */
+		size_t exit;
+
+		/**
+		 * @brief Earliest arrival to the stop by a trip, footpaths from the stop are used only when it improves
+		 * 
+		 */
+		Time_t trip_arrival;
+	};
+
+	/**
+	 * @brief Connection Scan Algorithm, finds the fastest connection by one pass over all connections sorted by departure
+	 * 
+	 * The connection array is read sequentially, so the query has no random access into routes,
+	 * only to labels of stops and flags of reached trips. It is often faster than RAPTOR on dense networks.
+	 * 
+	 */
+	class ConnectionScanEngine final : public RoutingEngine
+	{
+	public:
+		/**
+		 * @brief Walk from a stop to another stop with its time including the transfer penalty
+		 * 
+		 */
+		struct Footpath
+		{
+			StopId target;
+			Time_t time;
+		};
+	private:
+		/**
+		 * @brief All connections of the timetable sorted by departure and then by arrival
+		 * 
+		 */
+		std::vector<Connection> connections_;
+
+		/**
+		 * @brief Usable footpaths of stop `s` are `footpaths_[footpath_offsets_[s]]` to `footpaths_[footpath_offsets_[s+1]]`
+		 * 
+		 */
+		std::vector<size_t> footpath_offsets_;
+		std::vector<Footpath> footpaths_;
+
+		/**
+		 * @brief Number of trips in the timetable
+		 * 
+		 */
+		size_t trip_count_;
+
+	public:
+		/**
+		 * @brief Memory used by one scan, reused by the following scans of the same thread
+		 * 
+		 */
+		struct ScanWorkspace
+		{
+			/**
+			 * @brief Labels of stops, they are reset by every scan
+			 * 
+			 */
+			std::vector<ScanLabel> labels;
+
+			/**
+			 * @brief Connection where each trip was boarded, `raptor::ScanLabel::npos` if not boarded
+			 * 
+			 */
+			std::vector<size_t> trip_entered;
+		};
+	private:
+		/**
+		 * @brief Scans connections from `departure` and fills `workspace.labels`
+		 * 
+		 * @param starts Start stops
+		 * @param ends End stops, the scan stops when no connection can improve them, all stops are labeled if it is empty
+		 * @param departure Departure from start stops
+		 * @param workspace Workspace with labels
+		 * @return End stop with the earliest arrival or `raptor::undefined::stop` if no end was reached
+		 */
+		StopId scan(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure, ScanWorkspace& workspace) const;
+	public:
+		/**
+		 * @brief Builds connections from trips of `routes` and footpaths from transfers of `stops`
+		 * 
+		 * @param routes Routes of the timetable
+		 * @param stops Stops of the timetable
+		 * @param speed Walking speed used for footpaths
+		 */
+		ConnectionScanEngine(const RouteTraversal& routes, const Stops& stops, WalkingSpeed speed);
+
+		/**
+		 * @brief Returns all connections sorted by departure
+		 * 
+		 * @return Connections of the timetable
+		 */
+		const std::vector<Connection>& connections() const
+		{
+			return connections_;
+		}
+
+		/**
+		 * @brief Returns usable footpaths from `stop`
+		 * 
+		 * @param stop A stop
+		 * @return Footpaths from the stop
+		 */
+		std::span<const Footpath> footpaths(const StopId stop) const
+		{
+			return std::span(footpaths_.data() + footpath_offsets_[stop], footpaths_.data() + footpath_offsets_[stop + 1]);
+		}
+
+		/**
+		 * @brief Returns number of trips, `Connection::trip` is lower
+		 * 
+		 * @return Count of trips in the timetable
+		 */
+		size_t tripCount() const
+		{
+			return trip_count_;
+		}
+
+		/**
+		 * @brief Computes the earliest arrival to all stops from `starts`
+		 * 
+		 * Label of each stop stores its last trip, so the journey to any stop can be read from the labels.
+		 * 
+		 * @param starts Start stops
+		 * @param departure Departure from start stops
+		 * @param workspace Workspace which owns the returned labels
+		 * @return Label of each stop
+		 */
+		const std::vector<ScanLabel>& scanAll(const std::vector<StopId>& starts, const Time_t departure, ScanWorkspace& workspace) const;
+
+		std::variant<path_t, std::string> findRoute(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure) const override;
+	};
+}
+
+#endif // !CONNECTION_SCAN_HPP_
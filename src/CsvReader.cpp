@@ -0,0 +1,194 @@
+#include <CsvReader.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace raptor
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::filesystem::path& path) : data_(nullptr), size_(0), file_(INVALID_HANDLE_VALUE), mapping_(nullptr)
+	{
+		file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file_ == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Can't open " + path.string());
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file_, &size))
+		{
+			CloseHandle(file_);
+			throw std::runtime_error("Can't read size of " + path.string());
+		}
+		size_ = static_cast<size_t>(size.QuadPart);
+		// an empty file can't be mapped
+		if (size_ == 0)
+			return;
+		mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_ != nullptr)
+			data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+		if (data_ == nullptr)
+		{
+			if (mapping_ != nullptr)
+				CloseHandle(mapping_);
+			CloseHandle(file_);
+			throw std::runtime_error("Can't map " + path.string());
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (data_ != nullptr)
+			UnmapViewOfFile(data_);
+		if (mapping_ != nullptr)
+			CloseHandle(mapping_);
+		CloseHandle(file_);
+	}
+#else
+	MappedFile::MappedFile(const std::filesystem::path& path) : data_(nullptr), size_(0)
+	{
+		const int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			throw std::runtime_error("Can't open " + path.string());
+		struct stat info;
+		if (fstat(file, &info) != 0)
+		{
+			close(file);
+			throw std::runtime_error("Can't read size of " + path.string());
+		}
+		size_ = static_cast<size_t>(info.st_size);
+		// an empty file can't be mapped
+		if (size_ > 0)
+		{
+			void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+			if (data == MAP_FAILED)
+			{
+				close(file);
+				throw std::runtime_error("Can't map " + path.string());
+			}
+			madvise(data, size_, MADV_SEQUENTIAL);
+			data_ = static_cast<const char*>(data);
+		}
+		// the mapping stays valid without the descriptor
+		close(file);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (data_ != nullptr)
+			munmap(const_cast<char*>(data_), size_);
+	}
+#endif
+
+	CsvReader::CsvReader(const std::string_view text, const SimdLevel level)
+		: text_(text), level_(level), block_start_(0), separators_(0), newlines_(0), quoted_carry_(0), field_start_(0), line_(0)
+	{
+		if (!text_.empty())
+			classifyBlock();
+	}
+
+	void CsvReader::classifyBlock()
+	{
+		CsvBlockMasks masks;
+		if (block_start_ + csv_block_size <= text_.size())
+			masks = classifyCsvBlock(level_, text_.data() + block_start_);
+		else
+		{
+			// the last block is padded by spaces, which are not special
+			char block[csv_block_size];
+			std::memset(block, ' ', csv_block_size);
+			std::memcpy(block, text_.data() + block_start_, text_.size() - block_start_);
+			masks = classifyCsvBlock(level_, block);
+		}
+		// prefix xor of quotes sets bits from each opening quote to its closing quote
+		uint64_t quoted = masks.quotes;
+		for (size_t shift = 1; shift < csv_block_size; shift *= 2)
+			quoted ^= quoted << shift;
+		quoted ^= quoted_carry_;
+		quoted_carry_ = 0 - (quoted >> (csv_block_size - 1));
+		newlines_ = masks.newlines & ~quoted;
+		separators_ = (masks.commas & ~quoted) | newlines_;
+	}
+
+	void CsvReader::addField(std::vector<std::string_view>& fields, const size_t end, const bool last) const
+	{
+		std::string_view field = text_.substr(field_start_, end - field_start_);
+		if (last && !field.empty() && field.back() == '\r')
+			field.remove_suffix(1);
+		if (field.size() >= 2 && field.front() == '"' && field.back() == '"')
+			field = field.substr(1, field.size() - 2);
+		fields.push_back(field);
+	}
+
+	bool CsvReader::next(std::vector<std::string_view>& fields)
+	{
+		fields.clear();
+		if (field_start_ >= text_.size())
+			return false;
+		++line_;
+		while (true)
+		{
+			while (separators_ == 0)
+			{
+				block_start_ += csv_block_size;
+				if (block_start_ >= text_.size())
+				{
+					// the last row does not end by a newline
+					addField(fields, text_.size(), true);
+					field_start_ = text_.size();
+					return true;
+				}
+				classifyBlock();
+			}
+			const size_t bit = std::countr_zero(separators_);
+			separators_ &= separators_ - 1;
+			const size_t end = block_start_ + bit;
+			const bool last = (newlines_ >> bit) & 1;
+			addField(fields, end, last);
+			field_start_ = end + 1;
+			if (last)
+				return true;
+		}
+	}
+
+	bool CsvStreamReader::next(std::vector<std::string_view>& fields)
+	{
+		fields.clear();
+		if (!std::getline(in_, text_))
+			return false;
+		++line_;
+		std::string_view line = text_;
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+		size_t begin = 0;
+		while (true)
+		{
+			size_t end = begin;
+			if (begin < line.size() && line[begin] == '"')
+			{
+				// separators are searched after the closing quote, doubled quotes inside are skipped
+				end = begin + 1;
+				while (end < line.size() && (line[end] != '"' || (end + 1 < line.size() && line[end + 1] == '"')))
+					end += line[end] == '"' ? 2 : 1;
+				end = std::min(line.size(), end + 1);
+			}
+			end = std::min(line.find(',', end), line.size());
+			std::string_view field = line.substr(begin, end - begin);
+			if (field.size() >= 2 && field.front() == '"' && field.back() == '"')
+				field = field.substr(1, field.size() - 2);
+			fields.push_back(field);
+			if (end >= line.size())
+				break;
+			begin = end + 1;
+		}
+		return true;
+	}
+}
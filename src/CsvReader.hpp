@@ -0,0 +1,175 @@
+#ifndef CSV_READER_HPP_
+#define CSV_READER_HPP_
+
+#include <SimdKernels.hpp>
+#include <filesystem>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace raptor
+{
+	/**
+	 * @brief Read-only file mapped to memory
+	 *
+	 */
+	class MappedFile
+	{
+	private:
+		const char* data_;
+		size_t size_;
+#ifdef _WIN32
+		void* file_;
+		void* mapping_;
+#endif
+	public:
+		/**
+		 * @brief Maps the whole file
+		 *
+		 * @param path Path to the file
+		 * @throws std::runtime_error If the file can't be opened or mapped
+		 */
+		explicit MappedFile(const std::filesystem::path& path);
+		~MappedFile();
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile& operator=(const MappedFile& other) = delete;
+
+		/**
+		 * @brief Returns content of the file, valid while the object lives
+		 *
+		 * @return Content of the file
+		 */
+		std::string_view text() const
+		{
+			return std::string_view(data_, size_);
+		}
+	};
+
+	/**
+	 * @brief Splits CSV text in memory to rows and fields
+	 *
+	 * Text is classified by blocks of `raptor::csv_block_size` bytes with vector instructions. Quotes are turned
+	 * to a mask of quoted bytes by a prefix xor, so commas and newlines inside quotes are not separators.
+	 * Fields are views to the text, quotes around a field are removed, doubled quotes inside it stay doubled
+	 * and a carriage return at the end of a row is removed.
+	 *
+	 */
+	class CsvReader
+	{
+	private:
+		std::string_view text_;
+		SimdLevel level_;
+
+		/**
+		 * @brief Offset of the classified block in `text_`
+		 *
+		 */
+		size_t block_start_;
+
+		/**
+		 * @brief Separators of the block which were not read yet
+		 *
+		 */
+		uint64_t separators_;
+
+		/**
+		 * @brief Newlines of the block which are not quoted
+		 *
+		 */
+		uint64_t newlines_;
+
+		/**
+		 * @brief All ones if the block ended inside quotes, zero otherwise
+		 *
+		 */
+		uint64_t quoted_carry_;
+
+		size_t field_start_;
+		size_t line_;
+
+		/**
+		 * @brief Classifies the block starting at `block_start_`
+		 *
+		 */
+		void classifyBlock();
+
+		/**
+		 * @brief Appends the field from `field_start_` to `end` to `fields`
+		 *
+		 * @param fields Fields of the row
+		 * @param end End of the field in `text_`
+		 * @param last Whether the field ends the row
+		 */
+		void addField(std::vector<std::string_view>& fields, size_t end, bool last) const;
+	public:
+		/**
+		 * @brief Creates a reader of `text`, which must outlive it
+		 *
+		 * @param text CSV text
+		 * @param level Instruction set used for classification, must be supported by the CPU
+		 */
+		explicit CsvReader(std::string_view text, SimdLevel level = detectSimdLevel());
+
+		/**
+		 * @brief Reads the next row
+		 *
+		 * @param fields Fields of the row, views valid while the text lives
+		 * @return false If there are no more rows
+		 */
+		bool next(std::vector<std::string_view>& fields);
+
+		/**
+		 * @brief Returns number of the last read row, starting with 1
+		 *
+		 * @return Line number
+		 */
+		size_t line() const
+		{
+			return line_;
+		}
+	};
+
+	/**
+	 * @brief Splits CSV from a stream to rows and fields line by line
+	 *
+	 * Fields are the same as from `raptor::CsvReader`, but quoted fields can't contain newlines.
+	 *
+	 */
+	class CsvStreamReader
+	{
+	private:
+		std::istream& in_;
+		std::string text_;
+		size_t line_;
+	public:
+		/**
+		 * @brief Creates a reader of `in`, which must outlive it
+		 *
+		 * @param in Stream with CSV
+		 */
+		explicit CsvStreamReader(std::istream& in) : in_(in), text_(), line_(0) { }
+
+		/**
+		 * @brief Reads the next row
+		 *
+		 * @param fields Fields of the row, views valid until the next call
+		 * @return false If there are no more rows
+		 */
+		bool next(std::vector<std::string_view>& fields);
+
+		/**
+		 * @brief Returns number of the last read row, starting with 1
+		 *
+		 * @return Line number
+		 */
+		size_t line() const
+		{
+			return line_;
+		}
+	};
+}
+
+#endif // !CSV_READER_HPP_
@@ -1,10 +1,20 @@
 #include <DataStructures.hpp>
+#include <ThreadPool.hpp>
+#include <CsvReader.hpp>
 #include <algorithm>
-#include <unordered_map>
-#include <unordered_set>
+#include <array>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <memory_resource>
+#include <charconv>
+#include <stdexcept>
+#include <string>
 #include <ranges>
 #include <cmath>
 #include <numbers>
+#include <cstdint>
+#include <thread>
 
 namespace raptor
 {	
@@ -47,209 +57,448 @@ namespace raptor
 		return result;
 	}
 	
-	std::tuple_element_t<0, RTData> GTFSFeedParser::removeBadTrips(std::tuple_element_t<0, RTData>& data)
+	void GTFSFeedParser::radixSort(std::pmr::vector<StopTimeRecord>& records, std::pmr::vector<StopTimeRecord>& scratch)
 	{
-		auto result = std::tuple_element_t<0, RTData>();
-		result.reserve(data.size());
-		auto max_trip_sizes = findLongestTrips(data);
-		for (auto&& [rId, trips] : data)
+		constexpr size_t digit_bits = 8;
+		constexpr size_t digit_count = sizeof(uint64_t) * 8 / digit_bits;
+		constexpr uint64_t digit_mask = (1 << digit_bits) - 1;
+		std::array<std::array<size_t, digit_mask + 1>, digit_count> counts{};
+		for (auto&& record : records)
 		{
-			result.emplace_back(rId, std::tuple_element_t<0, RTData>::value_type::second_type());
-			auto condition = [&](const std::pair<TripId, RouteRawData::mapped_type> item)
-			{
-				return item.second.size() != max_trip_sizes[rId].first;
-			};
-			auto trips_copy = trips;
-			std::remove_copy_if(trips_copy.begin(), trips_copy.end(), std::back_inserter(result.back().second), condition);
+			for (size_t digit = 0; digit < digit_count; ++digit)
+				++counts[digit][(record.key >> (digit * digit_bits)) & digit_mask];
+		}
+		scratch.resize(records.size());
+		for (size_t digit = 0; digit < digit_count; ++digit)
+		{
+			auto&& count = counts[digit];
+			// all keys have the same digit, the pass would not move anything
+			if (std::ranges::find(count, records.size()) != count.end())
+				continue;
+			size_t offset = 0;
+			for (auto&& bucket : count)
+				offset += std::exchange(bucket, offset);
+			for (auto&& record : records)
+				scratch[count[(record.key >> (digit * digit_bits)) & digit_mask]++] = record;
+			records.swap(scratch);
 		}
-		return result;
 	}
-	
-	std::tuple_element_t<0, RTData> GTFSFeedParser::sortRouteRawData(std::unordered_map<RouteId, RouteRawData>&& data)
+
+	RTData GTFSFeedParser::buildRoutes(const std::pmr::vector<StopTimeRecord>& records, const std::pmr::vector<size_t>& trip_offsets,
+	                                   const std::pmr::vector<RouteId>& trip_routes, const std::pmr::vector<ServiceId>& trip_services,
+	                                   const size_t route_count, const size_t thread_count, std::pmr::memory_resource* arena)
 	{
-		std::tuple_element_t<0, RTData> result;
-		result.reserve(IdTranslator::getInstance().route_count());
-		for (size_t i = 0; i < IdTranslator::getInstance().route_count(); ++i)
+		const size_t trip_count = trip_routes.size();
+		auto trip_size = [&](const size_t trip) { return trip_offsets[trip + 1] - trip_offsets[trip]; };
+		// trips with stop times are counted by routes, trips of route `r` are `route_trips[route_offsets[r]]` to `route_trips[route_offsets[r+1]]`
+		std::pmr::vector<size_t> route_offsets(route_count + 1, 0, arena);
+		for (size_t trip = 0; trip < trip_count; ++trip)
 		{
-			result.emplace_back(i, std::vector<std::pair<TripId, RouteRawData::mapped_type>>());
+			if (trip_size(trip) > 0)
+				++route_offsets[static_cast<size_t>(trip_routes[trip]) + 1];
 		}
-		// sort individual blocks
-		for (auto&& [route, rd] : data)
+		std::partial_sum(route_offsets.begin(), route_offsets.end(), route_offsets.begin());
+		std::pmr::vector<size_t> route_trips(route_offsets.back(), arena);
 		{
-			for (auto&& [trip, td] : rd)
+			std::pmr::vector<size_t> next(route_offsets.begin(), route_offsets.end() - 1, arena);
+			for (size_t trip = 0; trip < trip_count; ++trip)
 			{
-				result[route].second.emplace_back(trip, std::move(td));
+				if (trip_size(trip) > 0)
+					route_trips[next[static_cast<size_t>(trip_routes[trip])]++] = trip;
 			}
 		}
-		
-		auto CompareBlock = [](const TripBlock& a, const TripBlock& b)
+
+		std::tuple_element_t<0, RTData> result;
+		result.reserve(route_count);
+		for (size_t route = 0; route < route_count; ++route)
+			result.emplace_back(route, std::vector<std::pair<TripId, std::vector<TripBlock>>>());
+		std::vector<std::pair<size_t, size_t>> sizes(route_count, std::pair(0, 0));
+		// every route writes only its own part of `route_trips` and its own entry of `result`
+		parallelFor(route_count, [&](const size_t route)
 		{
-			return a.departure < b.departure;
-		};
-		
-		auto CompareTrips = [](const std::pair<TripId, std::vector<TripBlock>>& lhs, const std::pair<TripId, std::vector<TripBlock>>& rhs)
+			auto trips = std::span(route_trips.begin() + route_offsets[route], route_trips.begin() + route_offsets[route + 1]);
+			if (trips.empty())
+				return;
+			// trips are in the order of trips.txt, so equal trips keep it
+			std::ranges::stable_sort(trips, std::less<>(), [&](const size_t trip) { return records[trip_offsets[trip]].arrival; });
+			size_t longest = trips.front();
+			for (auto&& trip : trips)
+			{
+				if (trip_size(trip) > trip_size(longest))
+					longest = trip;
+			}
+			auto same_stops = [&](const size_t trip)
+			{
+				return trip_size(trip) == trip_size(longest) &&
+					std::equal(records.begin() + trip_offsets[trip], records.begin() + trip_offsets[trip + 1], records.begin() + trip_offsets[longest],
+					           [](const StopTimeRecord& a, const StopTimeRecord& b) { return a.stop == b.stop; });
+			};
+			auto&& route_data = result[route].second;
+			route_data.reserve(std::ranges::count_if(trips, same_stops));
+			for (auto&& trip : trips)
+			{
+				if (!same_stops(trip))
+					continue;
+				std::vector<TripBlock> blocks;
+				blocks.reserve(trip_size(trip));
+				for (size_t index = trip_offsets[trip]; index < trip_offsets[trip + 1]; ++index)
+				{
+					auto&& record = records[index];
+					blocks.emplace_back(record.stop, trip_services[trip], record.arrival, record.departure);
+				}
+				route_data.emplace_back(TripId(trip), std::move(blocks));
+			}
+			sizes[route] = std::pair(trip_size(longest), route_data.size() * trip_size(longest));
+		}, thread_count);
+		size_t stopsCount = 0;
+		size_t tripsCount = 0;
+		for (auto&& [stops, stop_times] : sizes)
 		{
-			return lhs.second[0].arrival < rhs.second[0].arrival;
+			stopsCount += stops;
+			tripsCount += stop_times;
+		}
+		return { std::move(result), stopsCount, tripsCount };
+	}
+	
+	void GTFSFeedParser::fillMissingTimes(const gtfs::Feed& feed, std::pmr::vector<StopTimeRecord>& records, const std::pmr::vector<size_t>& trip_offsets)
+	{
+		auto&& stops = feed.get_stops();
+		auto stop_distance = [&](const StopTimeRecord& from, const StopTimeRecord& to)
+		{
+			auto&& a = stops[static_cast<size_t>(from.stop)];
+			auto&& b = stops[static_cast<size_t>(to.stop)];
+			return distance(a.stop_lat, a.stop_lon, b.stop_lat, b.stop_lon);
 		};
-		for (auto&& [routeId, routeData] : result)
+		for (size_t trip = 0; trip + 1 < trip_offsets.size(); ++trip)
 		{
-			for (auto&& [tripId, blocks] : routeData)
+			const size_t first = trip_offsets[trip];
+			const size_t last = trip_offsets[trip + 1];
+			if (first == last)
+				continue;
+			// a stop with only one of the times arrives and departs at it
+			for (size_t index = first; index < last; ++index)
+			{
+				auto&& record = records[index];
+				if (record.arrival == undefined_time)
+					record.arrival = record.departure;
+				else if (record.departure == undefined_time)
+					record.departure = record.arrival;
+			}
+			if (records[first].departure == undefined_time || records[last - 1].arrival == undefined_time)
+				throw std::runtime_error("stop_times.txt has no time at the first or last stop of trip " + feed.get_trips()[trip].trip_id);
+			// stops without times are placed between the neighbouring timepoints by the distance travelled,
+			// or evenly if the stops have the same position
+			size_t previous = first;
+			for (size_t next = first + 1; next < last; ++next)
 			{
-				std::sort(blocks.begin(), blocks.end(), CompareBlock);
+				if (records[next].arrival == undefined_time)
+					continue;
+				double total = 0;
+				for (size_t index = previous + 1; index <= next; ++index)
+					total += stop_distance(records[index - 1], records[index]);
+				const Time_t start = records[previous].departure;
+				const Time_t duration = records[next].arrival - start;
+				double covered = 0;
+				for (size_t index = previous + 1; index < next; ++index)
+				{
+					covered += stop_distance(records[index - 1], records[index]);
+					const double fraction = total > 0 ? covered / total : static_cast<double>(index - previous) / static_cast<double>(next - previous);
+					records[index].arrival = records[index].departure = start + static_cast<Time_t>(std::lround(fraction * duration));
+				}
+				previous = next;
 			}
-			std::sort(routeData.begin(), routeData.end(), CompareTrips);
 		}
-		auto CompareRoute = [](const std::tuple_element_t<0, RTData>::value_type& x1, const std::tuple_element_t<0, RTData>::value_type& x2)
-		{ 
-			return x1.first < x2.first;
-		};
-		std::sort(result.begin(), result.end(), CompareRoute);
-		result = removeBadTrips(result);
-		return result;
 	}
 
-	std::vector<StopRawData> GTFSFeedParser::sortStopRawData(std::unordered_map<StopId, StopData>&& data)
+	std::vector<std::vector<std::pair<StopId, double>>> GTFSFeedParser::findTransfers(const std::vector<gtfs::Stop>& stops, const double radius, const size_t thread_count)
 	{
-		std::vector<StopRawData> result;
-		for (auto&& d : data)
+		std::vector<std::vector<std::pair<StopId, double>>> result(stops.size());
+		if (stops.empty() || radius <= 0)
+			return result;
+		// rows of the grid have the same height, a degree of latitude is the same everywhere
+		constexpr double km_per_degree = 6371 * std::numbers::pi / 180;
+		const double cell_lat = radius / km_per_degree;
+		// a degree of longitude is the shortest at the latitude farthest from the equator, a row and its neighbours
+		// are split to the same number of columns around the whole parallel, at least one
+		auto column_count = [&](const int64_t row)
 		{
-			result.push_back(std::move(d));
-		}
-		auto CompareStops = [](const std::pair<StopId, StopData>& a, const std::pair<StopId, StopData>& b)
+			const double latitude = std::min(90.0, std::max(std::abs(row - 1.0), std::abs(row + 2.0)) * cell_lat);
+			return std::max<int64_t>(1, static_cast<int64_t>(std::floor(360 * km_per_degree * std::cos(toRadians(latitude)) / radius)));
+		};
+		// columns wrap at 180 degrees of longitude
+		auto column_of = [](const double longitude, const int64_t columns)
+		{
+			const int64_t column = static_cast<int64_t>(std::floor((longitude + 180) / 360 * static_cast<double>(columns)));
+			return (column % columns + columns) % columns;
+		};
+		// stops sorted by their cell, stops within `radius` are in the same or a neighbouring cell
+		using Cell = std::pair<int64_t, int64_t>;
+		auto cell_of = [&](const gtfs::Stop& stop)
 		{
-			return a.first < b.first;
+			const int64_t row = static_cast<int64_t>(std::floor(stop.stop_lat / cell_lat));
+			return Cell(row, column_of(stop.stop_lon, column_count(row)));
 		};
-		std::sort(result.begin(), result.end(), CompareStops);
+		std::vector<std::pair<Cell, size_t>> grid;
+		grid.reserve(stops.size());
+		for (size_t id = 0; id < stops.size(); ++id)
+			grid.emplace_back(cell_of(stops[id]), id);
+		std::ranges::sort(grid);
+		// every stop measures all its neighbours, so threads write only transfers of their own stops
+		parallelFor(stops.size(), [&](const size_t from_id)
+		{
+			auto&& from_stop = stops[from_id];
+			const int64_t from_row = cell_of(from_stop).first;
+			for (int64_t row = from_row - 1; row <= from_row + 1; ++row)
+			{
+				const int64_t columns = column_count(row);
+				const int64_t column = column_of(from_stop.stop_lon, columns);
+				// rows with fewer than three columns have fewer distinct neighbours
+				for (int64_t dlon = -1; dlon <= std::min<int64_t>(columns, 3) - 2; ++dlon)
+				{
+					auto cell = std::ranges::equal_range(grid, Cell(row, (column + dlon + columns) % columns), std::less<>(), [](const std::pair<Cell, size_t>& item) { return item.first; });
+					for (auto&& [to_cell, to_id] : cell)
+					{
+						if (to_id == from_id)
+							continue;
+						auto&& to_stop = stops[to_id];
+						auto dist = distance(from_stop.stop_lat, from_stop.stop_lon, to_stop.stop_lat, to_stop.stop_lon);
+						if (dist >= radius)
+							continue;
+						result[from_id].emplace_back(to_id, dist);
+					}
+				}
+			}
+			std::ranges::sort(result[from_id], std::less<>(), [](const std::pair<StopId, double>& transfer) { return static_cast<size_t>(transfer.first); });
+		}, thread_count);
 		return result;
 	}
-	
-	const Data GTFSFeedParser::parseFeed(const gtfs::Feed &feed)
+
+	const Data GTFSFeedParser::parseFeed(const gtfs::Feed &feed, const double transfer_radius, size_t thread_count)
 	{
+		if (thread_count == 0)
+			thread_count = std::max(1u, std::thread::hardware_concurrency());
 		GTFSFeedParser::prepareTranslator(feed);
-		std::unordered_map<RouteId, RouteRawData> result1;
-		std::unordered_map<RouteId, std::unordered_set<StopId>> stopsVisited;
-		std::unordered_map<RouteId, std::unordered_set<TripId>> tripsVisited;
-		std::unordered_map<StopId, std::unordered_set<RouteId>> stopRoutes;
 		auto&& stop_times = feed.get_stop_times();
 		auto tr = IdTranslator::getInstance;
-		for (auto&& stop_time : stop_times)
+		// temporary arrays live in one arena and are released together
+		std::pmr::monotonic_buffer_resource arena;
+		// stop times are translated in parallel shards to compact records
+		std::pmr::vector<StopTimeRecord> records(stop_times.size(), &arena);
+		auto time = [](const gtfs::Time& value)
 		{
-			TripId tId = IdTranslator::getInstance().at(stop_time.trip_id, IdTranslator::TripTag());
-			auto&& trip = feed.get_trips()[tId];        // I am indexing them based on this vector, so this is the correct trip
-			RouteId rId = IdTranslator::getInstance().at(InternalRouteId(trip.route_id, trip));
-			StopId sId = IdTranslator::getInstance().at(stop_time.stop_id, IdTranslator::StopTag());
-			ServiceId service = IdTranslator::getInstance().at(trip.service_id, IdTranslator::ServiceTag());
-			Time_t arrival = stop_time.arrival_time.get_total_seconds();
-			Time_t departure = stop_time.departure_time.get_total_seconds();
-			if (!stopsVisited.contains(rId))
-			{
-				stopsVisited.insert(std::make_pair(rId, std::unordered_set<StopId>(sId)));
-			}
-			stopsVisited[rId].insert(sId);
-		
-			if (!tripsVisited.contains(rId))
-			{
-				tripsVisited.insert(std::make_pair(rId, std::unordered_set<TripId>(tId)));
-			}
-			tripsVisited[rId].insert(tId);
-			
-			if (!stopRoutes.contains(sId))
-			{
-				stopRoutes.insert(std::make_pair(sId, std::unordered_set<RouteId>()));
-			}
-			stopRoutes[sId].insert(rId);
-			
-			if (!result1.contains(rId))
-			{
-				result1.insert(std::make_pair(rId, RouteRawData()));
-			}
-			if (!result1[rId].contains(tId))
+			return value.is_provided() ? static_cast<Time_t>(value.get_total_seconds()) : undefined_time;
+		};
+		const size_t shard_count = thread_count;
+		parallelFor(shard_count, [&](const size_t shard)
+		{
+			for (size_t row = stop_times.size() * shard / shard_count; row < stop_times.size() * (shard + 1) / shard_count; ++row)
 			{
-				result1[rId].insert(std::make_pair(tId, std::vector<TripBlock>()));
+				auto&& stop_time = stop_times[row];
+				const size_t tId = static_cast<size_t>(tr().at(stop_time.trip_id, IdTranslator::TripTag()));
+				records[row] = StopTimeRecord{ StopTimeRecord::makeKey(tId, static_cast<uint32_t>(stop_time.stop_sequence)),
+				                               tr().at(stop_time.stop_id, IdTranslator::StopTag()),
+				                               time(stop_time.arrival_time), time(stop_time.departure_time) };
 			}
-			result1[rId][tId].emplace_back(sId, service, arrival, departure);
+		}, thread_count);
+		return buildData(feed, records, transfer_radius, thread_count, &arena);
+	}
+
+	const Data GTFSFeedParser::parseFeed(const gtfs::Feed& feed, std::istream& stop_times, const double transfer_radius, size_t thread_count)
+	{
+		if (thread_count == 0)
+			thread_count = std::max(1u, std::thread::hardware_concurrency());
+		GTFSFeedParser::prepareTranslator(feed);
+		std::pmr::monotonic_buffer_resource arena;
+		// the arena would keep every buffer the growing vector leaves behind
+		std::pmr::vector<StopTimeRecord> records(std::pmr::new_delete_resource());
+		CsvStreamReader reader(stop_times);
+		readStopTimes(reader, records);
+		return buildData(feed, records, transfer_radius, thread_count, &arena);
+	}
+
+	const Data GTFSFeedParser::parseFeed(const gtfs::Feed& feed, const std::filesystem::path& stop_times, const double transfer_radius, size_t thread_count)
+	{
+		if (thread_count == 0)
+			thread_count = std::max(1u, std::thread::hardware_concurrency());
+		GTFSFeedParser::prepareTranslator(feed);
+		std::pmr::monotonic_buffer_resource arena;
+		MappedFile file(stop_times);
+		std::pmr::vector<StopTimeRecord> records(std::pmr::new_delete_resource());
+		CsvReader reader(file.text());
+		readStopTimes(reader, records);
+		return buildData(feed, records, transfer_radius, thread_count, &arena);
+	}
+
+	gtfs::Result GTFSFeedParser::readFeed(gtfs::Feed& feed, const bool read_shapes)
+	{
+		for (auto read : { &gtfs::Feed::read_stops, &gtfs::Feed::read_routes, &gtfs::Feed::read_trips })
+		{
+			auto result = (feed.*read)();
+			if (result != gtfs::OK)
+				return result;
 		}
-		size_t stopsCount = 0;
-		size_t tripsCount = 0;
-		for (auto&& [rId, stops] : stopsVisited)
+		// services can be defined only by one of the calendar files
+		for (auto read : { &gtfs::Feed::read_calendar, &gtfs::Feed::read_calendar_dates })
 		{
-			stopsCount += stops.size();
+			auto result = (feed.*read)();
+			if (result != gtfs::OK && result != gtfs::ERROR_FILE_ABSENT)
+				return result;
 		}
-		for (auto&& [rId, trips] : tripsVisited)
+		if (read_shapes)
+			return feed.read_shapes();
+		return gtfs::OK;
+	}
+
+	Time_t GTFSFeedParser::parseTime(const std::string_view time)
+	{
+		if (time.empty())
+			return undefined_time;
+		// hours can have any number of digits, minutes and seconds have two
+		Time_t hours = 0;
+		size_t index = 0;
+		while (index < time.size() && time[index] >= '0' && time[index] <= '9')
+			hours = hours * 10 + (time[index++] - '0');
+		auto two_digits = [&](size_t at)
+		{
+			if (at + 2 > time.size() || time[at] < '0' || time[at] > '5' || time[at + 1] < '0' || time[at + 1] > '9')
+				throw std::runtime_error("Invalid time " + std::string(time));
+			return (time[at] - '0') * 10 + (time[at + 1] - '0');
+		};
+		if (index == 0 || index + 6 != time.size() || time[index] != ':' || time[index + 3] != ':')
+			throw std::runtime_error("Invalid time " + std::string(time));
+		return hours * 60 * 60 + two_digits(index + 1) * 60 + two_digits(index + 4);
+	}
+
+	template<typename Reader>
+	void GTFSFeedParser::readStopTimes(Reader& reader, std::pmr::vector<StopTimeRecord>& records)
+	{
+		std::vector<std::string_view> fields;
+		if (!reader.next(fields))
+			throw std::runtime_error("stop_times.txt is empty");
+		// UTF-8 byte order mark
+		if (fields[0].starts_with("\xEF\xBB\xBF"))
+			fields[0].remove_prefix(3);
+		constexpr std::array<std::string_view, 5> columns = { "trip_id", "stop_id", "stop_sequence", "arrival_time", "departure_time" };
+		std::array<size_t, columns.size()> indices;
+		for (size_t column = 0; column < columns.size(); ++column)
 		{
-			tripsCount += trips.size() * stopsVisited[rId].size();
+			auto found = std::ranges::find(fields, columns[column]);
+			if (found == fields.end())
+				throw std::runtime_error("stop_times.txt has no column " + std::string(columns[column]));
+			indices[column] = found - fields.begin();
 		}
-		RTData d1{ sortRouteRawData(std::move(result1)), stopsCount, tripsCount };
-		
-		std::unordered_map<StopId, StopData> result2;
-		std::unordered_map<StopId, std::unordered_set<std::pair<StopId, double>>> transfers;
-		std::unordered_map<StopId, std::unordered_set<RouteId>> routes;
-		
-		size_t lower_bound = 0;
-		auto&& stops = feed.get_stops();
-		for (auto&& from_id : std::views::iota(0ul, tr().stop_count()))
+		const size_t field_count = std::ranges::max(indices) + 1;
+		auto tr = IdTranslator::getInstance;
+		// ids are looked up by `std::string`, these buffers are reused for all rows
+		std::string trip_id, stop_id;
+		while (reader.next(fields))
 		{
-			for (auto&& to_id : std::views::iota(lower_bound, tr().stop_count()))
+			const size_t row = reader.line();
+			if (fields.size() == 1 && fields[0].empty())
+				continue;
+			if (fields.size() < field_count)
+				throw std::runtime_error("stop_times.txt has too few fields on line " + std::to_string(row));
+			trip_id.assign(fields[indices[0]]);
+			stop_id.assign(fields[indices[1]]);
+			uint32_t sequence = 0;
+			auto sequence_field = fields[indices[2]];
+			auto [end, error] = std::from_chars(sequence_field.data(), sequence_field.data() + sequence_field.size(), sequence);
+			if (error != std::errc() || end != sequence_field.data() + sequence_field.size())
+				throw std::runtime_error("stop_times.txt has invalid stop_sequence on line " + std::to_string(row));
+			try
 			{
-				if (from_id == to_id)
-					continue;
-				auto&& from_stop = stops[from_id];
-				auto&& to_stop = stops[to_id];
-				auto dist = distance(from_stop.stop_lat, from_stop.stop_lon, to_stop.stop_lat, to_stop.stop_lon);
-				if (dist >= 1)
-					continue;
-				if (!transfers.contains(from_id))
-				{
-					transfers.emplace(from_id, std::unordered_set<std::pair<StopId, double>>());
-				}
-				transfers[from_id].insert(std::pair(to_id, dist));
-				if (!transfers.contains(to_id))
-				{
-					transfers.emplace(to_id, std::unordered_set<std::pair<StopId, double>>());
-				}
-				transfers[to_id].insert(std::pair(from_id, dist));
+				const size_t tId = static_cast<size_t>(tr().at(trip_id, IdTranslator::TripTag()));
+				records.push_back(StopTimeRecord{ StopTimeRecord::makeKey(tId, sequence), tr().at(stop_id, IdTranslator::StopTag()),
+				                                  parseTime(fields[indices[3]]), parseTime(fields[indices[4]]) });
+			}
+			catch (const std::out_of_range&)
+			{
+				throw std::runtime_error("stop_times.txt has unknown trip or stop on line " + std::to_string(row));
 			}
-			++lower_bound;
 		}
+	}
+
+	Data GTFSFeedParser::buildData(const gtfs::Feed& feed, std::pmr::vector<StopTimeRecord>& records, const double transfer_radius,
+	                               const size_t thread_count, std::pmr::memory_resource* arena)
+	{
+		auto&& trips = feed.get_trips();
+		auto tr = IdTranslator::getInstance;
+		// route and service are looked up once per trip, not once per stop time
+		std::pmr::vector<RouteId> trip_routes(trips.size(), arena);
+		std::pmr::vector<ServiceId> trip_services(trips.size(), arena);
+		const size_t shard_count = thread_count;
+		parallelFor(shard_count, [&](const size_t shard)
+		{
+			for (size_t tId = trips.size() * shard / shard_count; tId < trips.size() * (shard + 1) / shard_count; ++tId)
+			{
+				auto&& trip = trips[tId];        // I am indexing them based on this vector, so this is the correct trip
+				trip_routes[tId] = tr().at(InternalRouteId(trip.route_id, trip));
+				trip_services[tId] = tr().at(trip.service_id, IdTranslator::ServiceTag());
+			}
+		}, thread_count);
+		// records are sorted by trip and stop sequence
+		{
+			std::pmr::vector<StopTimeRecord> scratch(records.get_allocator());
+			radixSort(records, scratch);
+		}
+		std::pmr::vector<size_t> trip_offsets(trips.size() + 1, 0, arena);
+		for (auto&& record : records)
+			++trip_offsets[record.trip() + 1];
+		std::partial_sum(trip_offsets.begin(), trip_offsets.end(), trip_offsets.begin());
+		fillMissingTimes(feed, records, trip_offsets);
+		RTData d1 = buildRoutes(records, trip_offsets, trip_routes, trip_services, tr().route_count(), thread_count, arena);
+		
+		// every stop has an entry, even if no route or transfer uses it
+		std::vector<StopRawData> result2;
+		result2.reserve(tr().stop_count());
+		for (size_t sId = 0; sId < tr().stop_count(); ++sId)
+			result2.emplace_back(sId, StopData());
+		auto transfers = findTransfers(feed.get_stops(), transfer_radius, thread_count);
 		
 		size_t transfersCount = 0;
 		size_t routesCount = 0;
-		for (auto&& [sId, trans] : transfers)
+		for (auto&& sId : std::views::iota(0ul, transfers.size()))
 		{
-			transfersCount += trans.size();
-			result2[sId].transfers = std::vector(trans.begin(), trans.end());
+			if (transfers[sId].empty())
+				continue;
+			transfersCount += transfers[sId].size();
+			result2[sId].second.transfers = std::move(transfers[sId]);
 		}
-		for (auto&& [sId, route] : stopRoutes)
+		// stops of the first trip are stops of the route in `raptor::RouteTraversal`
+		for (auto&& [rId, route_trips] : std::get<0>(d1))
 		{
-			routesCount += route.size();
-			result2[sId].routes = std::vector<RouteId>(route.begin(), route.end());
+			if (route_trips.empty())
+				continue;
+			size_t index = 0;
+			for (auto&& block : route_trips.front().second)
+			{
+				auto&& routes = result2[static_cast<size_t>(block.sId)].second.routes;
+				// only the first occurrence of a stop on the route is stored
+				if (routes.empty() || routes.back().route != rId)
+				{
+					routes.emplace_back(rId, index);
+					++routesCount;
+				}
+				++index;
+			}
 		}
-		SData d2{ sortStopRawData(std::move(result2)), transfersCount, routesCount };
-		return { d1, d2 };
+		SData d2{ std::move(result2), transfersCount, routesCount };
+		return { std::move(d1), std::move(d2) };
 	}
 
 	void GTFSFeedParser::hashStops(const gtfs::Feed& feed)
 	{
-		for (auto&& stop : feed.get_stops())
-		{
-			IdTranslator::getInstance().insert(stop);
-		}
+		IdTranslator::getInstance().insert(feed.get_stops());
 	}
 
 	void GTFSFeedParser::hashRoutes(const gtfs::Feed& feed)
 	{
-		for (auto&& route : feed.get_routes())
-		{
-			IdTranslator::getInstance().insert(route);
-		}
+		IdTranslator::getInstance().insert(feed.get_routes());
 	}
 
 	void GTFSFeedParser::hashTrips(const gtfs::Feed& feed)
 	{
-		for (auto&& trip : feed.get_trips())
-		{
-			IdTranslator::getInstance().insert(trip);
-		}
+		IdTranslator::getInstance().insert(feed.get_trips());
 	}
 
 	void GTFSFeedParser::hashServices(const gtfs::Feed& feed)
@@ -258,14 +507,22 @@ namespace raptor
 		{
 			IdTranslator::getInstance().insert(service);
 		}
+		for (auto&& exception : feed.get_calendar_dates())
+		{
+			IdTranslator::getInstance().insert(exception);
+		}
 	}
 
 	void GTFSFeedParser::prepareTranslator(const gtfs::Feed& feed)
 	{
-		hashStops(feed);
-		hashRoutes(feed);
-		hashTrips(feed);
+		// each kind of id has its own map in `raptor::IdTranslator`
+		std::thread stops([&]() { hashStops(feed); });
+		std::thread routes([&]() { hashRoutes(feed); });
+		std::thread trips([&]() { hashTrips(feed); });
 		hashServices(feed);
+		stops.join();
+		routes.join();
+		trips.join();
 	}
 
 	InternalRouteId::InternalRouteId(const gtfs::Route& route, const gtfs::Trip& trip) : rId(route.route_id)
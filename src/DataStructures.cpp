@@ -1,10 +1,14 @@
 #include <DataStructures.hpp>
+#include <SimdKernels.hpp>
+#include <ThreadPool.hpp>
+#include <algorithm>
 
 namespace raptor
 {
 	const StopId undefined::stop = StopId();
 	const Trip undefined::trip = Trip();
 	const RouteId undefined::route = RouteId();
+	const StopRoute undefined::stopRoute = StopRoute();
 	const Transfer undefined::transfer = Transfer();
 	const ServiceId undefined::service = ServiceId();
 	const TripBlock undefined::tripBlock{ undefined::stop, service, undefined_time, undefined_time };
@@ -41,6 +45,10 @@ namespace raptor
 		std::swap(st_size_, other.st_size_);
 		std::swap(route_stops_, other.route_stops_);
 		std::swap(stop_times_, other.stop_times_);
+		std::swap(departures_, other.departures_);
+		std::swap(arrivals_, other.arrivals_);
+		std::swap(trip_services_, other.trip_services_);
+		std::swap(trip_ids_, other.trip_ids_);
 	}
 
 	RouteTraversal::RouteTraversal(const RTData& raw_data) : routes_()
@@ -51,13 +59,27 @@ namespace raptor
 		unsigned char* st_raw_memory = new unsigned char[tripCount * sizeof(Trip)];
 		route_stops_ = (StopId*)rs_raw_memory;
 		stop_times_ = (Trip*)st_raw_memory;
-		size_t next_rs_index = 0;
-		size_t next_st_index = 0;
-
+		// offsets of routes are prefix sums of their sizes, so routes can be copied in parallel
 		size_t prev_rs_count = 0;
 		size_t prev_st_count = 0;
 		for (auto&& [routeId, sData] : data)
 		{
+			size_t st_count = 0;
+			for (auto&& [tripId, blocks] : sData)
+				st_count += blocks.size();
+			const size_t rs_count = sData.empty() ? 0 : sData[longest_trips[routeId].second].second.size();
+			routes_.emplace_back(route_stops_ + prev_rs_count, stop_times_ + prev_st_count, rs_count, st_count);
+			prev_rs_count += rs_count;
+			prev_st_count += st_count;
+		}
+		rs_size_ = prev_rs_count;
+		st_size_ = prev_st_count;
+		routes_.emplace_back(route_stops_ + rs_size_, stop_times_ + st_size_, 0, 0);
+		parallelFor(data.size(), [&](const size_t route)
+		{
+			auto&& [routeId, sData] = data[route];
+			StopId* next_stop = route_stops_ + (routes_[route].route_stops_ptr - route_stops_);
+			Trip* next_trip = stop_times_ + (routes_[route].stop_times_ptr - stop_times_);
 			size_t index = 0;
 			for (auto&& [tripId, blocks] : sData)
 			{
@@ -65,23 +87,220 @@ namespace raptor
 				{
 					if (longest_trips[routeId].second == index)
 					{
-						route_stops_[next_rs_index] = block.sId;
-						++next_rs_index;
+						*next_stop = block.sId;
+						++next_stop;
 					}
-					new (stop_times_ + next_st_index) Trip(tripId, block.sId, block.service, block.arrival, block.departure);
-					++next_st_index;
+					new (next_trip) Trip(tripId, block.sId, block.service, block.arrival, block.departure);
+					++next_trip;
 				}
 				++index;
 			}
-			
-			routes_.emplace_back(route_stops_ + prev_rs_count, stop_times_ + prev_st_count, next_rs_index - prev_rs_count, next_st_index - prev_st_count);
-			auto&& prev = routes_.back();
-			prev_rs_count += prev.stops_count;
-			prev_st_count += prev.trip_count;
+		});
+		buildColumns();
+	}
+
+	void RouteTraversal::buildColumns()
+	{
+		size_t trips_total = 0;
+		size_t offset = 0;
+		std::vector<std::pair<size_t, size_t>> route_offsets;
+		route_offsets.reserve(routes_.size());
+		for (auto&& route : routes_)
+		{
+			route_offsets.emplace_back(trips_total, offset);
+			trips_total += route.trips();
+			offset += route.trips() * route.stops_count;
 		}
-		rs_size_ = prev_rs_count;
-		st_size_ = prev_st_count;
-		routes_.emplace_back(route_stops_ + rs_size_, stop_times_ + st_size_, 0, 0);
+		departures_.assign(st_size_, inf_time);
+		arrivals_.assign(st_size_, inf_time);
+		trip_services_.assign(trips_total, ServiceId());
+		trip_ids_.assign(trips_total, TripId());
+		// every route writes only its own part of the columns
+		parallelFor(routes_.size(), [&](const size_t route_index)
+		{
+			auto&& route = routes_[route_index];
+			auto&& [trip_offset, column_offset] = route_offsets[route_index];
+			const size_t trips = route.trips();
+			Time_t* columns = departures_.data() + column_offset;
+			Time_t* arrival_columns = arrivals_.data() + column_offset;
+			route.departures_ptr = columns;
+			route.arrivals_ptr = arrival_columns;
+			ServiceId* services = trip_services_.data() + trip_offset;
+			TripId* trip_ids = trip_ids_.data() + trip_offset;
+			route.services_ptr = services;
+			route.trip_ids_ptr = trip_ids;
+			for (size_t trip = 0; trip < trips; ++trip)
+			{
+				const Trip* row = route.stop_times_ptr + trip * route.stops_count;
+				services[trip] = row->sId;
+				trip_ids[trip] = row->tId;
+				for (size_t stop = 0; stop < route.stops_count; ++stop)
+				{
+					columns[stop * trips + trip] = row[stop].departure;
+					arrival_columns[stop * trips + trip] = row[stop].arrival;
+				}
+			}
+			route.sorted_departures = true;
+			for (size_t stop = 0; stop < route.stops_count && route.sorted_departures; ++stop)
+				route.sorted_departures = std::is_sorted(columns + stop * trips, columns + (stop + 1) * trips);
+		});
+	}
+
+	RouteTraversal::trip_iterator RouteTraversal::findEarliestTrip(RouteId route, size_t stop_index, Time_t time, ServiceId service) const
+	{
+		const size_t trip = earliestTripIndex(route, stop_index, time, service);
+		if (trip == no_trip)
+			return undefined_trip;
+		return tripAt(route, trip, stop_index);
+	}
+
+	size_t RouteTraversal::earliestTripIndex(RouteId route, size_t stop_index, Time_t time, ServiceId service) const
+	{
+		return earliestTripIndex(route, stop_index, time, [service](ServiceId s) { return s == service; });
+	}
+
+	size_t RouteTraversal::earliestTripIndex(RouteId route, size_t stop_index, Time_t time) const
+	{
+		// sorted columns are narrowed by binary search to a block, which is then searched by a vector kernel
+		constexpr size_t block_size = 32;
+		auto&& r = routes_[route];
+		const size_t trips = r.trips();
+		const Time_t* column = r.departures_ptr + stop_index * trips;
+		size_t lower = 0;
+		if (r.sorted_departures)
+		{
+			size_t upper = trips;
+			while (upper - lower > block_size)
+			{
+				const size_t middle = lower + (upper - lower) / 2;
+				if (column[middle] > time)
+					upper = middle + 1;
+				else
+					lower = middle + 1;
+			}
+		}
+		const size_t trip = lower + findFirstGreater(column + lower, trips - lower, time);
+		return trip < trips ? trip : no_trip;
+	}
+
+	RouteTraversal::RouteTraversal(const RouteTraversal& full, ServiceId service) : RouteTraversal(full.selectService(service)) { }
+
+	RTData RouteTraversal::selectService(ServiceId service) const
+	{
+		RTData result;
+		auto&& [data, stopCount, tripCount] = result;
+		stopCount = 0;
+		tripCount = 0;
+		data.reserve(size());
+		for (size_t route = 0; route < size(); ++route)
+		{
+			auto&& r = routes_[route];
+			data.emplace_back(route, std::tuple_element_t<0, RTData>::value_type::second_type());
+			auto&& trips = data.back().second;
+			for (size_t trip = 0; trip < r.trips(); ++trip)
+			{
+				if (r.services_ptr[trip] != service)
+					continue;
+				std::vector<TripBlock> blocks;
+				blocks.reserve(r.stops_count);
+				for (auto&& record : std::ranges::subrange(r.stop_times_ptr + trip * r.stops_count, r.stop_times_ptr + (trip + 1) * r.stops_count))
+					blocks.emplace_back(record.stopId, record.sId, record.arrival, record.departure);
+				trips.emplace_back(r.trip_ids_ptr[trip], std::move(blocks));
+			}
+			if (!trips.empty())
+			{
+				stopCount += r.stops_count;
+				tripCount += trips.size() * r.stops_count;
+			}
+		}
+		return result;
+	}
+
+	RouteTraversal::RouteTraversal(const RouteTraversal& one_day, size_t day_count, size_t service_stride)
+		: RouteTraversal(one_day.unrollDays(day_count, service_stride)) { }
+
+	RTData RouteTraversal::unrollDays(size_t day_count, size_t service_stride) const
+	{
+		// the largest service of a copy is `day_count * service_stride - 1`, the largest value means an undefined service
+		if (service_stride != 0 && day_count > std::numeric_limits<ServiceId::value_type>::max() / service_stride)
+			throw std::runtime_error("Too many services to copy trips to " + std::to_string(day_count) + " days");
+		RTData result;
+		auto&& [data, stopCount, tripCount] = result;
+		stopCount = 0;
+		tripCount = 0;
+		data.reserve(size());
+		for (size_t route = 0; route < size(); ++route)
+		{
+			auto&& r = routes_[route];
+			data.emplace_back(route, std::tuple_element_t<0, RTData>::value_type::second_type());
+			auto&& trips = data.back().second;
+			for (size_t day = 0; day < day_count; ++day)
+			{
+				const Time_t shift = (static_cast<Time_t>(day) - 1) * seconds_per_day;
+				for (size_t trip = 0; trip < r.trips(); ++trip)
+				{
+					const Trip* row = r.stop_times_ptr + trip * r.stops_count;
+					if (day == 0 && row[r.stops_count - 1].arrival < seconds_per_day)
+						continue;
+					std::vector<TripBlock> blocks;
+					blocks.reserve(r.stops_count);
+					for (auto&& record : std::ranges::subrange(row, row + r.stops_count))
+						blocks.emplace_back(record.stopId, record.sId + day * service_stride, record.arrival + shift, record.departure + shift);
+					trips.emplace_back(r.trip_ids_ptr[trip], std::move(blocks));
+				}
+			}
+			// same order of trips as in `raptor::GTFSFeedParser::buildRoutes`
+			std::stable_sort(trips.begin(), trips.end(), [](auto&& lhs, auto&& rhs) { return lhs.second[0].arrival < rhs.second[0].arrival; });
+			if (!trips.empty())
+			{
+				stopCount += r.stops_count;
+				tripCount += trips.size() * r.stops_count;
+			}
+		}
+		return result;
+	}
+
+	RouteTraversal::RouteTraversal(const RouteTraversal& forward, Time_t origin, ReversedTag)
+		: RouteTraversal(forward.reverse(origin)) { }
+
+	RTData RouteTraversal::reverse(Time_t origin) const
+	{
+		RTData result;
+		auto&& [data, stopCount, tripCount] = result;
+		stopCount = 0;
+		tripCount = 0;
+		data.reserve(size());
+		for (size_t route = 0; route < size(); ++route)
+		{
+			auto&& r = routes_[route];
+			data.emplace_back(route, std::tuple_element_t<0, RTData>::value_type::second_type());
+			auto&& trips = data.back().second;
+			trips.reserve(r.trips());
+			for (size_t trip = r.trips(); trip-- > 0;)
+			{
+				const Trip* row = r.stop_times_ptr + trip * r.stops_count;
+				std::vector<TripBlock> blocks;
+				blocks.reserve(r.stops_count);
+				// arrival to a stop becomes departure from it
+				for (auto&& record : std::ranges::subrange(row, row + r.stops_count) | std::views::reverse)
+					blocks.emplace_back(record.stopId, record.sId, origin - record.departure, origin - record.arrival);
+				trips.emplace_back(r.trip_ids_ptr[trip], std::move(blocks));
+			}
+			if (!trips.empty())
+			{
+				stopCount += r.stops_count;
+				tripCount += trips.size() * r.stops_count;
+			}
+		}
+		return result;
+	}
+
+	RouteId RouteTraversal::routeOf(trip_iterator trip) const
+	{
+		const Trip* record = &*trip;
+		// empty routes share their pointer with the following route, the last route with a not greater pointer owns the record
+		auto after = std::ranges::upper_bound(routes_, record, std::less<>(), &Route::stop_times_ptr);
+		return static_cast<RouteId>(after - routes_.begin() - 1);
 	}
 
 	size_t RouteTraversal::size() const 
@@ -109,6 +328,14 @@ namespace raptor
 		std::swap(st_size_, other.st_size_);
 		std::swap(route_stops_, other.route_stops_);
 		std::swap(stop_times_, other.stop_times_);
+		departures_.clear();
+		arrivals_.clear();
+		trip_services_.clear();
+		trip_ids_.clear();
+		std::swap(departures_, other.departures_);
+		std::swap(arrivals_, other.arrivals_);
+		std::swap(trip_services_, other.trip_services_);
+		std::swap(trip_ids_, other.trip_ids_);
 		return *this;
 	}
 	
@@ -151,6 +378,7 @@ namespace raptor
 		rs_size_ = prev_rs_count;
 		st_size_ = prev_st_count;
 		routes_.emplace_back(route_stops_ + rs_size_, stop_times_ + st_size_, 0, 0);
+		buildColumns();
 		return *this;
 	}
 
@@ -171,7 +399,7 @@ namespace raptor
 
 	Transfer::Transfer(const StopId tar_stop, const double dist) : target_stop(tar_stop), distance(dist) { }
 
-	Stop::Stop(const RouteId* sr_ptr, const Transfer* tr_ptr) : stop_routes_ptr(sr_ptr), transfers_ptr(tr_ptr) { }
+	Stop::Stop(const StopRoute* sr_ptr, const Transfer* tr_ptr) : stop_routes_ptr(sr_ptr), transfers_ptr(tr_ptr) { }
 	
 	Stops::Stops(Stops&& other) noexcept : stop_routes_(nullptr), transfers_(nullptr)
 	{
@@ -184,13 +412,13 @@ namespace raptor
 	{
 		auto&& [data, tr_count, r_count] = raw_data;
 		unsigned char* tr_raw_memory = new unsigned char[(tr_count) * sizeof(Transfer)];
-		unsigned char* r_raw_memory = new unsigned char[(r_count) * sizeof(RouteId)];
+		unsigned char* r_raw_memory = new unsigned char[(r_count) * sizeof(StopRoute)];
 		Transfer* tr_ptr = (Transfer*)tr_raw_memory;
-		RouteId* r_ptr = (RouteId*)r_raw_memory;
+		StopRoute* r_ptr = (StopRoute*)r_raw_memory;
 		stop_routes_ = r_ptr;
 		transfers_ = tr_ptr;
 		Transfer* prev_tr = tr_ptr;
-		RouteId* prev_r = r_ptr;
+		StopRoute* prev_r = r_ptr;
 		for (auto&& [sId, sData] : data)
 		{
 			for (auto&& [from_sId, dist] : sData.transfers)
@@ -200,7 +428,7 @@ namespace raptor
 			}
 			for (auto&& route : sData.routes)
 			{
-				*r_ptr = route;
+				new (r_ptr) StopRoute(route);
 				++r_ptr;
 			}
 			stops_.emplace_back(prev_r, prev_tr);
@@ -210,6 +438,120 @@ namespace raptor
 		stops_.emplace_back(r_ptr, tr_ptr);
 	}
 
+	Stops::Stops(const Stops& full, const RouteTraversal& routes) : Stops(selectRoutes(full, routes)) { }
+
+	SData Stops::selectRoutes(const Stops& full, const RouteTraversal& routes)
+	{
+		SData raw_data;
+		auto&& [data, tr_count, r_count] = raw_data;
+		tr_count = 0;
+		r_count = 0;
+		data.reserve(full.size());
+		for (size_t stop = 0; stop < full.size(); ++stop)
+		{
+			StopData stop_data;
+			for (auto&& transfer : full.getTransfers(stop))
+				stop_data.transfers.emplace_back(transfer.target_stop, transfer.distance);
+			for (auto&& stop_route : full.getRoutes(stop))
+			{
+				if (routes[stop_route.route].trip_count == 0)
+					continue;
+				auto&& route_stops = routes.getStops(stop_route.route);
+				const size_t index = std::ranges::find(route_stops, static_cast<StopId>(stop)) - route_stops.begin();
+				stop_data.routes.emplace_back(stop_route.route, index);
+			}
+			tr_count += stop_data.transfers.size();
+			r_count += stop_data.routes.size();
+			data.emplace_back(stop, std::move(stop_data));
+		}
+		return raw_data;
+	}
+
+	ReversedTimetable::ReversedTimetable(const RouteTraversal& forward_routes, const Stops& forward_stops)
+		: routes(forward_routes, origin, RouteTraversal::ReversedTag()), stops(forward_stops, routes) { }
+
+	RouteTraversal::trip_iterator ReversedTimetable::forwardTrip(const RouteTraversal& forward_routes, RouteTraversal::trip_iterator trip, StopId stop) const
+	{
+		const RouteId route = routes.routeOf(trip);
+		const Route& r = routes[route];
+		const size_t offset = &*trip - r.stop_times_ptr;
+		const size_t forward_trip = r.trips() - 1 - offset / r.stops_count;
+		// the trip was boarded in reversed time where it was left in forward time, `stop` is the closest occurrence before it
+		size_t index = r.stops_count - 1 - offset % r.stops_count;
+		const StopId* forward_stops = forward_routes[route].route_stops_ptr;
+		while (index > 0 && forward_stops[index] != stop)
+			--index;
+		return forward_routes.tripAt(route, forward_trip, index);
+	}
+
+	ServiceTimetable::ServiceTimetable(const RouteTraversal& full_routes, const Stops& full_stops, ServiceId service)
+		: routes(RouteTraversal(full_routes, service), 2, 0), stops(full_stops, routes) { }
+
+	ServiceCalendar::ServiceCalendar(const gtfs::Feed& feed) : ServiceCalendar()
+	{
+		using std::chrono::sys_days;
+		auto tr = IdTranslator::getInstance;
+		std::optional<sys_days> first;
+		std::optional<sys_days> last;
+		auto extend = [&](const sys_days day)
+		{
+			if (!first || day < *first)
+				first = day;
+			if (!last || day > *last)
+				last = day;
+		};
+		for (auto&& item : feed.get_calendar())
+		{
+			extend(toDate(item.start_date.get_raw_date()));
+			extend(toDate(item.end_date.get_raw_date()));
+		}
+		for (auto&& exception : feed.get_calendar_dates())
+		{
+			extend(toDate(exception.date.get_raw_date()));
+		}
+		if (!first)
+			return;
+		first_day_ = *first;
+		day_count_ = (*last - *first).count() + 1;
+		words_per_service_ = (day_count_ + word_bits - 1) / word_bits;
+		days_.assign(tr().service_count() * words_per_service_, 0);
+		auto set = [&](const ServiceId service, const size_t day, const bool active)
+		{
+			auto&& word = days_[service * words_per_service_ + day / word_bits];
+			const uint64_t bit = uint64_t(1) << (day % word_bits);
+			word = active ? word | bit : word & ~bit;
+		};
+		for (auto&& item : feed.get_calendar())
+		{
+			// indexed by std::chrono::weekday::c_encoding, Sunday is 0
+			const gtfs::CalendarAvailability week[] = { item.sunday, item.monday, item.tuesday, item.wednesday, item.thursday, item.friday, item.saturday };
+			const ServiceId service = tr().at(item);
+			const sys_days end = toDate(item.end_date.get_raw_date());
+			for (sys_days day = toDate(item.start_date.get_raw_date()); day <= end; day += std::chrono::days(1))
+			{
+				if (week[std::chrono::weekday(day).c_encoding()] == gtfs::CalendarAvailability::Available)
+					set(service, (day - first_day_).count(), true);
+			}
+		}
+		// exceptions override the weekly pattern
+		for (auto&& exception : feed.get_calendar_dates())
+		{
+			const ServiceId service = tr().at(exception.service_id, IdTranslator::ServiceTag());
+			const sys_days day = toDate(exception.date.get_raw_date());
+			set(service, (day - first_day_).count(), exception.exception_type == gtfs::CalendarDateException::Added);
+		}
+	}
+
+	std::optional<size_t> ServiceCalendar::dayIndex(const std::chrono::year_month_day date) const
+	{
+		if (!date.ok())
+			return std::nullopt;
+		const auto offset = (std::chrono::sys_days(date) - first_day_).count();
+		if (offset < 0 || static_cast<size_t>(offset) >= day_count_)
+			return std::nullopt;
+		return offset;
+	}
+
 	size_t Stops::size() const
 	{
 		return stops_.size() - 1;
@@ -239,13 +581,13 @@ namespace raptor
 		stops_ = std::vector<Stop>();
 		auto&& [data, tr_count, r_count] = raw_data;
 		unsigned char* tr_raw_memory = new unsigned char[(tr_count) * sizeof(Transfer)];
-		unsigned char* r_raw_memory = new unsigned char[(r_count) * sizeof(RouteId)];
+		unsigned char* r_raw_memory = new unsigned char[(r_count) * sizeof(StopRoute)];
 		Transfer* tr_ptr = (Transfer*)tr_raw_memory;
-		RouteId* r_ptr = (RouteId*)r_raw_memory;
+		StopRoute* r_ptr = (StopRoute*)r_raw_memory;
 		stop_routes_ = r_ptr;
 		transfers_ = tr_ptr;
 		Transfer* prev_tr = tr_ptr;
-		RouteId* prev_r = r_ptr;
+		StopRoute* prev_r = r_ptr;
 		for (auto&& [sId, sData] : data)
 		{
 			for (auto&& [from_sId, dist] : sData.transfers)
@@ -255,7 +597,7 @@ namespace raptor
 			}
 			for (auto&& route : sData.routes)
 			{
-				*r_ptr = route;
+				new (r_ptr) StopRoute(route);
 				++r_ptr;
 			}
 			stops_.emplace_back(prev_r, prev_tr);
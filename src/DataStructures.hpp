@@ -5,8 +5,18 @@
 #include <ranges>
 #include <algorithm>
 #include <iterator>
+#include <concepts>
+#include <chrono>
+#include <optional>
+#include <memory>
+#include <memory_resource>
+#include <istream>
+#include <string_view>
+#include <filesystem>
+#include <cstdint>
 #include <just_gtfs.h>
 #include <RaptorTypesAndConstants.hpp>
+#include <SimdKernels.hpp>
 
 namespace raptor
 {
@@ -52,12 +62,14 @@ namespace raptor
 		static const StopId stop;
 		static const Trip trip;
 		static const RouteId route;
+		static const StopRoute stopRoute;
 		static const ServiceId service;
 		static const Transfer transfer;
 		static const TripBlock tripBlock;
 		static const StopId& get(StopId) { return undefined::stop; }
 		static const Trip& get(Trip) { return undefined::trip; }
 		static const RouteId& get(RouteId) { return undefined::route; }
+		static const StopRoute& get(StopRoute) { return undefined::stopRoute; }
 		static const Transfer& get(Transfer) { return undefined::transfer; }
 	};
 	
@@ -267,6 +279,48 @@ namespace raptor
 		const Trip* stop_times_ptr;
 		size_t trip_count;
 		size_t stops_count;
+
+		/**
+		 * @brief Departures stored by stops, for each stop one column with departures of all trips
+		 * 
+		 * Column for stop at index `i` starts at `departures_ptr + i * trips()`
+		 * 
+		 */
+		const Time_t* departures_ptr = nullptr;
+
+		/**
+		 * @brief Arrivals stored by stops in the same layout as `departures_ptr`
+		 * 
+		 */
+		const Time_t* arrivals_ptr = nullptr;
+
+		/**
+		 * @brief Service of each trip
+		 * 
+		 */
+		const ServiceId* services_ptr = nullptr;
+
+		/**
+		 * @brief Id of each trip
+		 * 
+		 */
+		const TripId* trip_ids_ptr = nullptr;
+
+		/**
+		 * @brief True if every departure column is sorted, so it can be binary searched
+		 * 
+		 */
+		bool sorted_departures = true;
+
+		/**
+		 * @brief Number of trips of the route
+		 * 
+		 * @return Count of trips
+		 */
+		size_t trips() const
+		{
+			return stops_count == 0 ? 0 : trip_count / stops_count;
+		}
 	};
 	
 	/**
@@ -287,12 +341,108 @@ namespace raptor
 		Trip* stop_times_;
 		size_t rs_size_ = 0;
 		size_t st_size_ = 0;
+
+		/**
+		 * @brief Storage for `raptor::Route::departures_ptr` of all routes
+		 * 
+		 */
+		std::vector<Time_t> departures_;
+
+		/**
+		 * @brief Storage for `raptor::Route::arrivals_ptr` of all routes
+		 * 
+		 */
+		std::vector<Time_t> arrivals_;
+
+		/**
+		 * @brief Storage for `raptor::Route::services_ptr` of all routes
+		 * 
+		 */
+		std::vector<ServiceId> trip_services_;
+
+		/**
+		 * @brief Storage for `raptor::Route::trip_ids_ptr` of all routes
+		 * 
+		 */
+		std::vector<TripId> trip_ids_;
+
+		/**
+		 * @brief Builds arrival and departure columns and per trip data from `stop_times_` for each route
+		 * 
+		 */
+		void buildColumns();
+
+		/**
+		 * @brief Creates data for a `raptor::RouteTraversal` with only trips of `service`
+		 * 
+		 * @param service Wanted service
+		 * @return Data with the same routes, routes without trips of `service` are empty
+		 */
+		RTData selectService(ServiceId service) const;
+
+		/**
+		 * @brief Creates data for a `raptor::RouteTraversal` with trips copied to `day_count` following days
+		 * 
+		 * @param day_count Number of days, the first one is the day before the current day
+		 * @param service_stride Difference between services of copies on two following days
+		 * @return Data with the same routes and shifted copies of trips
+		 */
+		RTData unrollDays(size_t day_count, size_t service_stride) const;
+
+		/**
+		 * @brief Creates data for a `raptor::RouteTraversal` with reversed stops and time
+		 * 
+		 * @param origin Time `t` becomes `origin - t`
+		 * @return Data with the same routes, stops of each route and trips of each route are in the opposite order
+		 */
+		RTData reverse(Time_t origin) const;
 	public:
+		/**
+		 * @brief Tag selecting the constructor of a reversed traversal
+		 * 
+		 */
+		struct ReversedTag { };
+
 		size_t size() const;
 		RouteTraversal() : route_stops_(nullptr), stop_times_(nullptr) { }
 		RouteTraversal(const RouteTraversal& other) = delete;
 		RouteTraversal(RouteTraversal&& other) noexcept;
 		RouteTraversal(const RTData& raw_data);
+
+		/**
+		 * @brief Constructs a traversal with the same routes as `full`, but only with trips of `service`
+		 * 
+		 * @param full Traversal with all trips
+		 * @param service Wanted service
+		 */
+		RouteTraversal(const RouteTraversal& full, ServiceId service);
+
+		/**
+		 * @brief Constructs a traversal where trips of `one_day` are copied to more days on one continuous timeline
+		 * 
+		 * Copy on day `d` has times shifted by `(d - 1)` days, so day 0 is the day before the current day
+		 * and day 1 is the current day. Copy on the day before is kept only if the trip runs after midnight.
+		 * Copy of a trip with service `s` on day `d` gets service `s + d * service_stride`.
+		 * Routes and stops stay the same, so `raptor::Stops` of `one_day` can be used with this traversal.
+		 * 
+		 * @param one_day Traversal with trips of one day
+		 * @param day_count Number of days
+		 * @param service_stride Difference between services of copies on two following days, 0 keeps services unchanged
+		 * @throws std::runtime_error If services of the copies don't fit to `raptor::ServiceId`
+		 */
+		RouteTraversal(const RouteTraversal& one_day, size_t day_count, size_t service_stride);
+
+		/**
+		 * @brief Constructs a traversal of `forward` running backwards in time
+		 * 
+		 * Every route visits its stops in the opposite order and time `t` becomes `origin - t`,
+		 * so departure from a stop becomes arrival to it and the other way around.
+		 * Trip at index `i` is the trip at index `trips() - 1 - i` of the same route in `forward`.
+		 * 
+		 * @param forward Traversal to reverse
+		 * @param origin Time mapped to 0, should be greater than all times in `forward`
+		 */
+		RouteTraversal(const RouteTraversal& forward, Time_t origin, ReversedTag);
 		RouteTraversal& operator=(const RouteTraversal& other) = delete;
 		RouteTraversal& operator=(RTData&& raw_data);
 		RouteTraversal& operator=(RouteTraversal&& other) noexcept;
@@ -360,18 +510,105 @@ namespace raptor
 			return std::ranges::subrange(stop_trip_iterator(routes_[route].stop_times_ptr + stop_diff, diff),
 			                             stop_trip_iterator(routes_[route+1].stop_times_ptr + (stop_diff % diff), diff));
 		}
+
+		/**
+		 * @brief Finds the earliest trip of `route` with service `service` which departs from a stop after `time`
+		 * 
+		 * Uses binary search over the departure column of the stop, if the column is sorted
+		 * 
+		 * @param route A route
+		 * @param stop_index Index of the stop in `getStops(route)`
+		 * @param time Trip must depart strictly after this time
+		 * @param service Wanted service
+		 * @return Iterator to the trip at the stop or `raptor::undefined_trip` if there is no such trip
+		 */
+		trip_iterator findEarliestTrip(RouteId route, size_t stop_index, Time_t time, ServiceId service) const;
+
+		/**
+		 * @brief Value returned by `earliestTripIndex` if no trip was found
+		 * 
+		 */
+		static constexpr size_t no_trip = std::numeric_limits<size_t>::max();
+
+		/**
+		 * @brief Same as `findEarliestTrip`, but returns index of the trip in the route
+		 * 
+		 * @param route A route
+		 * @param stop_index Index of the stop in `getStops(route)`
+		 * @param time Trip must depart strictly after this time
+		 * @param service Wanted service
+		 * @return Index of the trip or `no_trip`
+		 */
+		size_t earliestTripIndex(RouteId route, size_t stop_index, Time_t time, ServiceId service) const;
+
+		/**
+		 * @brief Same as `earliestTripIndex` above, but accepts a trip if `accept` returns true for its service
+		 * 
+		 * @tparam F Predicate on `raptor::ServiceId`
+		 * @param route A route
+		 * @param stop_index Index of the stop in `getStops(route)`
+		 * @param time Trip must depart strictly after this time
+		 * @param accept Decides if trips of a service can be used
+		 * @return Index of the trip or `no_trip`
+		 */
+		template<std::predicate<ServiceId> F>
+		size_t earliestTripIndex(RouteId route, size_t stop_index, Time_t time, F&& accept) const
+		{
+			auto&& r = routes_[route];
+			const size_t trips = r.trips();
+			const Time_t* column = r.departures_ptr + stop_index * trips;
+			for (size_t trip = earliestTripIndex(route, stop_index, time); trip < trips;
+			     trip += 1 + findFirstGreater(column + trip + 1, trips - trip - 1, time))
+			{
+				if (accept(r.services_ptr[trip]))
+					return trip;
+			}
+			return no_trip;
+		}
+
+		/**
+		 * @brief Same as `earliestTripIndex` above, but accepts a trip of any service
+		 * 
+		 * @param route A route
+		 * @param stop_index Index of the stop in `getStops(route)`
+		 * @param time Trip must depart strictly after this time
+		 * @return Index of the trip or `no_trip`
+		 */
+		size_t earliestTripIndex(RouteId route, size_t stop_index, Time_t time) const;
+
+		/**
+		 * @brief Returns iterator to the record of a trip at a stop
+		 * 
+		 * @param route A route
+		 * @param trip Index of the trip in the route
+		 * @param stop_index Index of the stop in `getStops(route)`
+		 * @return Iterator to the trip at the stop
+		 */
+		trip_iterator tripAt(RouteId route, size_t trip, size_t stop_index) const
+		{
+			auto&& r = routes_[route];
+			return trip_iterator(r.stop_times_ptr + trip * r.stops_count + stop_index);
+		}
+
+		/**
+		 * @brief Finds the route of a trip record
+		 * 
+		 * @param trip Iterator to a record stored in this traversal
+		 * @return Route of the record
+		 */
+		RouteId routeOf(trip_iterator trip) const;
 	};
     
     const RouteTraversal::trip_iterator undefined_trip;
 	
 	/**
-	 * @brief Points to all routes `raptor::RouteId` and transfers `raptor::Transfer` for a stop in feed
+	 * @brief Points to all routes `raptor::StopRoute` and transfers `raptor::Transfer` for a stop in feed
 	 * 
 	 */
 	struct Stop
 	{
-		Stop(const RouteId* sr_ptr, const Transfer* tr_ptr);
-		const RouteId* stop_routes_ptr;
+		Stop(const StopRoute* sr_ptr, const Transfer* tr_ptr);
+		const StopRoute* stop_routes_ptr;
 		const Transfer* transfers_ptr;
 	};
 	
@@ -389,13 +626,34 @@ namespace raptor
 		 * 
 		 */
 		std::vector<Stop> stops_;
-		RouteId* stop_routes_;
+		StopRoute* stop_routes_;
 		Transfer* transfers_;
+
+		/**
+		 * @brief Creates data for `raptor::Stops` from `full` without routes which have no trips in `routes`
+		 * 
+		 * Indexes of stops are taken from `routes`, so the routes can visit stops in a different order than in `full`
+		 * 
+		 * @param full Stops with all routes
+		 * @param routes Traversal deciding which routes are kept
+		 * @return Data for `raptor::Stops`
+		 */
+		static SData selectRoutes(const Stops& full, const RouteTraversal& routes);
 	public:
 		Stops() : stop_routes_(nullptr), transfers_(nullptr) { }
 		Stops(const Stops& other) = delete;
 		Stops(Stops&& other) noexcept;
 		Stops(const SData& raw_data);
+
+		/**
+		 * @brief Constructs stops with the same transfers as `full`, but keeps only routes which have a trip in `routes`
+		 * 
+		 * Index of a stop on a route is its first occurrence in `routes`
+		 * 
+		 * @param full Stops with all routes
+		 * @param routes Traversal deciding which routes are kept
+		 */
+		Stops(const Stops& full, const RouteTraversal& routes);
 		size_t size() const;
 		Stops& operator=(SData&& raw_data);
 		Stops& operator=(const Stops& other) = delete;
@@ -403,11 +661,13 @@ namespace raptor
 		const Stop& operator[](const size_t index) const;
 		~Stops() noexcept;
 
-		using route_iterator = iterator<RouteId>;
+		using route_iterator = iterator<StopRoute>;
 
 		/**
 		 * @brief Returns begin() a end() iterators to all routes from `stop`
 		 * 
+		 * Each route comes with the index of `stop` in `raptor::RouteTraversal::getStops` of that route
+		 * 
 		 * @param stop A stop
 		 * @return A `std::ranges::subrange(begin(), end())` of route_iterators
 		 */
@@ -430,6 +690,140 @@ namespace raptor
 		}
 	};
 
+	/**
+	 * @brief Days on which services of a feed run
+	 * 
+	 * Built from day of week ranges in `calendar.txt` and exceptions in `calendar_dates.txt`.
+	 * Every service has a bitset with one bit for each day of the feed validity period.
+	 * 
+	 */
+	class ServiceCalendar
+	{
+	private:
+		static constexpr size_t word_bits = 64;
+
+		/**
+		 * @brief First day of the feed validity period, it has index 0
+		 * 
+		 */
+		std::chrono::sys_days first_day_;
+		size_t day_count_;
+		size_t words_per_service_;
+
+		/**
+		 * @brief Bitsets of all services stored after each other, indexed by `raptor::ServiceId`
+		 * 
+		 */
+		std::vector<uint64_t> days_;
+	public:
+		ServiceCalendar() : first_day_(), day_count_(0), words_per_service_(0), days_() { }
+
+		/**
+		 * @brief Constructs calendar for services in `feed`
+		 * 
+		 * Services must be already inserted in `raptor::IdTranslator`
+		 * 
+		 * @param feed A `gtfs::Feed` with calendar data
+		 */
+		ServiceCalendar(const gtfs::Feed& feed);
+
+		/**
+		 * @brief Returns index of `date` used by `isActive`
+		 * 
+		 * @param date A date
+		 * @return Index of the day or `std::nullopt` if `date` is outside of the feed validity period
+		 */
+		std::optional<size_t> dayIndex(std::chrono::year_month_day date) const;
+
+		/**
+		 * @brief Checks if `service` runs on a day
+		 * 
+		 * @param service A service
+		 * @param day Index returned by `dayIndex`
+		 * @return true Trips of `service` run that day
+		 * @return false Trips of `service` don't run that day
+		 */
+		bool isActive(ServiceId service, size_t day) const
+		{
+			return (days_[service * words_per_service_ + day / word_bits] >> (day % word_bits)) & 1;
+		}
+
+		/**
+		 * @brief Returns number of days in the feed validity period
+		 * 
+		 * @return Number of days
+		 */
+		size_t dayCount() const
+		{
+			return day_count_;
+		}
+	};
+
+	/**
+	 * @brief Timetable with stops and time reversed
+	 * 
+	 * The earliest arrival search from the end stops over this timetable finds the latest departures in the forward timetable.
+	 * Route and stop ids are the same as in the forward timetable.
+	 * 
+	 */
+	struct ReversedTimetable
+	{
+		/**
+		 * @brief Time mapped to 0, it is greater than all times on a timeline of `raptor::RouteFinder`
+		 * 
+		 */
+		static constexpr Time_t origin = 4 * seconds_per_day;
+
+		ReversedTimetable() = default;
+		ReversedTimetable(const RouteTraversal& forward_routes, const Stops& forward_stops);
+		RouteTraversal routes;
+		Stops stops;
+
+		/**
+		 * @brief Converts a time from the reversed timeline
+		 * 
+		 * @param time Time in `routes`
+		 * @return The same moment in the forward timetable
+		 */
+		static Time_t toForward(Time_t time)
+		{
+			return origin - time;
+		}
+
+		/**
+		 * @brief Finds the record of a reversed trip in the forward timetable
+		 * 
+		 * @param forward_routes Routes from which this timetable was created
+		 * @param trip Record of a trip in `routes`, where the trip was boarded in reversed time
+		 * @param stop Stop where the trip was boarded in forward time, it comes before `trip` on the forward route
+		 * @return Record of the same trip at `stop` in `forward_routes`
+		 */
+		RouteTraversal::trip_iterator forwardTrip(const RouteTraversal& forward_routes, RouteTraversal::trip_iterator trip, StopId stop) const;
+	};
+
+	/**
+	 * @brief Timetable with only trips of one service
+	 * 
+	 * Route and stop ids are the same as in the full timetable, routes without trips of the service are empty
+	 * and are not listed in `raptor::Stops::getRoutes`.
+	 * Trips running after midnight are also copied to the start of the day, see `raptor::RouteTraversal::RouteTraversal(const RouteTraversal&, size_t, size_t)`.
+	 * 
+	 */
+	struct ServiceTimetable
+	{
+		ServiceTimetable(const RouteTraversal& full_routes, const Stops& full_stops, ServiceId service);
+		RouteTraversal routes;
+		Stops stops;
+
+		/**
+		 * @brief The same trips running backwards in time, used by arrive-by queries
+		 * 
+		 * Created by `raptor::RouteFinder::getReversedTimetable` on the first such query
+		 * 
+		 */
+		mutable std::unique_ptr<ReversedTimetable> reversed;
+	};
+
 	/**
 	 * @brief A static helper class to parse data from `gtfs::Feed`
 	 * 
@@ -460,20 +854,85 @@ namespace raptor
 		                            double lat2, double long2);
 
 		/**
-		 * @brief Sorts data for `raptor::RouteTraversal` to correct order
+		 * @brief Stop time prepared for sorting, `key` has the trip in the upper and the stop sequence in the lower 32 bits
 		 * 
-		 * @param data Data to sort
-		 * @return Sorted `data`
 		 */
-		static std::tuple_element_t<0, RTData> sortRouteRawData(std::unordered_map<RouteId, RouteRawData>&& data);
+		struct StopTimeRecord
+		{
+			uint64_t key;
+			StopId stop;
+			Time_t arrival;
+			Time_t departure;
+
+			static uint64_t makeKey(const size_t trip, const uint32_t sequence)
+			{
+				return static_cast<uint64_t>(trip) << 32 | sequence;
+			}
+
+			size_t trip() const
+			{
+				return key >> 32;
+			}
+		};
 
 		/**
-		 * @brief Sorts data for `raptor::Stops` to correct order
+		 * @brief Stable LSD radix sort of stop times by their keys
 		 * 
-		 * @param data Data to sort
-		 * @return Sorted `data`
+		 * Histograms of all bytes of the keys are counted in one pass, bytes which are the same in all keys are skipped.
+		 * 
+		 * @param records Stop times to sort
+		 * @param scratch Buffer for the passes with the same allocator as `records`, its content is overwritten
 		 */
-		static std::vector<StopRawData> sortStopRawData(std::unordered_map<StopId, StopData>&& data);
+		static void radixSort(std::pmr::vector<StopTimeRecord>& records, std::pmr::vector<StopTimeRecord>& scratch);
+
+		/**
+		 * @brief Parses a time of the day, which may be after midnight like "25:13:00"
+		 * 
+		 * @param time Time in H:MM:SS or HH:MM:SS format, an empty time is `raptor::undefined_time`
+		 * @return Seconds since the start of the day
+		 * @throws std::runtime_error If `time` is not a valid time
+		 */
+		static Time_t parseTime(std::string_view time);
+
+		/**
+		 * @brief Reads stop_times.txt row by row and appends its stop times to `records`
+		 * 
+		 * Only trip_id, stop_id, stop_sequence, arrival_time and departure_time columns are parsed,
+		 * ids are translated by `raptor::IdTranslator`.
+		 * 
+		 * @tparam Reader `raptor::CsvReader` or `raptor::CsvStreamReader`
+		 * @param reader Reader of stop_times.txt
+		 * @param records Stop times in the order of the file
+		 * @throws std::runtime_error If a required column is missing, a row is invalid or it has an unknown trip or stop
+		 */
+		template<typename Reader>
+		static void readStopTimes(Reader& reader, std::pmr::vector<StopTimeRecord>& records);
+
+		/**
+		 * @brief Builds the data of `raptor::RouteTraversal` and `raptor::Stops` from translated stop times
+		 * 
+		 * @param feed Feed with stops, trips and services already inserted to `raptor::IdTranslator`
+		 * @param records Stop times of the feed, they are sorted by the call
+		 * @param transfer_radius Stops closer than this are connected by a transfer, in kilometers
+		 * @param thread_count Number of threads building the data
+		 * @param arena Memory for temporary arrays
+		 * @return Sorted data for `raptor::RouteTraversal` and `raptor::Stops`
+		 */
+		static Data buildData(const gtfs::Feed& feed, std::pmr::vector<StopTimeRecord>& records, double transfer_radius,
+		                      size_t thread_count, std::pmr::memory_resource* arena);
+
+		/**
+		 * @brief Fills times of stops which are not timepoints
+		 * 
+		 * A stop with one of its times empty arrives and departs at the other one. Stops with both times empty
+		 * get a time between the neighbouring timepoints of their trip by the distance travelled between them.
+		 * 
+		 * @param feed Feed with stops and trips indexed by their ids in `raptor::IdTranslator`
+		 * @param records Stop times sorted by `raptor::GTFSFeedParser::radixSort`, empty times are `raptor::undefined_time`
+		 * @param trip_offsets Stop times of trip `t` are `records[trip_offsets[t]]` to `records[trip_offsets[t+1]]`
+		 * @throws std::runtime_error If the first or the last stop of a trip has no time
+		 */
+		static void fillMissingTimes(const gtfs::Feed& feed, std::pmr::vector<StopTimeRecord>& records, const std::pmr::vector<size_t>& trip_offsets);
 
 		/**
 		 * @brief Finds the longest trip for each route
@@ -484,12 +943,38 @@ namespace raptor
 		static std::vector<std::pair<size_t, size_t>> findLongestTrips(const std::tuple_element_t<0, RTData>& data);
 
 		/**
-		 * @brief For each route removes trips which have different length than the longest trip
+		 * @brief Groups sorted stop times to routes in the order of `raptor::RouteTraversal`
 		 * 
-		 * @param data Data
-		 * @return `data` without the trips
+		 * Trips of a route are ordered by the arrival to their first stop, trips which have different length
+		 * or stops than the longest trip of their route are removed.
+		 * 
+		 * @param records Stop times sorted by `raptor::GTFSFeedParser::radixSort`
+		 * @param trip_offsets Stop times of trip `t` are `records[trip_offsets[t]]` to `records[trip_offsets[t+1]]`
+		 * @param trip_routes Route of each trip
+		 * @param trip_services Service of each trip
+		 * @param route_count Number of routes
+		 * @param thread_count Number of threads processing routes
+		 * @param arena Memory for temporary arrays
+		 * @return Data for `raptor::RouteTraversal`
 		 */
-		static std::tuple_element_t<0, RTData> removeBadTrips(std::tuple_element_t<0, RTData>& data);
+		static RTData buildRoutes(const std::pmr::vector<StopTimeRecord>& records, const std::pmr::vector<size_t>& trip_offsets,
+		                          const std::pmr::vector<RouteId>& trip_routes, const std::pmr::vector<ServiceId>& trip_services,
+		                          size_t route_count, size_t thread_count, std::pmr::memory_resource* arena);
+
+		/**
+		 * @brief Finds pairs of stops closer than `radius`
+		 * 
+		 * Stops are put to a grid of latitude and longitude with cells at least `radius` wide,
+		 * so distances are measured only to stops in the same and the neighbouring cells.
+		 * Each row of the grid has its own number of columns, so cells get wider only near the poles,
+		 * and columns wrap at 180 degrees of longitude.
+		 * 
+		 * @param stops Stops indexed by `raptor::StopId`
+		 * @param radius Maximal distance in kilometers
+		 * @param thread_count Number of threads processing stops
+		 * @return Stops closer than `radius` with their distance for each stop, sorted by stop
+		 */
+		static std::vector<std::vector<std::pair<StopId, double>>> findTransfers(const std::vector<gtfs::Stop>& stops, double radius, size_t thread_count);
 
 		/**
 		 * @brief Inserts all stops from a `gtfs::Feed` to `raptor::IdTranslator`
@@ -520,19 +1005,66 @@ namespace raptor
 		static void hashServices(const gtfs::Feed& feed);
 		
 		/**
-		 * @brief Prepares `raptor::IdTranslator` by calling all hash* member functions above
+		 * @brief Prepares `raptor::IdTranslator` by calling all hash* member functions above, each one in its own thread
 		 * 
 		 * @param feed A `gtfs::Feed` feed with desired data
 		 */
 		static void prepareTranslator(const gtfs::Feed& feed);
 	public:
+		/**
+		 * @brief Stops closer than this are connected by a transfer by default, in kilometers
+		 * 
+		 */
+		static constexpr double default_transfer_radius = 1;
+
 		/**
 		 * @brief 
 		 * 
 		 * @param feed A `gtfs::Feed` feed with desired data
+		 * @param transfer_radius Stops closer than this are connected by a transfer, in kilometers
+		 * @param thread_count Number of threads building the data, 0 for the number of hardware threads
+		 * @return Sorted data for `raptor::RouteTraversal` and `raptor::Stops`
+		 */
+		static const Data parseFeed(const gtfs::Feed& feed, double transfer_radius = default_transfer_radius, size_t thread_count = 0);
+
+		/**
+		 * @brief Same as `parseFeed` but stop times are streamed from `stop_times` instead of `feed`
+		 * 
+		 * `feed` does not need to have its stop times loaded, see `readFeed`. Rows are converted to compact
+		 * records while they are read, so stop times are never held as `gtfs::StopTime`.
+		 * 
+		 * @param feed A `gtfs::Feed` with stops, routes, trips and services
+		 * @param stop_times Content of stop_times.txt
+		 * @param transfer_radius Stops closer than this are connected by a transfer, in kilometers
+		 * @param thread_count Number of threads building the data, 0 for the number of hardware threads
 		 * @return Sorted data for `raptor::RouteTraversal` and `raptor::Stops`
+		 * @throws std::runtime_error If stop_times.txt is invalid
+		 */
+		static const Data parseFeed(const gtfs::Feed& feed, std::istream& stop_times, double transfer_radius = default_transfer_radius, size_t thread_count = 0);
+
+		/**
+		 * @brief Same as `parseFeed` with a stream, but stop_times.txt is mapped to memory and split by `raptor::CsvReader`
+		 * 
+		 * @param feed A `gtfs::Feed` with stops, routes, trips and services
+		 * @param stop_times Path to stop_times.txt
+		 * @param transfer_radius Stops closer than this are connected by a transfer, in kilometers
+		 * @param thread_count Number of threads building the data, 0 for the number of hardware threads
+		 * @return Sorted data for `raptor::RouteTraversal` and `raptor::Stops`
+		 * @throws std::runtime_error If stop_times.txt can't be mapped or it is invalid
+		 */
+		static const Data parseFeed(const gtfs::Feed& feed, const std::filesystem::path& stop_times, double transfer_radius = default_transfer_radius, size_t thread_count = 0);
+
+		/**
+		 * @brief Reads files of `feed` used by `raptor::RouteFinder` except stop_times.txt
+		 * 
+		 * Stops, routes, trips, calendar and calendar dates are read, stop times should be streamed
+		 * by `parseFeed`. Other files like shapes.txt are skipped.
+		 * 
+		 * @param feed Feed created with a path to its folder
+		 * @param read_shapes Whether shapes.txt is read too
+		 * @return `gtfs::OK` or the first error, missing calendar files are not an error
 		 */
-		static const Data parseFeed(const gtfs::Feed& feed);
+		static gtfs::Result readFeed(gtfs::Feed& feed, bool read_shapes = false);
 	};
 }
 
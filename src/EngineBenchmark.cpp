@@ -0,0 +1,135 @@
+#include <Algorithm.hpp>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <tuple>
+
+using namespace std;
+using namespace raptor;
+
+/**
+ * @brief A query run by both engines
+ *
+ */
+struct Query
+{
+    StopId start;
+    StopId end;
+    Time_t departure;
+};
+
+/**
+ * @brief Measured times of one engine
+ *
+ */
+struct EngineTimes
+{
+    double preprocessing;
+    double queries;
+};
+
+/**
+ * @brief Runs every query with `engine`
+ *
+ * @param rf Route finder with the wanted service set
+ * @param engine Engine to run
+ * @param goal_directed Whether RAPTOR prunes by lower bounds
+ * @param queries Queries to run
+ * @param arrivals Arrival of each query, `raptor::inf_time` if it has no route
+ * @return Time of the first query, which creates the engine, and time of all queries in milliseconds
+ */
+EngineTimes run_queries(RouteFinder& rf, Engine engine, bool goal_directed, const vector<Query>& queries, vector<Time_t>& arrivals)
+{
+    QueryWorkspace workspace;
+    arrivals.clear();
+    rf.setEngine(engine);
+    rf.setGoalDirected(goal_directed);
+    auto begin = chrono::steady_clock::now();
+    rf.findRoute({ 0 }, { 0 }, 0, workspace);
+    chrono::duration<double, milli> preprocessing = chrono::steady_clock::now() - begin;
+    begin = chrono::steady_clock::now();
+    for (auto&& query : queries)
+    {
+        auto result = rf.findRoute({ query.start }, { query.end }, query.departure, workspace);
+        if (holds_alternative<RouteFinder::result_t>(result))
+            arrivals.push_back(query.departure + get<pair<StopId, Time_t>>(get<RouteFinder::result_t>(result).back()).second);
+        else
+            arrivals.push_back(inf_time);
+    }
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - begin;
+    return EngineTimes{ preprocessing.count(), elapsed.count() };
+}
+
+/**
+ * @brief Compares RAPTOR with the other engines on the same random queries
+ *
+ * Usage: `EngineBenchmark <feed folder> <service id> [query count]`
+ *
+ * @return Exit code, 1 if an engine arrived at a different time than RAPTOR
+ */
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        cerr << "Usage: " << argv[0] << " <feed folder> <service id> [query count]\n";
+        return 2;
+    }
+    const size_t query_count = argc > 3 ? stoul(argv[3]) : 1000;
+    gtfs::Feed feed(argv[1]);
+    if (feed.read_feed() != gtfs::OK)
+    {
+        cerr << "Invalid feed\n";
+        return 2;
+    }
+    RouteFinder rf(&feed);
+    IdTranslator::getInstance().lock();
+    try
+    {
+        rf.setOptions(WalkingSpeed::Normal, argv[2]);
+        rf.findRoute({ 0 }, { 0 }, 0);
+    }
+    catch (const IdException& e)
+    {
+        cerr << "Unknown service " << argv[2] << '\n';
+        return 2;
+    }
+
+    mt19937 generator(42);
+    uniform_int_distribution<size_t> stop(0, IdTranslator::getInstance().stop_count() - 1);
+    uniform_int_distribution<Time_t> time(4*60*60, 22*60*60);
+    vector<Query> queries;
+    for (size_t i = 0; i < query_count; ++i)
+        queries.push_back(Query{ StopId(stop(generator)), StopId(stop(generator)), time(generator) });
+
+    const tuple<Engine, bool, const char*> engines[] = {
+        { Engine::Raptor, false, "RAPTOR:          " },
+        { Engine::Raptor, true, "goal directed:   " },
+        { Engine::ConnectionScan, false, "connection scan: " },
+        { Engine::TripBased, false, "trip based:      " },
+        { Engine::TransferPatterns, false, "patterns:        " }
+    };
+    cout << "queries:         " << queries.size() << '\n';
+    vector<Time_t> raptor_arrivals, arrivals;
+    size_t mismatches = 0;
+    for (auto&& [engine, goal_directed, name] : engines)
+    {
+        auto times = run_queries(rf, engine, goal_directed, queries, arrivals);
+        if (engine == Engine::Raptor && !goal_directed)
+            raptor_arrivals = arrivals;
+        // all engines follow the rules of `raptor::RoutingEngine`, so every difference is an error
+        size_t earlier = 0;
+        size_t later = 0;
+        for (size_t i = 0; i < queries.size(); ++i)
+        {
+            if (arrivals[i] < raptor_arrivals[i])
+                ++earlier;
+            else if (arrivals[i] > raptor_arrivals[i])
+                ++later;
+        }
+        mismatches += earlier + later;
+        cout << name << times.queries << " ms (" << times.queries / queries.size() << " ms/query), preprocessing "
+             << times.preprocessing << " ms, earlier " << earlier << ", later " << later << '\n';
+    }
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,220 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <random>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    /**
+     * @brief Random numbers computed from raw `std::mt19937` output
+     *
+     * Distributions of the standard library differ between implementations, this way the same seed gives the same feed everywhere.
+     *
+     */
+    class Random
+    {
+    public:
+        explicit Random(const uint32_t seed) : engine_(seed) { }
+
+        double uniform()
+        {
+            return engine_() / 4294967296.0;
+        }
+
+        double uniform(const double low, const double high)
+        {
+            return low + uniform() * (high - low);
+        }
+
+        size_t below(const size_t count)
+        {
+            return static_cast<size_t>(uniform() * static_cast<double>(count));
+        }
+    private:
+        mt19937 engine_;
+    };
+
+    struct Position
+    {
+        double lat;
+        double lon;
+    };
+
+    /**
+     * @brief Approximate distance in kilometers, precise enough for an area of a few degrees
+     *
+     */
+    double distance(const Position& a, const Position& b)
+    {
+        return hypot((a.lat - b.lat) * 111, (a.lon - b.lon) * 90);
+    }
+
+    string toGtfsTime(const size_t time)
+    {
+        char buffer[48];
+        snprintf(buffer, sizeof buffer, "%02zu:%02zu:%02zu", time / 3600, time / 60 % 60, time % 60);
+        return buffer;
+    }
+}
+
+/**
+ * @brief Writes a synthetic GTFS feed for the benchmarks
+ *
+ * Stops are spread randomly over a square, every route goes through neighbouring stops roughly in one direction
+ * and its trips run from 5:00 to 23:00 in a regular interval with service FULLW. The seed is fixed,
+ * so the same parameters always give the same feed. The defaults give about 710 thousand stop times.
+ *
+ * Usage: `FeedGenerator <output folder> [stops] [routes] [size of the area in degrees]`
+ *
+ * @return Exit code
+ */
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " <output folder> [stops] [routes] [size of the area in degrees]\n";
+        return 2;
+    }
+    const filesystem::path folder = argv[1];
+    size_t stop_count = 3000;
+    size_t route_count = 400;
+    double span = 1;
+    try
+    {
+        if (argc > 2)
+            stop_count = stoul(argv[2]);
+        if (argc > 3)
+            route_count = stoul(argv[3]);
+        if (argc > 4)
+            span = stod(argv[4]);
+    }
+    catch (const logic_error&)
+    {
+        cerr << "Invalid number\n";
+        return 2;
+    }
+    if (stop_count == 0 || span <= 0)
+    {
+        cerr << "The feed needs stops and an area\n";
+        return 2;
+    }
+    filesystem::create_directories(folder);
+    Random random(7);
+
+    ofstream(folder / "agency.txt") << "agency_id,agency_name,agency_url,agency_timezone\n"
+                                       "A,Synthetic,http://example.com,Europe/Bratislava\n";
+    ofstream(folder / "calendar.txt") << "service_id,monday,tuesday,wednesday,thursday,friday,saturday,sunday,start_date,end_date\n"
+                                         "FULLW,1,1,1,1,1,1,1,20200101,20301231\n";
+
+    vector<Position> stops;
+    stops.reserve(stop_count);
+    ofstream stops_file(folder / "stops.txt");
+    stops_file << "stop_id,stop_name,stop_lat,stop_lon\n";
+    for (size_t stop = 0; stop < stop_count; ++stop)
+    {
+        const double lat = 36 + random.uniform() * span;
+        const double lon = -116 + random.uniform() * span;
+        stops.push_back({ lat, lon });
+        stops_file << 'S' << stop << ",Stop S" << stop << ',' << to_string(lat) << ',' << to_string(lon) << '\n';
+    }
+
+    // next stops of a route are searched in the same and the neighbouring cells of a 20 x 20 grid
+    const double cell = span / 20;
+    auto cell_of = [&](const Position& position)
+    {
+        return pair(static_cast<int64_t>(position.lat / cell), static_cast<int64_t>(position.lon / cell));
+    };
+    map<pair<int64_t, int64_t>, vector<size_t>> grid;
+    for (size_t stop = 0; stop < stop_count; ++stop)
+        grid[cell_of(stops[stop])].push_back(stop);
+
+    ofstream routes_file(folder / "routes.txt");
+    ofstream trips_file(folder / "trips.txt");
+    ofstream stop_times_file(folder / "stop_times.txt");
+    routes_file << "route_id,agency_id,route_short_name,route_long_name,route_type\n";
+    trips_file << "route_id,service_id,trip_id\n";
+    stop_times_file << "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n";
+    size_t trip_id = 0;
+    for (size_t route = 0; route < route_count; ++route)
+    {
+        size_t current = random.below(stop_count);
+        vector<size_t> path = { current };
+        vector<bool> used(stop_count, false);
+        used[current] = true;
+        const double heading = random.uniform() * 2 * numbers::pi;
+        const size_t length = 15 + random.below(21);
+        for (size_t step = 0; step < length; ++step)
+        {
+            const Position& from = stops[current];
+            auto [row, column] = cell_of(from);
+            // the next stop is in the direction of the route and not too far
+            size_t best = stop_count;
+            double best_score = 0;
+            for (int64_t drow = -1; drow <= 1; ++drow)
+            {
+                for (int64_t dcolumn = -1; dcolumn <= 1; ++dcolumn)
+                {
+                    auto found = grid.find(pair(row + drow, column + dcolumn));
+                    if (found == grid.end())
+                        continue;
+                    for (auto&& candidate : found->second)
+                    {
+                        if (used[candidate])
+                            continue;
+                        const Position& to = stops[candidate];
+                        const double score = -cos(atan2(to.lat - from.lat, to.lon - from.lon) - heading) + distance(from, to) * 0.3;
+                        if (best == stop_count || score < best_score)
+                        {
+                            best = candidate;
+                            best_score = score;
+                        }
+                    }
+                }
+            }
+            if (best == stop_count)
+                break;
+            current = best;
+            path.push_back(current);
+            used[current] = true;
+        }
+        if (path.size() < 3)
+            continue;
+        routes_file << 'R' << route << ",A,R" << route << ",Route " << route << ",3\n";
+        // meters per second
+        const double speed = random.uniform(6, 15);
+        constexpr size_t headways[] = { 600, 900, 1200, 1800 };
+        const size_t headway = headways[random.below(size(headways))];
+        for (size_t first_departure = 5 * 3600 + random.below(headway); first_departure < 23 * 3600; first_departure += headway, ++trip_id)
+        {
+            trips_file << 'R' << route << ",FULLW,T" << trip_id << '\n';
+            size_t time = first_departure;
+            for (size_t index = 0; index < path.size(); ++index)
+            {
+                if (index > 0)
+                    time += static_cast<size_t>(distance(stops[path[index - 1]], stops[path[index]]) * 1000 / speed) + 30;
+                stop_times_file << 'T' << trip_id << ',' << toGtfsTime(time) << ',' << toGtfsTime(time + 20) << ",S" << path[index] << ',' << index + 1 << '\n';
+                time += 20;
+            }
+        }
+    }
+    if (!stop_times_file)
+    {
+        cerr << "Can't write the feed to " << folder << '\n';
+        return 2;
+    }
+    cout << "stops:      " << stop_count << '\n';
+    cout << "trips:      " << trip_id << '\n';
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <Algorithm.hpp>
+#include <CsvReader.hpp>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <tuple>
+
+using namespace std;
+using namespace raptor;
+
+/**
+ * @brief Measures time of `load` in milliseconds
+ *
+ * @param load Loads the feed and builds the route finder
+ * @return Elapsed time
+ */
+template<typename F>
+double measure(F&& load)
+{
+    auto begin = chrono::steady_clock::now();
+    load();
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - begin;
+    return elapsed.count();
+}
+
+/**
+ * @brief Compares loading of a feed by just_gtfs with streamed and memory mapped stop_times.txt
+ *
+ * Every row is the time of reading the feed and building `raptor::RouteFinder`, tokenizer rows
+ * are the time of splitting stop_times.txt to fields with each instruction set.
+ *
+ * Usage: `FeedLoadBenchmark <feed folder>`
+ *
+ * @return Exit code
+ */
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " <feed folder>\n";
+        return 2;
+    }
+    const string feed_location = argv[1];
+    const filesystem::path stop_times = filesystem::path(feed_location) / "stop_times.txt";
+    if (!filesystem::is_regular_file(stop_times))
+    {
+        cerr << "Feed has no stop_times.txt\n";
+        return 2;
+    }
+    try
+    {
+        size_t routes = 0;
+        auto full = measure([&]()
+        {
+            gtfs::Feed feed(feed_location);
+            if (feed.read_feed() != gtfs::OK)
+                throw runtime_error("Invalid feed");
+            RouteFinder rf(&feed);
+            routes = IdTranslator::getInstance().route_count();
+        });
+        // ids of the next loads are the same, they are not inserted again
+        IdTranslator::getInstance().lock();
+        auto streamed = measure([&]()
+        {
+            gtfs::Feed feed(feed_location);
+            if (GTFSFeedParser::readFeed(feed) != gtfs::OK)
+                throw runtime_error("Invalid feed");
+            ifstream in(stop_times);
+            RouteFinder rf(&feed, in);
+        });
+        auto mapped = measure([&]()
+        {
+            gtfs::Feed feed(feed_location);
+            if (GTFSFeedParser::readFeed(feed) != gtfs::OK)
+                throw runtime_error("Invalid feed");
+            RouteFinder rf(&feed, stop_times);
+        });
+        cout << "routes:          " << routes << '\n';
+        cout << "just_gtfs:       " << full << " ms\n";
+        cout << "stream:          " << streamed << " ms\n";
+        cout << "mapped:          " << mapped << " ms\n";
+
+        MappedFile file(stop_times);
+        const tuple<SimdLevel, const char*> levels[] = {
+            { SimdLevel::Scalar, "tokenize scalar: " },
+            { SimdLevel::SSE, "tokenize SSE:    " },
+            { SimdLevel::AVX2, "tokenize AVX2:   " }
+        };
+        for (auto&& [level, name] : levels)
+        {
+            if (level > detectSimdLevel())
+                continue;
+            size_t fields_total = 0;
+            auto time = measure([&]()
+            {
+                CsvReader reader(file.text(), level);
+                vector<string_view> fields;
+                while (reader.next(fields))
+                    fields_total += fields.size();
+            });
+            cout << name << time << " ms (" << file.text().size() / 1000.0 / time << " MB/s), fields " << fields_total << '\n';
+        }
+    }
+    catch (const runtime_error& e)
+    {
+        cerr << e.what() << '\n';
+        return 2;
+    }
+    return 0;
+}
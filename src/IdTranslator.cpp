@@ -18,7 +18,25 @@ namespace raptor
 	{
 		return next_trip_id_;
 	}
+
+	size_t IdTranslator::service_count() const
+	{
+		return next_service_id_;
+	}
 	
+	void IdTranslator::reset()
+	{
+		stopIds_ = UnorderedBimap<std::string, StopId>();
+		routeIds_ = UnorderedBimap<InternalRouteId, RouteId>();
+		tripIds_ = UnorderedBimap<std::string, TripId>();
+		serviceIds_ = UnorderedBimap<std::string, ServiceId>();
+		next_stop_id_ = 0;
+		next_route_id_ = 0;
+		next_trip_id_ = 0;
+		next_service_id_ = 0;
+		locked_ = false;
+	}
+
 	IdTranslator& IdTranslator::getInstance()
 	{
 		static IdTranslator instance_;
@@ -29,6 +47,7 @@ namespace raptor
 	{
 		if (locked_)
 			return;
+		checkNextId(next_stop_id_, "stops");
 		stopIds_.insert(element.stop_id, next_stop_id_);
 		next_stop_id_++;
 	}
@@ -37,8 +56,10 @@ namespace raptor
 	{
 		if (locked_)
 			return;
+		checkNextId(next_route_id_, "routes");
 		routeIds_.insert(InternalRouteId(element.route_id, RouteDirection::DefaultDirection), next_route_id_);
 		next_route_id_++;
+		checkNextId(next_route_id_, "routes");
 		routeIds_.insert(InternalRouteId(element.route_id, RouteDirection::OppositeDirection), next_route_id_);
 		next_route_id_++;
 	}
@@ -47,6 +68,7 @@ namespace raptor
 	{
 		if (locked_)
 			return;
+		checkNextId(next_trip_id_, "trips");
 		tripIds_.insert(element.trip_id, next_trip_id_);
 		next_trip_id_++;
 	}
@@ -55,10 +77,49 @@ namespace raptor
 	{
 		if (locked_)
 			return;
+		checkNextId(next_service_id_, "services");
 		serviceIds_.insert(element.service_id, next_service_id_);
 		++next_service_id_;
 	}
 
+	void IdTranslator::insert(const gtfs::CalendarDate& element)
+	{
+		if (locked_)
+			return;
+		checkNextId(next_service_id_, "services");
+		// the same service is usually listed in calendar.txt or in more exceptions
+		if (serviceIds_.insert(element.service_id, next_service_id_))
+			++next_service_id_;
+	}
+
+	void IdTranslator::insert(const std::vector<gtfs::Stop>& elements)
+	{
+		if (locked_)
+			return;
+		stopIds_.reserve(stopIds_.size() + elements.size());
+		for (auto&& element : elements)
+			insert(element);
+	}
+
+	void IdTranslator::insert(const std::vector<gtfs::Route>& elements)
+	{
+		if (locked_)
+			return;
+		// every route has an id for each direction
+		routeIds_.reserve(routeIds_.size() + 2 * elements.size());
+		for (auto&& element : elements)
+			insert(element);
+	}
+
+	void IdTranslator::insert(const std::vector<gtfs::Trip>& elements)
+	{
+		if (locked_)
+			return;
+		tripIds_.reserve(tripIds_.size() + elements.size());
+		for (auto&& element : elements)
+			insert(element);
+	}
+
 	StopId IdTranslator::at(const gtfs::Stop& element) const
 	{
 		return stopIds_[element.stop_id];
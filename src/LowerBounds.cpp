@@ -0,0 +1,97 @@
+#include <LowerBounds.hpp>
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <limits>
+
+namespace raptor
+{
+	LowerBoundGraph::LowerBoundGraph(const RouteTraversal& routes, const Stops& stops)
+	{
+		std::vector<std::pair<StopId, Edge>> edges;
+		for (size_t route = 0; route < routes.size(); ++route)
+		{
+			const Route& r = routes[route];
+			const size_t trips = r.trips();
+			if (trips == 0)
+				continue;
+			for (size_t index = 0; index + 1 < r.stops_count; ++index)
+			{
+				// a ride over more stops can't be shorter than the shortest rides between its following stops
+				Time_t shortest = std::numeric_limits<Time_t>::max();
+				for (size_t trip = 0; trip < trips; ++trip)
+					shortest = std::min(shortest, r.arrivals_ptr[(index + 1) * trips + trip] - r.departures_ptr[index * trips + trip]);
+				edges.emplace_back(r.route_stops_ptr[index + 1], Edge{ r.route_stops_ptr[index], std::max(shortest, 0) });
+			}
+		}
+		for (size_t stop = 0; stop < stops.size(); ++stop)
+		{
+			for (auto&& transfer : stops.getTransfers(stop))
+			{
+				const Time_t walk = walkingTime(transfer.distance, WalkingSpeed::Fast);
+				if (walk < RoutingEngine::max_walking_time)
+					edges.emplace_back(transfer.target_stop, Edge{ stop, walk + RoutingEngine::transfer_penalty });
+			}
+		}
+		std::ranges::stable_sort(edges, std::less<>(), [](const std::pair<StopId, Edge>& edge) { return static_cast<size_t>(edge.first); });
+		offsets_.assign(stops.size() + 1, 0);
+		incoming_.reserve(edges.size());
+		for (auto&& [to, edge] : edges)
+		{
+			++offsets_[to + 1];
+			incoming_.push_back(edge);
+		}
+		for (size_t stop = 0; stop < stops.size(); ++stop)
+			offsets_[stop + 1] += offsets_[stop];
+		for (auto&& edge : incoming_)
+			longest_ = std::max(longest_, edge.time);
+	}
+
+	void LowerBoundGraph::remainingTimes(const std::vector<StopId>& ends, const Time_t limit, std::vector<Time_t>& remaining) const
+	{
+		thread_local std::vector<std::vector<StopId>> buckets;
+		remaining.assign(offsets_.size() - 1, inf_time);
+		// edges are shorter than the number of buckets, so the reached times never wrap around to a bucket not processed yet
+		buckets.resize(std::bit_ceil(static_cast<size_t>(longest_) + 1));
+		const size_t mask = buckets.size() - 1;
+		size_t pending = 0;
+		for (auto&& end : ends)
+		{
+			remaining[end] = 0;
+			buckets[0].push_back(end);
+			++pending;
+		}
+		Time_t time = 0;
+		for (; pending > 0 && time < limit; ++time)
+		{
+			auto& bucket = buckets[time & mask];
+			// edges of zero time add stops to the bucket which is being processed
+			for (size_t i = 0; i < bucket.size(); ++i)
+			{
+				const StopId stop = bucket[i];
+				if (remaining[stop] != time)
+					continue;
+				for (size_t e = offsets_[stop]; e < offsets_[stop + 1]; ++e)
+				{
+					const Edge& edge = incoming_[e];
+					if (time + edge.time < remaining[edge.from])
+					{
+						remaining[edge.from] = time + edge.time;
+						buckets[remaining[edge.from] & mask].push_back(edge.from);
+						++pending;
+					}
+				}
+			}
+			pending -= bucket.size();
+			bucket.clear();
+		}
+		if (pending > 0)
+		{
+			// every stop which is not settled yet is at least `limit` away
+			for (auto&& bound : remaining)
+				bound = std::min(bound, limit);
+			for (auto&& bucket : buckets)
+				bucket.clear();
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef LOWER_BOUNDS_HPP_
+#define LOWER_BOUNDS_HPP_
+
+#include <RoutingEngine.hpp>
+#include <vector>
+
+namespace raptor
+{
+	/**
+	 * @brief Time independent graph of stops for lower bounds on the travel time to end stops
+	 *
+	 * An edge between following stops of a route has the shortest ride of any trip between them,
+	 * an edge of a footpath has its time at the fastest walking speed. No journey can reach an end
+	 * faster than the shortest path in this graph, so the search can skip stops whose arrival
+	 * plus this bound is not earlier than the best arrival to an end found so far.
+	 *
+	 */
+	class LowerBoundGraph
+	{
+	private:
+		/**
+		 * @brief Edge entering a stop
+		 *
+		 */
+		struct Edge
+		{
+			StopId from;
+			Time_t time;
+		};
+
+		/**
+		 * @brief Edges entering stop `s` are `incoming_[offsets_[s]]` to `incoming_[offsets_[s+1]]`
+		 *
+		 */
+		std::vector<size_t> offsets_;
+		std::vector<Edge> incoming_;
+
+		/**
+		 * @brief Time of the longest edge
+		 *
+		 */
+		Time_t longest_ = 0;
+	public:
+		LowerBoundGraph() = default;
+
+		/**
+		 * @brief Builds the graph from rides of trips of `routes` and transfers of `stops`
+		 *
+		 * @param routes Routes of the timetable
+		 * @param stops Stops of the timetable
+		 */
+		LowerBoundGraph(const RouteTraversal& routes, const Stops& stops);
+
+		/**
+		 * @brief Computes the shortest time from stops to the nearest of `ends` by Dijkstra's algorithm over reversed edges
+		 *
+		 * Times are whole seconds, so the priority queue is a ring of buckets, one for each second up to the longest edge, kept for each calling thread.
+		 * Only times shorter than `limit` are computed exactly, the search stops there and longer times are set to `limit`.
+		 *
+		 * @param ends End stops
+		 * @param limit Times from this value up are not needed exactly
+		 * @param remaining Filled with the bound of each stop, `raptor::inf_time` if no end can be reached from it
+		 */
+		void remainingTimes(const std::vector<StopId>& ends, Time_t limit, std::vector<Time_t>& remaining) const;
+	};
+}
+
+#endif // !LOWER_BOUNDS_HPP_
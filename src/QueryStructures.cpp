@@ -0,0 +1,168 @@
+#include <QueryStructures.hpp>
+#include <cassert>
+
+namespace raptor
+{
+	RoundLabels::RoundLabels(const size_t stop_count, const Time_t unreached_arrival)
+		: entries_(), latest_(stop_count, npos), unreached_{ unreached_arrival, undefined::stop, std::nullopt } { }
+
+	const Label& RoundLabels::get(const size_t round, const StopId stop) const
+	{
+		size_t index = latest_[stop];
+		while (index != npos && entries_[index].round > round)
+			index = entries_[index].previous;
+		if (index == npos)
+			return unreached_;
+		return entries_[index].label;
+	}
+
+	void RoundLabels::set(const size_t round, const StopId stop, const Label& label)
+	{
+		// `next` is the entry from a later round which links to `index`, npos if `index` is in `latest_`
+		size_t next = npos;
+		size_t index = latest_[stop];
+		while (index != npos && entries_[index].round > round)
+		{
+			const size_t previous = entries_[index].previous;
+			if (entries_[index].label.arrival >= label.arrival)
+			{
+				// dominated by the new label, unlink it
+				if (next == npos)
+					latest_[stop] = previous;
+				else
+					entries_[next].previous = previous;
+			}
+			else
+				next = index;
+			index = previous;
+		}
+		assert(index == npos || entries_[index].label.arrival > label.arrival || entries_[index].round == round);
+		if (index != npos && entries_[index].round == round)
+		{
+			entries_[index].label = label;
+			return;
+		}
+		const size_t inserted = entries_.size();
+		entries_.push_back(Entry{ label, stop, round, index });
+		if (next == npos)
+			latest_[stop] = inserted;
+		else
+			entries_[next].previous = inserted;
+	}
+
+	size_t RoundLabels::size() const
+	{
+		return entries_.size();
+	}
+
+	void RoundLabels::reset(const size_t stop_count, const Time_t unreached_arrival)
+	{
+		unreached_.arrival = unreached_arrival;
+		if (latest_.size() != stop_count)
+		{
+			latest_.assign(stop_count, npos);
+			entries_.clear();
+			return;
+		}
+		for (auto&& entry : entries_)
+			latest_[entry.stop] = npos;
+		entries_.clear();
+	}
+
+	void MarkedStops::clear()
+	{
+		if (isDense())
+			std::fill(bits_.begin(), bits_.end(), 0);
+		else
+		{
+			for (auto&& stop : list_)
+				bits_[stop / word_bits] = 0;
+		}
+		list_.clear();
+	}
+
+	void MarkedStops::reset(const size_t stop_count)
+	{
+		const size_t word_count = (stop_count + word_bits - 1) / word_bits;
+		if (bits_.size() != word_count)
+		{
+			bits_.assign(word_count, 0);
+			list_.clear();
+			return;
+		}
+		clear();
+	}
+
+	void RouteQueue::clear()
+	{
+		for (auto&& [route, stop_index] : active_)
+			position_[route] = npos;
+		active_.clear();
+	}
+
+	void RouteQueue::reset(const size_t route_count)
+	{
+		if (position_.size() != route_count)
+		{
+			position_.assign(route_count, npos);
+			active_.clear();
+			return;
+		}
+		clear();
+	}
+
+	bool ParetoBags::add(const ParetoLabel& label)
+	{
+		auto&& bag = bags_[label.stop];
+		const Entry entry{ label.arrival, label.walking, static_cast<uint32_t>(label.round), static_cast<uint32_t>(labels_.size()), label.trip.has_value() };
+		if (std::ranges::any_of(bag, [&](const Entry& e) { return e.replaces(entry); }))
+			return false;
+		std::erase_if(bag, [&](const Entry& e) { return entry.replaces(e); });
+		if (bag.empty())
+			touched_.push_back(label.stop);
+		bag.push_back(entry);
+		labels_.push_back(label);
+		return true;
+	}
+
+	void ParetoBags::reset(const size_t stop_count)
+	{
+		labels_.clear();
+		if (bags_.size() != stop_count)
+		{
+			bags_.assign(stop_count, std::vector<Entry>());
+			touched_.clear();
+			return;
+		}
+		// bags keep their capacity for the next query
+		for (auto&& stop : touched_)
+			bags_[stop].clear();
+		touched_.clear();
+	}
+
+	void DepartureLanes::reset(const size_t stop_count)
+	{
+		TimeLanes unreached;
+		unreached.fill(inf_time);
+		arrivals.assign(stop_count, unreached);
+		previous.assign(stop_count, unreached);
+		trip_arrivals.assign(stop_count, unreached);
+		by_trip.assign(stop_count, 0);
+	}
+
+	void QueryWorkspace::prepare(const size_t stop_count, const size_t route_count, const Time_t unreached_arrival)
+	{
+		if (earliest_arrival.size() != stop_count)
+			earliest_arrival.assign(stop_count, inf_time);
+		else
+		{
+			for (auto&& stop : labels.touchedStops())
+				earliest_arrival[stop] = inf_time;
+		}
+		marked.reset(stop_count);
+		new_marked.reset(stop_count);
+		labels.reset(stop_count, unreached_arrival);
+		trip_labels.reset(stop_count, unreached_arrival);
+		potential_routes.reset(route_count);
+	}
+}
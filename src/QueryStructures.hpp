@@ -0,0 +1,671 @@
+#ifndef QUERY_STRUCTURES_HPP_
+#define QUERY_STRUCTURES_HPP_
+
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <ranges>
+#include <utility>
+#include <DataStructures.hpp>
+
+namespace raptor
+{
+	/**
+	 * @brief Label of a stop in one round of the algorithm
+	 *
+	 */
+	struct Label
+	{
+		/**
+		 * @brief Arrival to the stop relative to the departure of the query
+		 *
+		 */
+		Time_t arrival;
+
+		/**
+		 * @brief Stop we came from, `raptor::undefined::stop` for start stops
+		 *
+		 */
+		StopId parent;
+
+		/**
+		 * @brief Trip used to get to the stop, empty if we walked here
+		 *
+		 */
+		std::optional<RouteTraversal::trip_iterator> trip;
+	};
+
+	/**
+	 * @brief Stores labels of stops for every round of the algorithm
+	 *
+	 * Only stops improved in a round get a new entry. Label of a stop in an older round
+	 * is found by following the chain of previous entries for the same stop,
+	 * so memory used by a query depends on the number of improvements and not on stops × rounds.
+	 */
+	class RoundLabels
+	{
+	public:
+		/**
+		 * @brief Value returned by `lastRound` for stops which were never reached
+		 *
+		 */
+		static constexpr size_t npos = std::numeric_limits<size_t>::max();
+	private:
+		/**
+		 * @brief Label of one stop set in round `round`
+		 *
+		 */
+		struct Entry
+		{
+			Label label;
+			StopId stop;
+			size_t round;
+			size_t previous;
+		};
+
+		/**
+		 * @brief All labels set during the query, in order of insertion
+		 *
+		 */
+		std::vector<Entry> entries_;
+
+		/**
+		 * @brief Index to `entries_` with the newest label for each stop, `npos` if stop was never reached
+		 *
+		 */
+		std::vector<size_t> latest_;
+
+		/**
+		 * @brief Label returned for stops not reached yet
+		 *
+		 */
+		Label unreached_;
+	public:
+		RoundLabels() : RoundLabels(0, inf_time) { }
+
+		/**
+		 * @brief Constructs the store with every stop unreached
+		 *
+		 * @param stop_count Number of stops in feed
+		 * @param unreached_arrival Arrival used for stops which were not reached yet
+		 */
+		RoundLabels(const size_t stop_count, const Time_t unreached_arrival);
+
+		/**
+		 * @brief Returns label of `stop` after round `round`
+		 *
+		 * @param round A round
+		 * @param stop A stop
+		 * @return Newest label of `stop` set in a round lower or equal to `round`
+		 */
+		const Label& get(const size_t round, const StopId stop) const;
+
+		/**
+		 * @brief Sets label of `stop` in round `round`
+		 *
+		 * The label must be better than `get(round, stop)`. Labels of `stop` from later rounds
+		 * which are not better than the new label are removed, so queries which reuse labels
+		 * (`raptor::RouteFinder::findRoutes`) can set rounds in any order.
+		 *
+		 * @param round A round
+		 * @param stop A stop
+		 * @param label New label
+		 */
+		void set(const size_t round, const StopId stop, const Label& label);
+
+		/**
+		 * @brief Returns the round of the best label of `stop`
+		 *
+		 * @param stop A stop
+		 * @return Round in which the newest label of `stop` was set, `npos` if stop was never reached
+		 */
+		size_t lastRound(const StopId stop) const
+		{
+			const size_t index = latest_[stop];
+			return index == npos ? npos : entries_[index].round;
+		}
+
+		/**
+		 * @brief Number of labels stored across all rounds
+		 *
+		 * @return Count of stored labels
+		 */
+		size_t size() const;
+
+		/**
+		 * @brief Removes all labels, the cost depends only on number of stored labels
+		 *
+		 * @param stop_count Number of stops in feed, storage is reallocated only if it differs from the previous value
+		 * @param unreached_arrival Arrival used for stops which were not reached yet
+		 */
+		void reset(const size_t stop_count, const Time_t unreached_arrival);
+
+		/**
+		 * @brief Returns all stops which have a label, a stop can be present multiple times
+		 *
+		 * @return View of `raptor::StopId`
+		 */
+		auto touchedStops() const
+		{
+			return entries_ | std::views::transform([](const Entry& e) { return e.stop; });
+		}
+	};
+
+	/**
+	 * @brief Queue of routes to scan in one round
+	 *
+	 * For each queued route it stores the earliest position on the route of a marked stop.
+	 * Adding a route and looking it up are O(1), clearing depends only on the number of queued routes.
+	 */
+	class RouteQueue
+	{
+	private:
+		static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+		/**
+		 * @brief Queued routes with index of the stop to start the scan from
+		 *
+		 */
+		std::vector<std::pair<RouteId, size_t>> active_;
+
+		/**
+		 * @brief Position of each route in `active_`, `npos` if route is not queued
+		 *
+		 */
+		std::vector<size_t> position_;
+	public:
+		using const_iterator = std::vector<std::pair<RouteId, size_t>>::const_iterator;
+
+		/**
+		 * @brief Adds `route` to the queue or moves its start to `stop_index` if it is earlier
+		 *
+		 * @param route A route
+		 * @param stop_index Index of a stop in `raptor::RouteTraversal::getStops` of `route`
+		 */
+		void add(const RouteId route, const size_t stop_index)
+		{
+			const size_t position = position_[route];
+			if (position == npos)
+			{
+				position_[route] = active_.size();
+				active_.emplace_back(route, stop_index);
+			}
+			else if (stop_index < active_[position].second)
+			{
+				active_[position].second = stop_index;
+			}
+		}
+
+		/**
+		 * @brief Removes all routes from the queue
+		 *
+		 */
+		void clear();
+
+		/**
+		 * @brief Removes all routes and prepares the queue for `route_count` routes
+		 *
+		 * @param route_count Number of routes in feed
+		 */
+		void reset(const size_t route_count);
+
+		size_t size() const
+		{
+			return active_.size();
+		}
+
+		const_iterator begin() const
+		{
+			return active_.begin();
+		}
+
+		const_iterator end() const
+		{
+			return active_.end();
+		}
+	};
+
+	/**
+	 * @brief Set of stops marked in a round
+	 *
+	 * Stores a bitset for membership and a list of marked stops, so iterating and clearing
+	 * cost depends on the number of marked stops. When most of the stops are marked
+	 * the bitset is walked word by word instead.
+	 */
+	class MarkedStops
+	{
+	private:
+		using word_t = uint64_t;
+		static constexpr size_t word_bits = 64;
+
+		std::vector<word_t> bits_;
+		std::vector<StopId> list_;
+
+		/**
+		 * @brief Decides if walking the whole bitset is cheaper than sorting the list
+		 *
+		 * @return true Bitset should be used
+		 */
+		bool isDense() const
+		{
+			return list_.size() > bits_.size();
+		}
+	public:
+		/**
+		 * @brief Marks `stop`
+		 *
+		 * @param stop A stop
+		 * @return true `stop` was not marked before
+		 */
+		bool mark(const StopId stop)
+		{
+			word_t& word = bits_[stop / word_bits];
+			const word_t bit = word_t(1) << (stop % word_bits);
+			if (word & bit)
+				return false;
+			word |= bit;
+			list_.push_back(stop);
+			return true;
+		}
+
+		bool contains(const StopId stop) const
+		{
+			return bits_[stop / word_bits] & (word_t(1) << (stop % word_bits));
+		}
+
+		size_t size() const
+		{
+			return list_.size();
+		}
+
+		bool empty() const
+		{
+			return list_.empty();
+		}
+
+		/**
+		 * @brief Calls `f` for every marked stop in increasing order of ids
+		 *
+		 * `f` must not mark stops in this set
+		 *
+		 * @tparam F Callable with `raptor::StopId` parameter
+		 * @param f Function to call
+		 */
+		template<typename F>
+		void forEach(F&& f)
+		{
+			if (isDense())
+			{
+				for (size_t i = 0; i < bits_.size(); ++i)
+				{
+					for (word_t word = bits_[i]; word != 0; word &= word - 1)
+						f(StopId(i * word_bits + std::countr_zero(word)));
+				}
+				return;
+			}
+			std::sort(list_.begin(), list_.end());
+			for (auto&& stop : list_)
+				f(stop);
+		}
+
+		/**
+		 * @brief Unmarks all stops
+		 *
+		 */
+		void clear();
+
+		/**
+		 * @brief Unmarks all stops and prepares the set for `stop_count` stops
+		 *
+		 * @param stop_count Number of stops in feed
+		 */
+		void reset(const size_t stop_count);
+	};
+
+	/**
+	 * @brief Bitset of services whose trips can be used by a query
+	 *
+	 */
+	class ServiceSet
+	{
+	private:
+		using word_t = uint64_t;
+		static constexpr size_t word_bits = 64;
+
+		std::vector<word_t> bits_;
+	public:
+		void insert(const ServiceId service)
+		{
+			bits_[service / word_bits] |= word_t(1) << (service % word_bits);
+		}
+
+		bool contains(const ServiceId service) const
+		{
+			return bits_[service / word_bits] & (word_t(1) << (service % word_bits));
+		}
+
+		/**
+		 * @brief Removes all services and prepares the set for `service_count` services
+		 *
+		 * @param service_count Number of services
+		 */
+		void reset(const size_t service_count)
+		{
+			bits_.assign((service_count + word_bits - 1) / word_bits, 0);
+		}
+	};
+
+	/**
+	 * @brief Label of a multi-criteria search, one journey to `stop`
+	 *
+	 */
+	struct ParetoLabel
+	{
+		/**
+		 * @brief Arrival to the stop
+		 *
+		 */
+		Time_t arrival;
+
+		/**
+		 * @brief Time spent by walking between stops
+		 *
+		 */
+		Time_t walking;
+
+		/**
+		 * @brief Number of trips used, the round of the algorithm
+		 *
+		 */
+		size_t round;
+
+		StopId stop;
+
+		/**
+		 * @brief Index of the label we came from in `raptor::ParetoBags`, `raptor::ParetoBags::npos` for start stops
+		 *
+		 */
+		size_t parent;
+
+		/**
+		 * @brief Trip used to get to the stop, empty if we walked here
+		 *
+		 */
+		std::optional<RouteTraversal::trip_iterator> trip;
+	};
+
+	/**
+	 * @brief Bags of Pareto optimal labels for each stop
+	 *
+	 * Labels are stored in one arena and are never removed during a query, so parents stay valid.
+	 * A bag keeps only criteria of its labels next to each other, so dominance checks read one small array.
+	 * Memory is kept between queries, after the first queries no allocations are needed.
+	 */
+	class ParetoBags
+	{
+	public:
+		static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+		/**
+		 * @brief Criteria of a label in a bag together with its index in the arena
+		 *
+		 */
+		struct Entry
+		{
+			Time_t arrival;
+			Time_t walking;
+			uint32_t round;
+			uint32_t label;
+
+			/**
+			 * @brief Whether the label arrived by a trip, only such labels continue by walking
+			 *
+			 */
+			bool by_trip;
+
+			/**
+			 * @brief Checks if this entry is not worse than `other` in every criterion
+			 *
+			 * @param other Compared entry
+			 * @return true This entry dominates `other`
+			 */
+			bool dominates(const Entry& other) const
+			{
+				return arrival <= other.arrival && walking <= other.walking && round <= other.round;
+			}
+
+			/**
+			 * @brief Checks if `other` is useless in the same bag, an arrival by a walk does not replace an arrival by a trip
+			 *
+			 * @param other Compared entry
+			 * @return true This entry dominates `other` and can continue by walking if `other` can
+			 */
+			bool replaces(const Entry& other) const
+			{
+				return dominates(other) && (by_trip || !other.by_trip);
+			}
+		};
+	private:
+		std::vector<ParetoLabel> labels_;
+		std::vector<std::vector<Entry>> bags_;
+
+		/**
+		 * @brief Stops with a non empty bag
+		 *
+		 */
+		std::vector<StopId> touched_;
+	public:
+		/**
+		 * @brief Adds `label` to the bag of its stop, if no label in the bag replaces it
+		 *
+		 * Labels replaced by `label` are removed from the bag, see `Entry::replaces`
+		 *
+		 * @param label New label
+		 * @return true Label was added
+		 */
+		bool add(const ParetoLabel& label);
+
+		/**
+		 * @brief Checks if a label with given criteria would be dominated by the bag of `stop`
+		 *
+		 * @param stop A stop
+		 * @param arrival Arrival of the label
+		 * @param walking Walking time of the label
+		 * @param round Round of the label
+		 * @return true Some label in the bag is not worse in every criterion
+		 */
+		bool dominated(const StopId stop, const Time_t arrival, const Time_t walking, const size_t round) const
+		{
+			const Entry entry{ arrival, walking, static_cast<uint32_t>(round), 0, false };
+			return std::ranges::any_of(bags_[stop], [&](const Entry& e) { return e.dominates(entry); });
+		}
+
+		const std::vector<Entry>& bag(const StopId stop) const
+		{
+			return bags_[stop];
+		}
+
+		const ParetoLabel& label(const size_t index) const
+		{
+			return labels_[index];
+		}
+
+		/**
+		 * @brief Removes all labels and prepares bags for `stop_count` stops
+		 *
+		 * @param stop_count Number of stops in feed
+		 */
+		void reset(const size_t stop_count);
+	};
+
+	/**
+	 * @brief Labels of a query with `raptor::lane_count` departures, one lane of each vector belongs to one departure
+	 *
+	 */
+	struct DepartureLanes
+	{
+		/**
+		 * @brief Earliest arrival to each stop in any round, `raptor::inf_time` in lanes which did not reach the stop
+		 *
+		 */
+		std::vector<TimeLanes> arrivals;
+
+		/**
+		 * @brief Arrival to each stop after the previous round, trips are boarded from it
+		 *
+		 * Copied from `arrivals` for marked stops at the start of each round
+		 *
+		 */
+		std::vector<TimeLanes> previous;
+
+		/**
+		 * @brief Earliest arrival to each stop by a trip in any round, walks start from it
+		 *
+		 */
+		std::vector<TimeLanes> trip_arrivals;
+
+		/**
+		 * @brief Lanes in which a trip improved `trip_arrivals` of the stop in the current round, only they continue by walking
+		 *
+		 */
+		std::vector<LaneMask> by_trip;
+
+		/**
+		 * @brief Makes every stop unreached in every lane
+		 *
+		 * @param stop_count Number of stops in feed
+		 */
+		void reset(const size_t stop_count);
+	};
+
+	/**
+	 * @brief Labels found by one thread while routes of a round are scanned in parallel
+	 *
+	 */
+	struct RouteScanBuffer
+	{
+		/**
+		 * @brief Best arrival of `improvements` to each stop, `raptor::inf_time` for stops without them
+		 *
+		 */
+		std::vector<Time_t> best;
+
+		/**
+		 * @brief New labels of stops in the order of scanned routes
+		 *
+		 */
+		std::vector<std::pair<StopId, Label>> improvements;
+	};
+
+	/**
+	 * @brief Labels found for one chunk of routes, they are `improvements[begin]` to `improvements[end]` of buffer `buffer`
+	 *
+	 */
+	struct ScanChunk
+	{
+		size_t buffer;
+		size_t begin;
+		size_t end;
+	};
+
+	/**
+	 * @brief Memory used by one RAPTOR query of `raptor::RouteFinder`
+	 *
+	 * Other engines have their own workspaces, see `raptor::RoutingEngine::findRoute`.
+	 * Can be passed to repeated queries, so they don't allocate their data again.
+	 * Between queries only values touched by the previous query are reset.
+	 * One workspace must not be used by two queries at the same time.
+	 */
+	struct QueryWorkspace
+	{
+		/**
+		 * @brief Labels for all rounds
+		 *
+		 */
+		RoundLabels labels;
+
+		/**
+		 * @brief Labels of arrivals by a trip for all rounds, walks start from them
+		 *
+		 * A trip can improve the arrival by a trip to a stop which was reached earlier by a walk, such label is only here.
+		 *
+		 */
+		RoundLabels trip_labels;
+
+		/**
+		 * @brief Earliest arrival to each stop in any round, `raptor::inf_time` if not reached
+		 *
+		 */
+		std::vector<Time_t> earliest_arrival;
+
+		/**
+		 * @brief Stops improved in the current round
+		 *
+		 */
+		MarkedStops marked;
+
+		/**
+		 * @brief Stops improved while relaxing transfers
+		 *
+		 */
+		MarkedStops new_marked;
+
+		/**
+		 * @brief Routes to scan in the current round with the stop to start from
+		 *
+		 */
+		RouteQueue potential_routes;
+
+		/**
+		 * @brief Services of `raptor::RouteFinder` timetable running on the day of a query
+		 *
+		 * Filled by queries with a date, it is not touched by `prepare`
+		 *
+		 */
+		ServiceSet active_services;
+
+		/**
+		 * @brief Bags used by multi-criteria queries, they are reset by those queries
+		 *
+		 */
+		ParetoBags bags;
+
+		/**
+		 * @brief Labels used by multi-departure queries, they are reset by those queries
+		 *
+		 */
+		DepartureLanes lanes;
+
+		/**
+		 * @brief Lower bound of the time from each stop to the ends of a goal directed query, `raptor::inf_time` if no end is reachable
+		 *
+		 */
+		std::vector<Time_t> remaining;
+
+		/**
+		 * @brief One buffer for each thread scanning routes in parallel
+		 *
+		 */
+		std::vector<RouteScanBuffer> scan_buffers;
+
+		/**
+		 * @brief Labels of each chunk of routes scanned in parallel in the current round
+		 *
+		 */
+		std::vector<ScanChunk> scan_chunks;
+
+		/**
+		 * @brief Prepares the workspace for a new query
+		 *
+		 * @param stop_count Number of stops in feed
+		 * @param route_count Number of routes in feed
+		 * @param unreached_arrival Arrival used in labels for stops which were not reached yet
+		 */
+		void prepare(const size_t stop_count, const size_t route_count, const Time_t unreached_arrival);
+	};
+}
+
+#endif // !QUERY_STRUCTURES_HPP_
@@ -2,6 +2,7 @@
 #define RAPTOR_TYPES_AND_CONSTANTS_HPP_
 
 #include <limits>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <tuple>
@@ -13,6 +14,8 @@
 #include <sstream>
 #include <stdexcept>
 #include <utility>
+#include <chrono>
+#include <cassert>
 
 /**
  * @brief Function to combine two hashes
@@ -37,27 +40,40 @@ inline size_t hash_combine(size_t lhs, size_t rhs)
 
 namespace raptor
 {
+	/**
+	 * @brief Default type used to store values of `raptor::Id`
+	 * 
+	 * 32 bits are enough for every feed and keep timetable records small
+	 * 
+	 */
+	using id_storage_t = uint32_t;
+
 	/**
 	 * @brief Templated class to distinguish route, stop, trip and service indexes
 	 *
 	 * Provides almost the same methods as size_t and provides a conversion to size_t
 	 * 
 	 * @tparam size_t Only do distinguish two numbers
+	 * @tparam T Unsigned integer type used to store the value
 	 */
-	template<size_t>
+	template<size_t, typename T = id_storage_t>
 	class Id
 	{
 	private:
-		size_t id_;
+		T id_;
 	public:
-		Id() : id_(std::numeric_limits<size_t>::max()) { }
-		Id(size_t id) : id_(id) { }
+		using value_type = T;
+		Id() : id_(std::numeric_limits<T>::max()) { }
+		Id(size_t id) : id_(static_cast<T>(id))
+		{
+			assert(id <= std::numeric_limits<T>::max());
+		}
 		Id(const Id& other) : id_(other.id_) { }
-		Id(Id&& other) noexcept : id_(std::numeric_limits<size_t>::max())
+		Id(Id&& other) noexcept : id_(std::numeric_limits<T>::max())
 		{
 			 std::swap(id_, other.id_);
 		}
-		size_t getId() const
+		T getId() const
 		{
 			return id_;
 		}
@@ -91,7 +107,7 @@ namespace raptor
 			{
 				return *this;
 			}
-			id_ = std::numeric_limits<size_t>::max();
+			id_ = std::numeric_limits<T>::max();
 			std::swap(id_, other.id_);
 			return *this;
 		}
@@ -109,6 +125,7 @@ namespace raptor
 	using Time_t = int;
 	constexpr Time_t undefined_time = std::numeric_limits<Time_t>::min();
 	constexpr Time_t inf_time = std::numeric_limits<Time_t>::max();
+	constexpr Time_t seconds_per_day = 24*60*60;
 	constexpr double inf_distance = std::numeric_limits<double>::max();
 
 	enum class RouteDirection
@@ -157,17 +174,38 @@ inline raptor::Time_t toTime(const std::string& time_string)
 	return hours*3600 + minutes*60;
 }
 
+/**
+ * @brief Parses a date in GTFS format
+ * @throws std::invalid_argument Invalid `date_string` was provided
+ * @param date_string String in YYYYMMDD format
+ * @return Parsed date
+ */
+inline std::chrono::year_month_day toDate(const std::string& date_string)
+{
+	if (date_string.size() != 8)
+		throw std::invalid_argument("Invalid date length");
+	size_t p;
+	const int yyyymmdd = std::stoi(date_string, &p);
+	if (p != date_string.length())
+		throw std::invalid_argument("Invalid date");
+	const std::chrono::year_month_day date{ std::chrono::year(yyyymmdd / 10000), std::chrono::month(yyyymmdd / 100 % 100), std::chrono::day(yyyymmdd % 100) };
+	if (!date.ok())
+		throw std::invalid_argument("Invalid date");
+	return date;
+}
+
 /**
  * @brief Specialization of `std::hash` for `raptor::Id`
  * 
  * @tparam I Parameter for `raptor::Id`
+ * @tparam T Storage type of `raptor::Id`
  */
-template<size_t I>
-struct std::hash<raptor::Id<I>>
+template<size_t I, typename T>
+struct std::hash<raptor::Id<I, T>>
 {
-	size_t operator()(const raptor::Id<I>& id) const noexcept
+	size_t operator()(const raptor::Id<I, T>& id) const noexcept
 	{
-		return std::hash<size_t>{}(id.getId());
+		return std::hash<T>{}(id.getId());
 	}
 };
 
@@ -175,13 +213,14 @@ struct std::hash<raptor::Id<I>>
  * @brief Stream write operator for `raptor::Id`
  * 
  * @tparam I Parameter for `raptor::Id`
+ * @tparam T Storage type of `raptor::Id`
  * @param stream Output stream
  * @param id Object to write
  * @relatesalso raptor::Id
  * @return Output stream `stream`
  */
-template<size_t I>
-std::ostream& operator<<(std::ostream& stream, const raptor::Id<I>& id)
+template<size_t I, typename T>
+std::ostream& operator<<(std::ostream& stream, const raptor::Id<I, T>& id)
 {
 	stream << id.getId();
 	return stream;
@@ -277,23 +316,45 @@ namespace raptor
 		TripBlock(StopId idS, ServiceId serv, Time_t arr, Time_t dep)
 			: sId(idS), service(serv), arrival(arr), departure(dep) { }
 	};
-	
-	using RouteRawData = std::unordered_map<TripId, std::vector<TripBlock>>;
+
+	/**
+	 * @brief Route serving a stop together with the position of the stop on that route
+	 * 
+	 */
+	struct StopRoute
+	{
+		RouteId route;
+		/**
+		 * @brief Index of the first occurrence of the stop in stops of `route`
+		 * 
+		 */
+		size_t stop_index;
+		StopRoute() : route(), stop_index(std::numeric_limits<size_t>::max()) { }
+		StopRoute(RouteId rId, size_t index) : route(rId), stop_index(index) { }
+		operator RouteId() const
+		{
+			return route;
+		}
+	};
 	
 	struct StopData
 	{
 		std::vector<std::pair<StopId, double>> transfers;
-		std::vector<RouteId> routes;
+		std::vector<StopRoute> routes;
 	};
 	using StopRawData = std::pair<StopId, StopData>;
 	
-	using RTData = std::tuple<std::vector<std::pair<RouteId, std::vector<std::pair<TripId, RouteRawData::mapped_type>>>>, size_t, size_t>;
+	using RTData = std::tuple<std::vector<std::pair<RouteId, std::vector<std::pair<TripId, std::vector<TripBlock>>>>>, size_t, size_t>;
 	using SData = std::tuple<std::vector<StopRawData>, size_t, size_t>;
 	using Data = std::pair<RTData, SData>;
 	
 	/**
 	 * @brief Singleton class for mapping `std::string` id's used in `gtfs::Feed` to `raptor::Id` used in algorithm
 	 * 
+	 * Each kind of id has its own map and counter, so stops, routes, trips and services can be inserted
+	 * concurrently from different threads before `lock()`. Lookups are safe from any number of threads
+	 * while nothing is inserted.
+	 * 
 	 */
 	class IdTranslator
 	{
@@ -308,6 +369,20 @@ namespace raptor
 		ServiceId next_service_id_ = 0;
 		bool locked_ = false;
 		IdTranslator();
+
+		/**
+		 * @brief Checks that `next_id` can be given to a new element
+		 * 
+		 * @param next_id Next unused id of one kind
+		 * @param kind Name of the elements used in the message
+		 * @throws std::runtime_error If `next_id` is the largest value of its type, which means an undefined id
+		 */
+		template<typename I>
+		static void checkNextId(const I& next_id, const char* kind)
+		{
+			if (next_id.getId() == std::numeric_limits<typename I::value_type>::max())
+				throw std::runtime_error(std::string("Feed has too many ") + kind);
+		}
 	public:
 		IdTranslator(const IdTranslator& other) = delete;
 		IdTranslator& operator=(const IdTranslator& other) = delete;
@@ -329,16 +404,41 @@ namespace raptor
 		{
 			locked_ = true;
 		}
+
+		/**
+		 * @brief Removes all ids and unlocks the object, so ids of another feed start from zero
+		 * 
+		 * Timetables built from the previous feed must not be used after it
+		 * 
+		 */
+		void reset();
 		
 		size_t stop_count() const;
 		size_t route_count() const;
 		size_t trip_count() const;
+		size_t service_count() const;
 
 		void insert(const gtfs::Stop& element);
 		void insert(const gtfs::Route& element);
 		void insert(const gtfs::Trip& element);
 		void insert(const gtfs::CalendarItem& element);
 
+		/**
+		 * @brief Inserts the service of an exception, if it is not in `calendar.txt`
+		 * 
+		 * @param element Exception from `calendar_dates.txt`
+		 */
+		void insert(const gtfs::CalendarDate& element);
+
+		/**
+		 * @brief Inserts all `elements` in their order, reserving space for them first
+		 * 
+		 * @param elements Stops, routes or trips of a feed
+		 */
+		void insert(const std::vector<gtfs::Stop>& elements);
+		void insert(const std::vector<gtfs::Route>& elements);
+		void insert(const std::vector<gtfs::Trip>& elements);
+
 		StopId at(const gtfs::Stop& element) const;
 		RouteId at(const InternalRouteId& element) const;
 		TripId at(const gtfs::Trip& element) const;
@@ -0,0 +1,66 @@
+#include <RoutingEngine.hpp>
+#include <cmath>
+#include <limits>
+#include <bit>
+
+namespace raptor
+{
+	Time_t walkingTime(const double distance, WalkingSpeed speed)
+	{
+		// seconds per km
+		short pace;
+		// error to account for longer real distance
+		constexpr double error = 1.2;
+		switch (speed)
+		{
+		case WalkingSpeed::Slow:
+			// 4 km/h
+			pace = 15*60;
+			break;
+		case WalkingSpeed::Normal:
+			// 5 km/h
+			pace = 12*60;
+			break;
+		case WalkingSpeed::Fast:
+			// 6 km/h
+			pace = 10*60;
+			break;
+		default:
+			pace = std::numeric_limits<short>::max();
+		}
+		return std::round(distance * pace * error);
+	}
+
+	uint64_t timetableFingerprint(const RouteTraversal& routes, const Stops& stops)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		auto add = [&](const uint64_t value)
+		{
+			hash = (hash ^ value) * 1099511628211ull;
+		};
+		add(routes.size());
+		for (size_t route = 0; route < routes.size(); ++route)
+		{
+			const Route& r = routes[route];
+			add(r.stops_count);
+			add(r.trips());
+			for (size_t index = 0; index < r.stops_count; ++index)
+				add(static_cast<size_t>(r.route_stops_ptr[index]));
+			for (size_t i = 0; i < r.trip_count; ++i)
+			{
+				add(static_cast<uint64_t>(r.departures_ptr[i]));
+				add(static_cast<uint64_t>(r.arrivals_ptr[i]));
+			}
+		}
+		add(stops.size());
+		for (size_t stop = 0; stop < stops.size(); ++stop)
+		{
+			for (auto&& transfer : stops.getTransfers(stop))
+			{
+				add(static_cast<size_t>(transfer.target_stop));
+				add(std::bit_cast<uint64_t>(transfer.distance));
+			}
+		}
+		return hash;
+	}
+}
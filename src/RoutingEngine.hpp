@@ -0,0 +1,140 @@
+#ifndef ROUTING_ENGINE_HPP_
+#define ROUTING_ENGINE_HPP_
+
+#include <DataStructures.hpp>
+#include <QueryStructures.hpp>
+#include <variant>
+#include <string>
+#include <vector>
+#include <utility>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <cstdint>
+
+namespace raptor
+{
+	/**
+	 * @brief Enum representing different walking speed
+	 * 
+	 */
+	enum class WalkingSpeed
+	{
+		Fast, /**< Fast walking speed, 6 km/h */
+		Normal, /**< Normal walking speed, 5 km/h */
+		Slow /**< Slow walking speed, 4 km/h*/
+	};
+
+	/**
+	 * @brief Calculates approximate time in which the distance will be covered based on walking speed
+	 * 
+	 * @param distance Distance to be covered in kilometers
+	 * @param speed Walking speed
+	 * @return Time to walk `distance`
+	 */
+	Time_t walkingTime(const double distance, WalkingSpeed speed);
+
+	/**
+	 * @brief Algorithms which can answer earliest arrival queries of `raptor::RouteFinder`
+	 * 
+	 */
+	enum class Engine
+	{
+		Raptor, /**< Round based search over routes, see `raptor::RaptorEngine` */
+		ConnectionScan, /**< Scan of all connections sorted by departure, see `raptor::ConnectionScanEngine` */
+		TripBased, /**< Search over trips with precomputed transfers, see `raptor::TripBasedEngine` */
+		TransferPatterns /**< Evaluation of precomputed transfer patterns, see `raptor::TransferPatternsEngine` */
+	};
+
+	/**
+	 * @brief Type for a found connection
+	 * 
+	 * Pair contains data of a visited stop and time of arrival relative to the departure of the query.
+	 * When two pairs are after each other, it means we walked from the first stop to the second.
+	 * trip_iterator comes only after a pair, there are data about the trip we used to get to the next stop.
+	 * Two trip_iterators can't come after each other.
+	 */
+	using path_t = std::vector<std::variant<std::pair<StopId, Time_t>, RouteTraversal::trip_iterator>>;
+
+	/**
+	 * @brief Writes the bytes of `value` to a stream with precomputed data of an engine
+	 * 
+	 * @param out Stream opened in binary mode
+	 * @param value Trivially copyable value
+	 */
+	template<typename T>
+	void writeValue(std::ostream& out, const T& value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	/**
+	 * @brief Reads a value written by `writeValue`
+	 * 
+	 * @param in Stream opened in binary mode
+	 * @return Read value
+	 * @throws std::runtime_error If the stream ends before the value
+	 */
+	template<typename T>
+	T readValue(std::istream& in)
+	{
+		T value{};
+		in.read(reinterpret_cast<char*>(&value), sizeof(T));
+		if (!in)
+			throw std::runtime_error("Unexpected end of saved engine data");
+		return value;
+	}
+
+	/**
+	 * @brief Fingerprint of a timetable, saved with precomputed data of an engine
+	 * 
+	 * FNV-1a hash of stops of routes, departure and arrival columns and transfers between stops,
+	 * data saved for another timetable with the same number of trips are rejected by it.
+	 * 
+	 * @param routes Routes of the timetable
+	 * @param stops Stops of the timetable
+	 * @return Hash of the timetable
+	 */
+	uint64_t timetableFingerprint(const RouteTraversal& routes, const Stops& stops);
+
+	/**
+	 * @brief Interface of an algorithm which finds the fastest connection over one timetable
+	 * 
+	 * An engine is created for one `raptor::ServiceTimetable` and one walking speed.
+	 * All engines follow the same rules: a trip is boarded only if it departs strictly after arrival to its stop,
+	 * walking is possible only after leaving a trip, takes `transfer_penalty` more than the walk itself and the walk takes less than `max_walking_time`.
+	 * A walk starts from the arrival by the trip even at a stop which was reached earlier by another walk, so all engines find the same earliest arrival.
+	 * 
+	 */
+	class RoutingEngine
+	{
+	public:
+		/**
+		 * @brief Time added to every walk between stops
+		 * 
+		 */
+		static constexpr Time_t transfer_penalty = 60;
+
+		/**
+		 * @brief Walks taking this time or longer are not used
+		 * 
+		 */
+		static constexpr Time_t max_walking_time = 10*60;
+
+		virtual ~RoutingEngine() = default;
+
+		/**
+		 * @brief Finds the fastest connection between a start stop and an end stop which leaves from start after `departure`
+		 * 
+		 * Every engine keeps memory of its own type for each calling thread, so the engine can be queried from more threads at once.
+		 * 
+		 * @param start Start stop
+		 * @param end End stop
+		 * @param departure Time of earliest departure from first stop
+		 * @return Data about the connection in a special format or a message why there is none
+		 */
+		virtual std::variant<path_t, std::string> findRoute(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure) const = 0;
+	};
+}
+
+#endif // !ROUTING_ENGINE_HPP_
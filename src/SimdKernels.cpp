@@ -0,0 +1,182 @@
+#include <SimdKernels.hpp>
+#include <bit>
+
+#ifdef RAPTOR_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define RAPTOR_TARGET_AVX2
+#else
+#define RAPTOR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace raptor
+{
+	namespace
+	{
+		size_t findFirstGreaterScalar(const Time_t* data, size_t count, Time_t time)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (data[i] > time)
+					return i;
+			}
+			return count;
+		}
+
+		CsvBlockMasks classifyCsvBlockScalar(const char* block)
+		{
+			CsvBlockMasks masks{ 0, 0, 0 };
+			for (size_t i = 0; i < csv_block_size; ++i)
+			{
+				masks.quotes |= static_cast<uint64_t>(block[i] == '"') << i;
+				masks.commas |= static_cast<uint64_t>(block[i] == ',') << i;
+				masks.newlines |= static_cast<uint64_t>(block[i] == '\n') << i;
+			}
+			return masks;
+		}
+
+#ifdef RAPTOR_SIMD_X86
+		size_t findFirstGreaterSSE(const Time_t* data, size_t count, Time_t time)
+		{
+			constexpr size_t width = 4;
+			const __m128i needle = _mm_set1_epi32(time);
+			size_t i = 0;
+			for (; i + width <= count; i += width)
+			{
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+				const int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(block, needle)));
+				if (mask != 0)
+					return i + std::countr_zero(static_cast<unsigned>(mask));
+			}
+			return i + findFirstGreaterScalar(data + i, count - i, time);
+		}
+
+		RAPTOR_TARGET_AVX2 size_t findFirstGreaterAVX2(const Time_t* data, size_t count, Time_t time)
+		{
+			constexpr size_t width = 8;
+			const __m256i needle = _mm256_set1_epi32(time);
+			size_t i = 0;
+			for (; i + width <= count; i += width)
+			{
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+				const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(block, needle)));
+				if (mask != 0)
+					return i + std::countr_zero(static_cast<unsigned>(mask));
+			}
+			return i + findFirstGreaterSSE(data + i, count - i, time);
+		}
+
+		CsvBlockMasks classifyCsvBlockSSE(const char* block)
+		{
+			constexpr size_t width = 16;
+			const __m128i quote = _mm_set1_epi8('"');
+			const __m128i comma = _mm_set1_epi8(',');
+			const __m128i newline = _mm_set1_epi8('\n');
+			CsvBlockMasks masks{ 0, 0, 0 };
+			for (size_t i = 0; i < csv_block_size; i += width)
+			{
+				const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+				masks.quotes |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quote)))) << i;
+				masks.commas |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, comma)))) << i;
+				masks.newlines |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)))) << i;
+			}
+			return masks;
+		}
+
+		RAPTOR_TARGET_AVX2 CsvBlockMasks classifyCsvBlockAVX2(const char* block)
+		{
+			constexpr size_t width = 32;
+			const __m256i quote = _mm256_set1_epi8('"');
+			const __m256i comma = _mm256_set1_epi8(',');
+			const __m256i newline = _mm256_set1_epi8('\n');
+			CsvBlockMasks masks{ 0, 0, 0 };
+			for (size_t i = 0; i < csv_block_size; i += width)
+			{
+				const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+				masks.quotes |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, quote)))) << i;
+				masks.commas |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, comma)))) << i;
+				masks.newlines |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline)))) << i;
+			}
+			return masks;
+		}
+
+		bool cpuSupportsAVX2()
+		{
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+				return false;
+			__cpuid(info, 1);
+			constexpr int osxsave = 1 << 27;
+			constexpr int avx = 1 << 28;
+			if ((info[2] & osxsave) == 0 || (info[2] & avx) == 0)
+				return false;
+			// OS must save ymm registers
+			if ((_xgetbv(0) & 0x6) != 0x6)
+				return false;
+			__cpuidex(info, 7, 0);
+			constexpr int avx2 = 1 << 5;
+			return (info[1] & avx2) != 0;
+#else
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#endif
+		}
+#endif
+	}
+
+	SimdLevel detectSimdLevel()
+	{
+		static const SimdLevel level = []()
+		{
+#ifdef RAPTOR_SIMD_X86
+			if (cpuSupportsAVX2())
+				return SimdLevel::AVX2;
+			// SSE2 is part of every x86-64 CPU
+			return SimdLevel::SSE;
+#else
+			return SimdLevel::Scalar;
+#endif
+		}();
+		return level;
+	}
+
+	size_t findFirstGreater(SimdLevel level, const Time_t* data, size_t count, Time_t time)
+	{
+		switch (level)
+		{
+#ifdef RAPTOR_SIMD_X86
+		case SimdLevel::AVX2:
+			return findFirstGreaterAVX2(data, count, time);
+		case SimdLevel::SSE:
+			return findFirstGreaterSSE(data, count, time);
+#endif
+		default:
+			return findFirstGreaterScalar(data, count, time);
+		}
+	}
+
+	size_t findFirstGreater(const Time_t* data, size_t count, Time_t time)
+	{
+		static const SimdLevel level = detectSimdLevel();
+		return findFirstGreater(level, data, count, time);
+	}
+
+	CsvBlockMasks classifyCsvBlock(SimdLevel level, const char* block)
+	{
+		switch (level)
+		{
+#ifdef RAPTOR_SIMD_X86
+		case SimdLevel::AVX2:
+			return classifyCsvBlockAVX2(block);
+		case SimdLevel::SSE:
+			return classifyCsvBlockSSE(block);
+#endif
+		default:
+			return classifyCsvBlockScalar(block);
+		}
+	}
+}
@@ -0,0 +1,164 @@
+#ifndef SIMD_KERNELS_HPP_
+#define SIMD_KERNELS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <RaptorTypesAndConstants.hpp>
+
+// RAPTOR_NO_SIMD builds only the portable scalar kernels, see option RAPTOR_NO_SIMD in CMakeLists.txt
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(RAPTOR_NO_SIMD)
+#define RAPTOR_SIMD_X86
+#include <emmintrin.h>
+#endif
+
+namespace raptor
+{
+	/**
+	 * @brief Instruction sets which can be used by kernels in this file
+	 *
+	 */
+	enum class SimdLevel
+	{
+		Scalar = 0, /**< No vector instructions */
+		SSE = 1, /**< 128-bit vectors, 4 times at once */
+		AVX2 = 2 /**< 256-bit vectors, 8 times at once */
+	};
+
+	/**
+	 * @brief Detects the best instruction set supported by the CPU running the program
+	 *
+	 * The result is computed only on the first call
+	 *
+	 * @return Best supported `raptor::SimdLevel`
+	 */
+	SimdLevel detectSimdLevel();
+
+	/**
+	 * @brief Finds the first time in `data` which is greater than `time`
+	 *
+	 * Dispatches to the best kernel for the CPU, see `raptor::detectSimdLevel`
+	 *
+	 * @param data Times to search
+	 * @param count Number of times in `data`
+	 * @param time Compared time
+	 * @return Index of the first element greater than `time` or `count` if there is none
+	 */
+	size_t findFirstGreater(const Time_t* data, size_t count, Time_t time);
+
+	/**
+	 * @brief Same as `raptor::findFirstGreater`, but uses kernel for `level`
+	 *
+	 * @param level Instruction set to use, must be supported by the CPU
+	 * @param data Times to search
+	 * @param count Number of times in `data`
+	 * @param time Compared time
+	 * @return Index of the first element greater than `time` or `count` if there is none
+	 */
+	size_t findFirstGreater(SimdLevel level, const Time_t* data, size_t count, Time_t time);
+
+	/**
+	 * @brief Number of bytes classified together by `raptor::classifyCsvBlock`
+	 *
+	 */
+	constexpr size_t csv_block_size = 64;
+
+	/**
+	 * @brief Positions of special characters of CSV in a block of `raptor::csv_block_size` bytes, bit `i` is byte `i`
+	 *
+	 */
+	struct CsvBlockMasks
+	{
+		uint64_t quotes;
+		uint64_t commas;
+		uint64_t newlines;
+	};
+
+	/**
+	 * @brief Finds quotes, commas and newlines in a block of text
+	 *
+	 * @param level Instruction set to use, must be supported by the CPU
+	 * @param block `raptor::csv_block_size` bytes of text
+	 * @return Masks of the special characters
+	 */
+	CsvBlockMasks classifyCsvBlock(SimdLevel level, const char* block);
+
+	/**
+	 * @brief Number of times processed together by lane kernels, 8 times are one 256-bit vector
+	 *
+	 */
+	constexpr size_t lane_count = 8;
+
+	/**
+	 * @brief Times of one stop for `lane_count` queries, one lane for each query
+	 *
+	 */
+	using TimeLanes = std::array<Time_t, lane_count>;
+
+	/**
+	 * @brief One bit for each lane of `raptor::TimeLanes`
+	 *
+	 */
+	using LaneMask = uint32_t;
+
+	/**
+	 * @brief Mask with all lanes set
+	 *
+	 */
+	constexpr LaneMask all_lanes = (LaneMask(1) << lane_count) - 1;
+
+	/**
+	 * @brief Compares two vectors of times lane by lane
+	 *
+	 * Lane kernels are inline, they are called for every stop of a scanned route.
+	 * They use SSE2, which is part of every x86-64 CPU, so they need no dispatch.
+	 *
+	 * @param a Left side
+	 * @param b Right side
+	 * @return Mask with bits of lanes where `a` is less than `b`
+	 */
+	inline LaneMask lessLanes(const TimeLanes& a, const TimeLanes& b)
+	{
+#ifdef RAPTOR_SIMD_X86
+		LaneMask mask = 0;
+		for (size_t i = 0; i < lane_count; i += 4)
+		{
+			const __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data() + i));
+			const __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + i));
+			mask |= static_cast<LaneMask>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(left, right)))) << i;
+		}
+		return mask;
+#else
+		LaneMask mask = 0;
+		for (size_t i = 0; i < lane_count; ++i)
+			mask |= static_cast<LaneMask>(a[i] < b[i]) << i;
+		return mask;
+#endif
+	}
+
+	/**
+	 * @brief Stores the lane by lane minimum of `a` and `b` to `a`
+	 *
+	 * @param a Updated times
+	 * @param b Compared times
+	 */
+	inline void minLanes(TimeLanes& a, const TimeLanes& b)
+	{
+#ifdef RAPTOR_SIMD_X86
+		for (size_t i = 0; i < lane_count; i += 4)
+		{
+			const __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data() + i));
+			const __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + i));
+			// SSE2 has no minimum of 32-bit integers, it is blended by the comparison
+			const __m128i less = _mm_cmplt_epi32(right, left);
+			const __m128i result = _mm_or_si128(_mm_and_si128(less, right), _mm_andnot_si128(less, left));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(a.data() + i), result);
+		}
+#else
+		for (size_t i = 0; i < lane_count; ++i)
+			a[i] = b[i] < a[i] ? b[i] : a[i];
+#endif
+	}
+}
+
+#endif // !SIMD_KERNELS_HPP_
@@ -0,0 +1,60 @@
+#include <ThreadPool.hpp>
+#include <algorithm>
+
+namespace raptor
+{
+	ThreadPool::ThreadPool(size_t thread_count)
+	{
+		if (thread_count == 0)
+			thread_count = std::max(1u, std::thread::hardware_concurrency());
+		for (size_t worker = 1; worker < thread_count; ++worker)
+			threads_.emplace_back(&ThreadPool::work, this, worker);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock(mutex_);
+			stop_ = true;
+		}
+		start_.notify_all();
+		for (auto&& thread : threads_)
+			thread.join();
+	}
+
+	void ThreadPool::work(const size_t worker)
+	{
+		size_t seen = 0;
+		while (true)
+		{
+			std::unique_lock lock(mutex_);
+			start_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+			if (stop_)
+				return;
+			seen = generation_;
+			auto call = call_;
+			auto job = job_;
+			lock.unlock();
+			call(job, worker);
+			lock.lock();
+			if (--running_ == 0)
+				done_.notify_one();
+		}
+	}
+
+	void ThreadPool::runJob(void (*call)(void*, size_t), void* job)
+	{
+		std::lock_guard run_lock(run_mutex_);
+		{
+			std::lock_guard lock(mutex_);
+			call_ = call;
+			job_ = job;
+			running_ = threads_.size();
+			++generation_;
+		}
+		start_.notify_all();
+		call(job, 0);
+		std::unique_lock lock(mutex_);
+		done_.wait(lock, [&]() { return running_ == 0; });
+	}
+}
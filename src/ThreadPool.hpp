@@ -0,0 +1,139 @@
+#ifndef THREAD_POOL_HPP_
+#define THREAD_POOL_HPP_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <cstddef>
+#include <atomic>
+#include <algorithm>
+
+namespace raptor
+{
+	/**
+	 * @brief Calls `body(i)` for every `i` from 0 to `count` with new threads and waits for them
+	 *
+	 * Every thread takes the next index not taken yet, so bodies of different lengths are balanced.
+	 *
+	 * @tparam F Callable `void(size_t)`
+	 * @param count Number of indices
+	 * @param body Called once for each index, it must not throw
+	 * @param thread_count Number of threads including the calling one, 0 for the number of hardware threads
+	 */
+	template<typename F>
+	void parallelFor(const size_t count, F&& body, size_t thread_count = 0)
+	{
+		if (thread_count == 0)
+			thread_count = std::max(1u, std::thread::hardware_concurrency());
+		thread_count = std::min(thread_count, count);
+		std::atomic<size_t> next = 0;
+		auto work = [&]()
+		{
+			for (size_t i = next++; i < count; i = next++)
+				body(i);
+		};
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < thread_count; ++i)
+			threads.emplace_back(work);
+		work();
+		for (auto&& thread : threads)
+			thread.join();
+	}
+
+	/**
+	 * @brief Fixed set of threads which run one job together
+	 *
+	 * The threads wait between jobs, so a job can be as short as one round of a search.
+	 *
+	 */
+	class ThreadPool
+	{
+	private:
+		std::vector<std::thread> threads_;
+
+		/**
+		 * @brief Serializes `run` called from more threads
+		 *
+		 */
+		std::mutex run_mutex_;
+
+		/**
+		 * @brief Guards all members below
+		 *
+		 */
+		std::mutex mutex_;
+		std::condition_variable start_;
+		std::condition_variable done_;
+
+		/**
+		 * @brief Current job, called with the job and the index of the worker
+		 *
+		 */
+		void (*call_)(void*, size_t) = nullptr;
+		void* job_ = nullptr;
+
+		/**
+		 * @brief Incremented for every job, so a worker runs each job once
+		 *
+		 */
+		size_t generation_ = 0;
+
+		/**
+		 * @brief Number of threads which didn't finish the current job yet
+		 *
+		 */
+		size_t running_ = 0;
+		bool stop_ = false;
+
+		/**
+		 * @brief Runs jobs with index `worker` until the pool is destroyed
+		 *
+		 */
+		void work(size_t worker);
+
+		/**
+		 * @brief Runs `call(job, worker)` on all workers and waits for them
+		 *
+		 */
+		void runJob(void (*call)(void*, size_t), void* job);
+	public:
+		/**
+		 * @brief Starts the threads
+		 *
+		 * @param thread_count Number of workers including the thread calling `run`, 0 for the number of hardware threads
+		 */
+		explicit ThreadPool(size_t thread_count);
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		~ThreadPool();
+
+		/**
+		 * @brief Returns number of workers including the thread calling `run`
+		 *
+		 * @return Number of workers
+		 */
+		size_t size() const
+		{
+			return threads_.size() + 1;
+		}
+
+		/**
+		 * @brief Calls `job(worker)` for every worker index and returns when all calls return
+		 *
+		 * The calling thread runs worker 0. Calls from more threads at once run one after another.
+		 *
+		 * @tparam F Callable `void(size_t)`
+		 * @param job Job run by each worker, it must not throw
+		 */
+		template<typename F>
+		void run(F&& job)
+		{
+			using Job = std::remove_reference_t<F>;
+			runJob([](void* j, size_t worker) { (*static_cast<Job*>(j))(worker); }, const_cast<void*>(static_cast<const void*>(&job)));
+		}
+	};
+}
+
+#endif // !THREAD_POOL_HPP_
@@ -0,0 +1,343 @@
+#include <TransferPatterns.hpp>
+#include <ConnectionScan.hpp>
+#include <ThreadPool.hpp>
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <array>
+#include <ranges>
+#include <iterator>
+
+namespace raptor
+{
+	namespace
+	{
+		constexpr char file_magic[4] = { 'T', 'P', 'A', 'T' };
+		constexpr uint32_t file_version = 2;
+	}
+
+	TransferPatternsEngine::SourcePatterns TransferPatternsEngine::sourcePatterns(const StopId source, const ConnectionScanEngine& scan, ProfileWorkspace& workspace) const
+	{
+		auto& entries = workspace.entries;
+		auto& arrivals = workspace.arrivals;
+		auto& trip_arrivals = workspace.trip_arrivals;
+		auto& trips = workspace.trips;
+		entries.assign(1, PatternNode{ static_cast<uint32_t>(source), PatternNode::npos, 0 });
+		for (auto&& profile : arrivals)
+			profile.clear();
+		for (auto&& profile : trip_arrivals)
+			profile.clear();
+		trips.assign(scan.tripCount(), std::pair(undefined_time, 0u));
+
+		// latest departure from the source of a journey which arrives to `stop` strictly before `time`, with its entry
+		auto board = [&](const StopId stop, const Time_t time)
+		{
+			if (stop == source)
+				return std::pair(time, 0u);
+			auto&& profile = arrivals[stop];
+			auto next = std::ranges::lower_bound(profile, time, std::less<>(), &ProfilePoint::arrival);
+			if (next == profile.begin())
+				return std::pair(undefined_time, 0u);
+			--next;
+			return std::pair(next->departure, next->entry);
+		};
+		// adds `point` to `profile` unless a journey departing later and arriving earlier is there, removes journeys it dominates
+		auto insert = [](std::vector<ProfilePoint>& profile, const ProfilePoint& point)
+		{
+			auto first = std::ranges::lower_bound(profile, point.arrival, std::less<>(), &ProfilePoint::arrival);
+			auto next = std::ranges::upper_bound(first, profile.end(), point.arrival, std::less<>(), &ProfilePoint::arrival);
+			if (next != profile.begin() && std::prev(next)->departure >= point.departure)
+				return false;
+			auto last = std::ranges::find_if(first, profile.end(), [&](const ProfilePoint& other) { return other.departure > point.departure; });
+			if (first == last)
+				profile.insert(first, point);
+			else
+			{
+				*first = point;
+				profile.erase(first + 1, last);
+			}
+			return true;
+		};
+
+		// no journey can board a connection before the first one from the source
+		auto&& connections = scan.connections();
+		for (auto&& c : std::ranges::subrange(std::ranges::find(connections, source, &Connection::from), connections.end()))
+		{
+			auto& trip = trips[c.trip];
+			const auto boarding = board(c.from, c.departure);
+			if (boarding.first > trip.first)
+				trip = boarding;
+			if (trip.first == undefined_time)
+				continue;
+			// walks start from the arrival by a trip, even if the stop was reached earlier by a walk, see `RoutingEngine`
+			const uint32_t entry = static_cast<uint32_t>(entries.size());
+			const ProfilePoint point{ trip.first, c.arrival, entry };
+			if (!insert(trip_arrivals[c.to], point))
+				continue;
+			entries.push_back(PatternNode{ static_cast<uint32_t>(c.to), trip.second, 0 });
+			if (c.to != source)
+				insert(arrivals[c.to], point);
+			for (auto&& footpath : scan.footpaths(c.to))
+			{
+				const ProfilePoint walk{ trip.first, c.arrival + footpath.time, static_cast<uint32_t>(entries.size()) };
+				if (footpath.target != source && insert(arrivals[footpath.target], walk))
+					entries.push_back(PatternNode{ static_cast<uint32_t>(footpath.target), entry, footpath.time });
+			}
+		}
+
+		// journeys left in the profiles are optimal for some departure, entries of a shared prefix get the same tree node
+		SourcePatterns result;
+		result.nodes.push_back(entries.front());
+		auto& tree_nodes = workspace.tree_nodes;
+		tree_nodes.assign(entries.size(), PatternNode::npos);
+		tree_nodes.front() = 0;
+		std::map<std::tuple<uint32_t, uint32_t, Time_t>, uint32_t> children;
+		std::vector<uint32_t> chain;
+		for (size_t target = 0; target < arrivals.size(); ++target)
+		{
+			for (auto&& point : arrivals[target])
+			{
+				chain.clear();
+				for (uint32_t entry = point.entry; tree_nodes[entry] == PatternNode::npos; entry = entries[entry].parent)
+					chain.push_back(entry);
+				for (auto&& entry : chain | std::views::reverse)
+				{
+					const PatternNode& pattern_node = entries[entry];
+					const uint32_t parent = tree_nodes[pattern_node.parent];
+					auto [child, inserted] = children.try_emplace(std::tuple(parent, pattern_node.stop, pattern_node.walk), static_cast<uint32_t>(result.nodes.size()));
+					if (inserted)
+						result.nodes.push_back(PatternNode{ pattern_node.stop, parent, pattern_node.walk });
+					tree_nodes[entry] = child->second;
+				}
+				result.ends.push_back(PatternEnd{ static_cast<uint32_t>(target), tree_nodes[point.entry] });
+			}
+		}
+		auto by_target = [](const PatternEnd& a, const PatternEnd& b) { return std::tie(a.target, a.node) < std::tie(b.target, b.node); };
+		std::ranges::sort(result.ends, by_target);
+		auto same = [](const PatternEnd& a, const PatternEnd& b) { return a.target == b.target && a.node == b.node; };
+		result.ends.erase(std::unique(result.ends.begin(), result.ends.end(), same), result.ends.end());
+		return result;
+	}
+
+	void TransferPatternsEngine::computePatterns(const size_t thread_count)
+	{
+		const ConnectionScanEngine scan(routes_, stops_, speed_);
+		std::vector<SourcePatterns> sources(stops_.size());
+		// sources are independent, `sourcePatterns` clears the workspace of its thread
+		parallelFor(sources.size(), [&](const size_t source)
+		{
+			thread_local ProfileWorkspace workspace;
+			workspace.arrivals.resize(stops_.size());
+			workspace.trip_arrivals.resize(stops_.size());
+			sources[source] = sourcePatterns(source, scan, workspace);
+		}, thread_count);
+
+		node_offsets_.assign(1, 0);
+		end_offsets_.assign(1, 0);
+		for (auto&& source : sources)
+		{
+			nodes_.insert(nodes_.end(), source.nodes.begin(), source.nodes.end());
+			ends_.insert(ends_.end(), source.ends.begin(), source.ends.end());
+			node_offsets_.push_back(nodes_.size());
+			end_offsets_.push_back(ends_.size());
+		}
+	}
+
+	TransferPatternsEngine::TransferPatternsEngine(const RouteTraversal& routes, const Stops& stops, WalkingSpeed speed, size_t thread_count)
+		: routes_(routes), stops_(stops), speed_(speed)
+	{
+		computePatterns(thread_count);
+	}
+
+	TransferPatternsEngine::TransferPatternsEngine(const RouteTraversal& routes, const Stops& stops, WalkingSpeed speed, std::istream& in)
+		: routes_(routes), stops_(stops), speed_(speed)
+	{
+		const auto magic = readValue<std::array<char, 4>>(in);
+		if (!std::ranges::equal(magic, file_magic) || readValue<uint32_t>(in) != file_version)
+			throw std::runtime_error("Not a file with transfer patterns");
+		if (readValue<uint32_t>(in) != static_cast<uint32_t>(speed_))
+			throw std::runtime_error("Transfer patterns were saved for a different walking speed");
+		const auto fingerprint = readValue<uint64_t>(in);
+		const auto stop_count = readValue<uint64_t>(in);
+		if (fingerprint != timetableFingerprint(routes_, stops_) || stop_count != stops_.size())
+			throw std::runtime_error("Transfer patterns were saved for a different timetable");
+		const auto node_count = readValue<uint64_t>(in);
+		const auto end_count = readValue<uint64_t>(in);
+		auto read_offsets = [&](std::vector<size_t>& offsets, const uint64_t total)
+		{
+			offsets.reserve(stop_count + 1);
+			for (size_t i = 0; i <= stop_count; ++i)
+			{
+				const auto offset = readValue<uint64_t>(in);
+				if (offset > total || (!offsets.empty() && offset < offsets.back()))
+					throw std::runtime_error("Saved transfer patterns are corrupted");
+				offsets.push_back(offset);
+			}
+			if (offsets.front() != 0 || offsets.back() != total)
+				throw std::runtime_error("Saved transfer patterns are corrupted");
+		};
+		read_offsets(node_offsets_, node_count);
+		read_offsets(end_offsets_, end_count);
+		nodes_.reserve(node_count);
+		for (size_t source = 0; source < stop_count; ++source)
+		{
+			const size_t size = node_offsets_[source + 1] - node_offsets_[source];
+			for (size_t node = 0; node < size; ++node)
+			{
+				const auto pattern_node = readValue<PatternNode>(in);
+				// parents come before their children
+				const bool is_root = node == 0 && pattern_node.parent == PatternNode::npos;
+				if (pattern_node.stop >= stop_count || (!is_root && pattern_node.parent >= node))
+					throw std::runtime_error("Saved transfer patterns are corrupted");
+				nodes_.push_back(pattern_node);
+			}
+		}
+		ends_.reserve(end_count);
+		for (size_t source = 0; source < stop_count; ++source)
+		{
+			const size_t size = node_offsets_[source + 1] - node_offsets_[source];
+			for (size_t end = end_offsets_[source]; end < end_offsets_[source + 1]; ++end)
+			{
+				const auto pattern_end = readValue<PatternEnd>(in);
+				if (pattern_end.target >= stop_count || pattern_end.node >= size)
+					throw std::runtime_error("Saved transfer patterns are corrupted");
+				ends_.push_back(pattern_end);
+			}
+		}
+	}
+
+	void TransferPatternsEngine::save(std::ostream& out) const
+	{
+		out.write(file_magic, sizeof(file_magic));
+		writeValue(out, file_version);
+		writeValue(out, static_cast<uint32_t>(speed_));
+		writeValue(out, timetableFingerprint(routes_, stops_));
+		writeValue(out, static_cast<uint64_t>(stops_.size()));
+		writeValue(out, static_cast<uint64_t>(nodes_.size()));
+		writeValue(out, static_cast<uint64_t>(ends_.size()));
+		for (auto&& offset : node_offsets_)
+			writeValue(out, static_cast<uint64_t>(offset));
+		for (auto&& offset : end_offsets_)
+			writeValue(out, static_cast<uint64_t>(offset));
+		for (auto&& node : nodes_)
+			writeValue(out, node);
+		for (auto&& end : ends_)
+			writeValue(out, end);
+	}
+
+	TransferPatternsEngine::DirectTrip TransferPatternsEngine::directTrip(const StopId from, const StopId to, const Time_t time) const
+	{
+		DirectTrip best{ inf_time, undefined_trip };
+		for (auto&& stop_route : stops_.getRoutes(from))
+		{
+			const Route& r = routes_[stop_route.route];
+			// the first occurrence of `to` after boarding is reached first
+			auto last = r.route_stops_ptr + r.stops_count;
+			auto found = std::find(r.route_stops_ptr + stop_route.stop_index + 1, last, to);
+			if (found == last)
+				continue;
+			const size_t trip = routes_.earliestTripIndex(stop_route.route, stop_route.stop_index, time);
+			if (trip == RouteTraversal::no_trip)
+				continue;
+			const Time_t arrival = r.arrivals_ptr[(found - r.route_stops_ptr) * r.trips() + trip];
+			if (arrival < best.arrival)
+				best = DirectTrip{ arrival, routes_.tripAt(stop_route.route, trip, stop_route.stop_index) };
+		}
+		return best;
+	}
+
+	Time_t TransferPatternsEngine::evaluate(const StopId source, const size_t node, const Time_t departure, PatternWorkspace& workspace) const
+	{
+		const PatternNode* tree = nodes_.data() + node_offsets_[source];
+		auto& arrivals = workspace.arrivals;
+		auto& chain = workspace.chain;
+		chain.clear();
+		for (size_t n = node; n != PatternNode::npos && arrivals[n] == undefined_time; n = tree[n].parent)
+			chain.push_back(n);
+		for (auto&& n : chain | std::views::reverse)
+		{
+			const PatternNode& pattern_node = tree[n];
+			if (pattern_node.parent == PatternNode::npos)
+				arrivals[n] = departure;
+			else if (arrivals[pattern_node.parent] == inf_time)
+				arrivals[n] = inf_time;
+			else if (pattern_node.walk != 0)
+				arrivals[n] = arrivals[pattern_node.parent] + pattern_node.walk;
+			else
+				arrivals[n] = directTrip(tree[pattern_node.parent].stop, pattern_node.stop, arrivals[pattern_node.parent]).arrival;
+		}
+		return arrivals[node];
+	}
+
+	std::variant<path_t, std::string> TransferPatternsEngine::findRoute(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure) const
+	{
+		if (starts == ends)
+			return "Start and end are the same stop\n";
+		thread_local PatternWorkspace workspace;
+		Time_t best = inf_time;
+		StopId best_source = undefined::stop;
+		size_t best_node = PatternNode::npos;
+		for (auto&& start : starts)
+		{
+			if (std::ranges::find(ends, start) != ends.end())
+			{
+				best = departure;
+				best_source = start;
+			}
+		}
+		for (auto&& start : starts)
+		{
+			if (best == departure)
+				break;
+			workspace.arrivals.assign(node_offsets_[start + 1] - node_offsets_[start], undefined_time);
+			auto first = ends_.begin() + end_offsets_[start];
+			auto last = ends_.begin() + end_offsets_[start + 1];
+			for (auto&& end : ends)
+			{
+				auto&& [end_first, end_last] = std::ranges::equal_range(first, last, static_cast<uint32_t>(end), std::less<>(), &PatternEnd::target);
+				for (auto&& pattern_end : std::ranges::subrange(end_first, end_last))
+				{
+					const Time_t arrival = evaluate(start, pattern_end.node, departure, workspace);
+					if (arrival < best)
+					{
+						best = arrival;
+						best_source = start;
+						best_node = pattern_end.node;
+					}
+				}
+			}
+		}
+		if (best == inf_time)
+			return "End stop unreachable\n";
+		path_t v;
+		if (best_node == PatternNode::npos)
+		{
+			v.push_back(std::pair(best_source, 0));
+			return v;
+		}
+		// the pattern is evaluated again from the source to read its trips
+		const PatternNode* tree = nodes_.data() + node_offsets_[best_source];
+		auto& chain = workspace.chain;
+		chain.clear();
+		for (size_t n = best_node; n != PatternNode::npos; n = tree[n].parent)
+			chain.push_back(n);
+		Time_t time = departure;
+		StopId stop = best_source;
+		v.push_back(std::pair(stop, 0));
+		for (auto&& n : chain | std::views::reverse | std::views::drop(1))
+		{
+			const PatternNode& pattern_node = tree[n];
+			if (pattern_node.walk != 0)
+				time += pattern_node.walk;
+			else
+			{
+				const DirectTrip trip = directTrip(stop, pattern_node.stop, time);
+				v.push_back(trip.trip);
+				time = trip.arrival;
+			}
+			stop = pattern_node.stop;
+			v.push_back(std::pair(stop, time - departure));
+		}
+		return v;
+	}
+}
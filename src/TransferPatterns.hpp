@@ -0,0 +1,261 @@
+#ifndef TRANSFER_PATTERNS_HPP_
+#define TRANSFER_PATTERNS_HPP_
+
+#include <RoutingEngine.hpp>
+#include <vector>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <limits>
+#include <utility>
+
+namespace raptor
+{
+	class ConnectionScanEngine;
+
+	/**
+	 * @brief Node of the tree of transfer patterns of one source stop
+	 *
+	 * The path from the root to a node is a sequence of stops where a trip was boarded, left or where a walk ended.
+	 *
+	 */
+	struct PatternNode
+	{
+		static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+		uint32_t stop;
+
+		/**
+		 * @brief Index of the parent node among nodes of the same source, `npos` for the root
+		 *
+		 */
+		uint32_t parent;
+
+		/**
+		 * @brief Time of the walk from the stop of the parent including the transfer penalty, zero if the node is reached by a trip
+		 *
+		 */
+		Time_t walk;
+	};
+
+	/**
+	 * @brief Node of a source tree where a transfer pattern to `target` ends
+	 *
+	 */
+	struct PatternEnd
+	{
+		uint32_t target;
+		uint32_t node;
+	};
+
+	/**
+	 * @brief Transfer Patterns, answers queries from precomputed sequences of transfer stops of all optimal journeys
+	 *
+	 * For each source stop, one profile connection scan finds journeys with the earliest arrival to all stops
+	 * for every departure from the source. Stops where these journeys board, leave a trip or end a walk
+	 * form a transfer pattern, patterns of one source are merged into a tree. A query evaluates only
+	 * the patterns from its start to its end against the timetable, looking up direct trips between
+	 * following stops of a pattern.
+	 *
+	 */
+	class TransferPatternsEngine final : public RoutingEngine
+	{
+	private:
+		const RouteTraversal& routes_;
+		const Stops& stops_;
+		WalkingSpeed speed_;
+
+		/**
+		 * @brief Tree of source `s` is `nodes_[node_offsets_[s]]` to `nodes_[node_offsets_[s+1]]`, its root is the first node
+		 *
+		 */
+		std::vector<size_t> node_offsets_;
+		std::vector<PatternNode> nodes_;
+
+		/**
+		 * @brief Pattern ends of source `s` are `ends_[end_offsets_[s]]` to `ends_[end_offsets_[s+1]]`, sorted by target
+		 *
+		 */
+		std::vector<size_t> end_offsets_;
+		std::vector<PatternEnd> ends_;
+
+		/**
+		 * @brief Nodes and pattern ends of one source
+		 *
+		 */
+		struct SourcePatterns
+		{
+			std::vector<PatternNode> nodes;
+			std::vector<PatternEnd> ends;
+		};
+
+		/**
+		 * @brief Journey of the profile scan which departs from the source at `departure` and arrives at `arrival`
+		 *
+		 */
+		struct ProfilePoint
+		{
+			Time_t departure;
+			Time_t arrival;
+
+			/**
+			 * @brief Index of the last stop of the journey in `ProfileWorkspace::entries`
+			 *
+			 */
+			uint32_t entry;
+		};
+
+		/**
+		 * @brief Memory used by the profile scan of one source, reused for following sources
+		 *
+		 */
+		struct ProfileWorkspace
+		{
+			/**
+			 * @brief Stops of all journeys found by the scan, `parent` is an index of the previous stop of the journey
+			 *
+			 */
+			std::vector<PatternNode> entries;
+
+			/**
+			 * @brief Journeys to each stop which are not dominated by a journey departing later and arriving earlier,
+			 * sorted by arrival and so also by departure
+			 *
+			 */
+			std::vector<std::vector<ProfilePoint>> arrivals;
+
+			/**
+			 * @brief Journeys to each stop like `arrivals` which end by a trip, walks start from them
+			 *
+			 */
+			std::vector<std::vector<ProfilePoint>> trip_arrivals;
+
+			/**
+			 * @brief Latest departure from the source of a journey which boards each trip and the entry of its boarding stop,
+			 * `raptor::undefined_time` if the trip was not boarded
+			 *
+			 */
+			std::vector<std::pair<Time_t, uint32_t>> trips;
+
+			/**
+			 * @brief Node of the tree of each entry, `PatternNode::npos` if it was not added to the tree
+			 *
+			 */
+			std::vector<uint32_t> tree_nodes;
+		};
+
+		/**
+		 * @brief Memory used by one query, reused by the following queries of the same thread
+		 *
+		 */
+		struct PatternWorkspace
+		{
+			/**
+			 * @brief Arrivals to nodes of the tree of one source, `raptor::undefined_time` if not evaluated yet
+			 *
+			 */
+			std::vector<Time_t> arrivals;
+
+			/**
+			 * @brief Nodes of a pattern which are evaluated next
+			 *
+			 */
+			std::vector<size_t> chain;
+		};
+
+		/**
+		 * @brief Computes transfer patterns of all journeys from `source`
+		 *
+		 * Connections are scanned once, each trip is boarded by the journey which departs from the source the latest.
+		 * Profiles of stops then hold the earliest arrival for every departure from the source.
+		 *
+		 * @param source A stop
+		 * @param scan Connection scan over the timetable
+		 * @param workspace Workspace of the profile scan
+		 * @return Tree of patterns of `source`
+		 */
+		SourcePatterns sourcePatterns(StopId source, const ConnectionScanEngine& scan, ProfileWorkspace& workspace) const;
+
+		/**
+		 * @brief Computes patterns of all sources with `thread_count` threads
+		 *
+		 * @param thread_count Number of threads, 0 for the number of hardware threads
+		 */
+		void computePatterns(size_t thread_count);
+
+		/**
+		 * @brief Trip which is the earliest one to arrive to `to` when boarded at `from` strictly after `time`
+		 *
+		 */
+		struct DirectTrip
+		{
+			Time_t arrival;
+			RouteTraversal::trip_iterator trip;
+		};
+
+		/**
+		 * @brief Finds the earliest arrival by one trip from `from` to `to`
+		 *
+		 * @param from Boarding stop
+		 * @param to Stop where the trip is left
+		 * @param time Trip must depart strictly after this time
+		 * @return Trip with the earliest arrival, arrival is `raptor::inf_time` if there is no such trip
+		 */
+		DirectTrip directTrip(StopId from, StopId to, Time_t time) const;
+
+		/**
+		 * @brief Evaluates the pattern ending at `node` of source `source`
+		 *
+		 * Arrivals of nodes are memoized in `workspace.arrivals`, so shared prefixes are evaluated once.
+		 *
+		 * @param source Source stop
+		 * @param node Node of the tree of `source`
+		 * @param departure Departure from the source
+		 * @param workspace Workspace with memoized arrivals
+		 * @return Earliest arrival to the stop of `node` following its pattern
+		 */
+		Time_t evaluate(StopId source, size_t node, Time_t departure, PatternWorkspace& workspace) const;
+	public:
+		/**
+		 * @brief Precomputes transfer patterns of all stops, both arguments must outlive the engine
+		 *
+		 * @param routes Routes of the timetable
+		 * @param stops Stops of the timetable
+		 * @param speed Walking speed used for footpaths
+		 * @param thread_count Number of threads used for precomputation, 0 for the number of hardware threads
+		 */
+		TransferPatternsEngine(const RouteTraversal& routes, const Stops& stops, WalkingSpeed speed, size_t thread_count = 0);
+
+		/**
+		 * @brief Loads patterns saved by `save` for the same timetable and walking speed
+		 *
+		 * @param routes Routes of the timetable
+		 * @param stops Stops of the timetable
+		 * @param speed Walking speed used for footpaths
+		 * @param in Stream with saved patterns, opened in binary mode
+		 * @throws std::runtime_error If the stream can't be read or it was saved for a different timetable or speed
+		 */
+		TransferPatternsEngine(const RouteTraversal& routes, const Stops& stops, WalkingSpeed speed, std::istream& in);
+
+		/**
+		 * @brief Writes precomputed patterns to `out`
+		 *
+		 * @param out Stream opened in binary mode
+		 */
+		void save(std::ostream& out) const;
+
+		/**
+		 * @brief Returns number of nodes in trees of all sources
+		 *
+		 * @return Count of pattern nodes
+		 */
+		size_t nodeCount() const
+		{
+			return nodes_.size();
+		}
+
+		std::variant<path_t, std::string> findRoute(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure) const override;
+	};
+}
+
+#endif // !TRANSFER_PATTERNS_HPP_
@@ -0,0 +1,359 @@
+#include <TripBased.hpp>
+#include <ThreadPool.hpp>
+#include <algorithm>
+#include <tuple>
+#include <array>
+
+namespace raptor
+{
+	namespace
+	{
+		constexpr char file_magic[4] = { 'T', 'B', 'T', 'R' };
+		constexpr uint32_t file_version = 2;
+	}
+
+	void TripBasedEngine::buildIndices()
+	{
+		route_trips_.assign(1, 0);
+		trip_events_.assign(1, 0);
+		for (size_t route = 0; route < routes_.size(); ++route)
+		{
+			const Route& r = routes_[route];
+			const size_t trips = r.trips();
+			for (size_t trip = 0; trip < trips; ++trip)
+			{
+				trip_routes_.push_back(static_cast<uint32_t>(route));
+				trip_events_.push_back(trip_events_.back() + r.stops_count);
+			}
+			route_trips_.push_back(route_trips_.back() + trips);
+		}
+
+		footpath_offsets_.reserve(stops_.size() + 1);
+		for (size_t stop = 0; stop < stops_.size(); ++stop)
+		{
+			footpath_offsets_.push_back(footpaths_.size());
+			for (auto&& transfer : stops_.getTransfers(stop))
+			{
+				const Time_t walk = walkingTime(transfer.distance, speed_);
+				if (walk < max_walking_time)
+					footpaths_.push_back(Footpath{ transfer.target_stop, walk + transfer_penalty });
+			}
+		}
+		footpath_offsets_.push_back(footpaths_.size());
+	}
+
+	Time_t TripBasedEngine::arrival(const size_t trip, const size_t stop_index) const
+	{
+		const size_t route = trip_routes_[trip];
+		const Route& r = routes_[route];
+		return r.arrivals_ptr[stop_index * r.trips() + (trip - route_trips_[route])];
+	}
+
+	std::vector<TripTransfer> TripBasedEngine::routeTransfers(const size_t route, std::vector<Time_t>& best, std::vector<size_t>& counts) const
+	{
+		const Route& r = routes_[route];
+		const size_t trips = r.trips();
+		const size_t stop_count = r.stops_count;
+		counts.assign(trips * stop_count, 0);
+		std::vector<TripTransfer> result;
+		std::vector<StopId> touched;
+		std::vector<TripTransfer> candidates;
+		std::vector<std::vector<TripTransfer>> kept(stop_count);
+
+		auto improve = [&](const StopId stop, const Time_t time)
+		{
+			if (time >= best[stop])
+				return false;
+			if (best[stop] == inf_time)
+				touched.push_back(stop);
+			best[stop] = time;
+			return true;
+		};
+		// a stop reached by a trip can be left by footpaths, even if the stop itself was reached earlier
+		auto improve_with_footpaths = [&](const StopId stop, const Time_t time)
+		{
+			bool improved = improve(stop, time);
+			for (size_t f = footpath_offsets_[stop]; f < footpath_offsets_[stop + 1]; ++f)
+				improved = improve(footpaths_[f].target, time + footpaths_[f].time) || improved;
+			return improved;
+		};
+
+		for (size_t trip = 0; trip < trips; ++trip)
+		{
+			// transfers at later stops are kept first, a transfer is kept only if it reaches some stop earlier than all of them
+			for (size_t index = stop_count; index-- > 1;)
+			{
+				const Time_t arrival_time = r.arrivals_ptr[index * trips + trip];
+				const StopId stop = r.route_stops_ptr[index];
+				improve_with_footpaths(stop, arrival_time);
+
+				candidates.clear();
+				auto add_routes = [&](const StopId from, const Time_t walk)
+				{
+					for (auto&& stop_route : stops_.getRoutes(from))
+					{
+						const size_t other_route = stop_route.route;
+						// nothing can be reached by boarding at the last stop
+						if (stop_route.stop_index + 1 >= routes_[other_route].stops_count)
+							continue;
+						const size_t other_trip = routes_.earliestTripIndex(stop_route.route, stop_route.stop_index, arrival_time + walk);
+						if (other_trip == RouteTraversal::no_trip)
+							continue;
+						// staying in the trip is at least as good as a later trip of the same route
+						if (other_route == route && other_trip >= trip && stop_route.stop_index >= index)
+							continue;
+						candidates.push_back(TripTransfer{ static_cast<uint32_t>(route_trips_[other_route] + other_trip), static_cast<uint32_t>(stop_route.stop_index), walk });
+					}
+				};
+				add_routes(stop, 0);
+				for (size_t f = footpath_offsets_[stop]; f < footpath_offsets_[stop + 1]; ++f)
+					add_routes(footpaths_[f].target, footpaths_[f].time);
+
+				for (auto&& candidate : candidates)
+				{
+					const size_t other_route = trip_routes_[candidate.trip];
+					const Route& other = routes_[other_route];
+					const size_t other_trips = other.trips();
+					const size_t other_trip = candidate.trip - route_trips_[other_route];
+					bool useful = false;
+					for (size_t next = candidate.stop_index + 1; next < other.stops_count; ++next)
+						useful = improve_with_footpaths(other.route_stops_ptr[next], other.arrivals_ptr[next * other_trips + other_trip]) || useful;
+					if (useful)
+						kept[index].push_back(candidate);
+				}
+			}
+			for (size_t index = 0; index < stop_count; ++index)
+			{
+				counts[trip * stop_count + index] = kept[index].size();
+				result.insert(result.end(), kept[index].begin(), kept[index].end());
+				kept[index].clear();
+			}
+			for (auto&& stop : touched)
+				best[stop] = inf_time;
+			touched.clear();
+		}
+		return result;
+	}
+
+	void TripBasedEngine::computeTransfers(const size_t thread_count)
+	{
+		std::vector<std::vector<TripTransfer>> route_transfers(routes_.size());
+		std::vector<std::vector<size_t>> route_counts(routes_.size());
+		// routes are independent, `routeTransfers` leaves all best arrivals of its thread at `inf_time`
+		parallelFor(routes_.size(), [&](const size_t route)
+		{
+			thread_local std::vector<Time_t> best;
+			best.resize(stops_.size(), inf_time);
+			route_transfers[route] = routeTransfers(route, best, route_counts[route]);
+		}, thread_count);
+
+		transfer_offsets_.reserve(trip_events_.back() + 1);
+		transfer_offsets_.push_back(0);
+		for (size_t route = 0; route < routes_.size(); ++route)
+		{
+			for (auto&& count : route_counts[route])
+				transfer_offsets_.push_back(transfer_offsets_.back() + count);
+			transfers_.insert(transfers_.end(), route_transfers[route].begin(), route_transfers[route].end());
+		}
+	}
+
+	TripBasedEngine::TripBasedEngine(const RouteTraversal& routes, const Stops& stops, WalkingSpeed speed, size_t thread_count)
+		: routes_(routes), stops_(stops), speed_(speed)
+	{
+		buildIndices();
+		computeTransfers(thread_count);
+	}
+
+	TripBasedEngine::TripBasedEngine(const RouteTraversal& routes, const Stops& stops, WalkingSpeed speed, std::istream& in)
+		: routes_(routes), stops_(stops), speed_(speed)
+	{
+		buildIndices();
+		const auto magic = readValue<std::array<char, 4>>(in);
+		if (!std::ranges::equal(magic, file_magic) || readValue<uint32_t>(in) != file_version)
+			throw std::runtime_error("Not a file with trip transfers");
+		if (readValue<uint32_t>(in) != static_cast<uint32_t>(speed_))
+			throw std::runtime_error("Trip transfers were saved for a different walking speed");
+		const auto fingerprint = readValue<uint64_t>(in);
+		const auto trip_count = readValue<uint64_t>(in);
+		const auto event_count = readValue<uint64_t>(in);
+		if (fingerprint != timetableFingerprint(routes_, stops_) || trip_count != trip_routes_.size() || event_count != trip_events_.back())
+			throw std::runtime_error("Trip transfers were saved for a different timetable");
+		const auto transfer_count = readValue<uint64_t>(in);
+		transfer_offsets_.reserve(event_count + 1);
+		for (size_t event = 0; event <= event_count; ++event)
+		{
+			const auto offset = readValue<uint64_t>(in);
+			if (offset > transfer_count || (!transfer_offsets_.empty() && offset < transfer_offsets_.back()))
+				throw std::runtime_error("Saved trip transfers are corrupted");
+			transfer_offsets_.push_back(offset);
+		}
+		if (transfer_offsets_.front() != 0 || transfer_offsets_.back() != transfer_count)
+			throw std::runtime_error("Saved trip transfers are corrupted");
+		transfers_.reserve(transfer_count);
+		for (size_t i = 0; i < transfer_count; ++i)
+		{
+			const auto transfer = readValue<TripTransfer>(in);
+			if (transfer.trip >= trip_count || transfer.stop_index >= routes_[trip_routes_[transfer.trip]].stops_count)
+				throw std::runtime_error("Saved trip transfers are corrupted");
+			transfers_.push_back(transfer);
+		}
+	}
+
+	void TripBasedEngine::save(std::ostream& out) const
+	{
+		out.write(file_magic, sizeof(file_magic));
+		writeValue(out, file_version);
+		writeValue(out, static_cast<uint32_t>(speed_));
+		writeValue(out, timetableFingerprint(routes_, stops_));
+		writeValue(out, static_cast<uint64_t>(trip_routes_.size()));
+		writeValue(out, static_cast<uint64_t>(trip_events_.back()));
+		writeValue(out, static_cast<uint64_t>(transfers_.size()));
+		for (auto&& offset : transfer_offsets_)
+			writeValue(out, static_cast<uint64_t>(offset));
+		for (auto&& transfer : transfers_)
+			writeValue(out, transfer);
+	}
+
+	std::variant<path_t, std::string> TripBasedEngine::findRoute(const std::vector<StopId>& starts, const std::vector<StopId>& ends, const Time_t departure) const
+	{
+		if (starts == ends)
+			return "Start and end are the same stop\n";
+		thread_local TripWorkspace workspace;
+		auto& reached = workspace.reached;
+		auto& segments = workspace.segments;
+		auto& targets = workspace.targets;
+		reached.assign(trip_routes_.size(), TripSegment::npos);
+		segments.clear();
+		targets.clear();
+
+		// an end is reached at every occurrence on a route, or by a walk from such a stop
+		auto add_targets = [&](const StopId from, const Time_t delay, const StopId end)
+		{
+			for (auto&& stop_route : stops_.getRoutes(from))
+			{
+				const Route& r = routes_[stop_route.route];
+				for (size_t index = stop_route.stop_index; index < r.stops_count; ++index)
+				{
+					if (r.route_stops_ptr[index] == from)
+						targets.push_back(TripTarget{ stop_route.route, index, delay, end });
+				}
+			}
+		};
+		for (auto&& end : ends)
+		{
+			add_targets(end, 0, end);
+			// transfers of stops are symmetric, so footpaths of the end lead from stops which can walk to it
+			for (size_t f = footpath_offsets_[end]; f < footpath_offsets_[end + 1]; ++f)
+				add_targets(footpaths_[f].target, footpaths_[f].time, end);
+		}
+		std::ranges::sort(targets, [](const TripTarget& a, const TripTarget& b) { return std::tie(a.route, a.stop_index) < std::tie(b.route, b.stop_index); });
+
+		Time_t best = inf_time;
+		size_t best_segment = TripSegment::npos;
+		TripTarget best_target{};
+		StopId best_start = undefined::stop;
+
+		auto enqueue = [&](const size_t trip, const size_t index, const size_t parent, const size_t parent_exit, const Time_t reach)
+		{
+			if (index >= reached[trip])
+				return;
+			const size_t route = trip_routes_[trip];
+			const size_t end = reached[trip] == TripSegment::npos ? routes_[route].stops_count - 1 : reached[trip];
+			segments.push_back(TripSegment{ trip, index, end, parent, parent_exit, reach });
+			// later trips of the route arrive later, so their stops after `index` are already reached too
+			for (size_t later = trip; later < route_trips_[route + 1] && reached[later] > index; ++later)
+				reached[later] = index;
+		};
+
+		for (auto&& start : starts)
+		{
+			if (std::ranges::find(ends, start) != ends.end())
+			{
+				best = departure;
+				best_start = start;
+			}
+			for (auto&& stop_route : stops_.getRoutes(start))
+			{
+				const size_t trip = routes_.earliestTripIndex(stop_route.route, stop_route.stop_index, departure);
+				if (trip != RouteTraversal::no_trip)
+					enqueue(route_trips_[stop_route.route] + trip, stop_route.stop_index, TripSegment::npos, 0, departure);
+			}
+		}
+
+		// segments of one level are reached with the same number of transfers
+		for (size_t level_begin = 0; level_begin < segments.size();)
+		{
+			const size_t level_end = segments.size();
+			for (size_t i = level_begin; i < level_end; ++i)
+			{
+				const TripSegment& segment = segments[i];
+				const size_t route = trip_routes_[segment.trip];
+				auto&& [first, last] = std::ranges::equal_range(targets, route, std::less<>(), &TripTarget::route);
+				for (auto&& target : std::ranges::subrange(first, last))
+				{
+					if (target.stop_index <= segment.begin || target.stop_index > segment.end)
+						continue;
+					const Time_t target_arrival = arrival(segment.trip, target.stop_index) + target.delay;
+					if (target_arrival < best)
+					{
+						best = target_arrival;
+						best_segment = i;
+						best_target = target;
+					}
+				}
+			}
+			for (size_t i = level_begin; i < level_end; ++i)
+			{
+				const TripSegment segment = segments[i];
+				for (size_t index = segment.begin + 1; index <= segment.end; ++index)
+				{
+					// everything reached by transfers from here departs after this arrival
+					const Time_t exit_arrival = arrival(segment.trip, index);
+					if (exit_arrival >= best)
+						break;
+					const size_t event = trip_events_[segment.trip] + index;
+					for (size_t t = transfer_offsets_[event]; t < transfer_offsets_[event + 1]; ++t)
+						enqueue(transfers_[t].trip, transfers_[t].stop_index, i, index, exit_arrival + transfers_[t].walk);
+				}
+			}
+			level_begin = level_end;
+		}
+
+		if (best == inf_time)
+			return "End stop unreachable\n";
+		path_t v;
+		if (best_segment == TripSegment::npos)
+		{
+			v.push_back(std::pair(best_start, 0));
+			return v;
+		}
+		auto stop_at = [&](const size_t trip, const size_t index)
+		{
+			return routes_[trip_routes_[trip]].route_stops_ptr[index];
+		};
+		const TripSegment* segment = &segments[best_segment];
+		v.push_back(std::pair(best_target.end, best - departure));
+		const StopId exit_stop = stop_at(segment->trip, best_target.stop_index);
+		if (exit_stop != best_target.end)
+			v.push_back(std::pair(exit_stop, arrival(segment->trip, best_target.stop_index) - departure));
+		while (true)
+		{
+			const size_t route = trip_routes_[segment->trip];
+			const StopId board_stop = stop_at(segment->trip, segment->begin);
+			v.push_back(routes_.tripAt(route, segment->trip - route_trips_[route], segment->begin));
+			if (segment->parent == TripSegment::npos)
+			{
+				v.push_back(std::pair(board_stop, segment->reach - departure));
+				break;
+			}
+			const TripSegment* parent = &segments[segment->parent];
+			const StopId left_stop = stop_at(parent->trip, segment->parent_exit);
+			// the boarding stop was reached by a walk from the stop where the parent trip was left
+			if (left_stop != board_stop)
+				v.push_back(std::pair(board_stop, segment->reach - departure));
+			v.push_back(std::pair(left_stop, arrival(parent->trip, segment->parent_exit) - departure));
+			segment = parent;
+		}
+		return path_t(v.rbegin(), v.rend());
+	}
+}
@@ -0,0 +1,251 @@
+#ifndef TRIP_BASED_HPP_
+#define TRIP_BASED_HPP_
+
+#include <RoutingEngine.hpp>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <istream>
+#include <ostream>
+
+namespace raptor
+{
+	/**
+	 * @brief Transfer from a stop of a trip to the earliest trip of a route which can be boarded after it
+	 *
+	 */
+	struct TripTransfer
+	{
+		/**
+		 * @brief Index of the boarded trip among all trips of the timetable
+		 *
+		 */
+		uint32_t trip;
+
+		/**
+		 * @brief Index of the boarding stop in stops of the route of `trip`
+		 *
+		 */
+		uint32_t stop_index;
+
+		/**
+		 * @brief Time from the arrival of the left trip to reaching the boarding stop, zero without walking
+		 *
+		 */
+		Time_t walk;
+	};
+
+	/**
+	 * @brief Part of a trip reached by the trip based search, see `raptor::TripBasedEngine`
+	 *
+	 */
+	struct TripSegment
+	{
+		static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+		/**
+		 * @brief Index of the trip among all trips of the timetable
+		 *
+		 */
+		size_t trip;
+
+		/**
+		 * @brief Index of the stop where the trip is boarded
+		 *
+		 */
+		size_t begin;
+
+		/**
+		 * @brief Last index of a stop which can be reached by this segment, later stops are reached by an other one
+		 *
+		 */
+		size_t end;
+
+		/**
+		 * @brief Segment from which this one was reached, `npos` if it was boarded at a start stop
+		 *
+		 */
+		size_t parent;
+
+		/**
+		 * @brief Index of the stop where the trip of `parent` was left
+		 *
+		 */
+		size_t parent_exit;
+
+		/**
+		 * @brief Absolute time when the boarding stop was reached
+		 *
+		 */
+		Time_t reach;
+	};
+
+	/**
+	 * @brief Stop of a route from which an end stop is reached, used by the trip based search
+	 *
+	 */
+	struct TripTarget
+	{
+		size_t route;
+		size_t stop_index;
+
+		/**
+		 * @brief Time of the walk from the stop to `end`, zero if it is the end stop
+		 *
+		 */
+		Time_t delay;
+		StopId end;
+	};
+
+	/**
+	 * @brief Trip-Based Public Transit Routing, breadth first search over trips with precomputed transfers between them
+	 *
+	 * For each stop of each trip the engine stores transfers to the earliest reachable trips of other routes.
+	 * Transfers which never give an earlier arrival to any stop are removed, so a query follows
+	 * only a few of them. Precomputation is run in parallel for routes and its result can be saved
+	 * and loaded for the same timetable.
+	 *
+	 */
+	class TripBasedEngine final : public RoutingEngine
+	{
+	private:
+		const RouteTraversal& routes_;
+		const Stops& stops_;
+
+		/**
+		 * @brief Trips of route `r` are `route_trips_[r]` to `route_trips_[r+1]` among all trips
+		 *
+		 */
+		std::vector<size_t> route_trips_;
+
+		/**
+		 * @brief Route of each trip
+		 *
+		 */
+		std::vector<uint32_t> trip_routes_;
+
+		/**
+		 * @brief Stop `i` of trip `t` is the stop event `trip_events_[t] + i`
+		 *
+		 */
+		std::vector<size_t> trip_events_;
+
+		/**
+		 * @brief Transfers of stop event `e` are `transfers_[transfer_offsets_[e]]` to `transfers_[transfer_offsets_[e+1]]`
+		 *
+		 */
+		std::vector<size_t> transfer_offsets_;
+		std::vector<TripTransfer> transfers_;
+
+		/**
+		 * @brief Walk from a stop to another stop with its time
+		 *
+		 */
+		struct Footpath
+		{
+			StopId target;
+			Time_t time;
+		};
+
+		/**
+		 * @brief Usable footpaths of stop `s` are `footpaths_[footpath_offsets_[s]]` to `footpaths_[footpath_offsets_[s+1]]`
+		 *
+		 */
+		std::vector<size_t> footpath_offsets_;
+		std::vector<Footpath> footpaths_;
+
+		WalkingSpeed speed_;
+
+		/**
+		 * @brief Memory used by one query, reused by the following queries of the same thread
+		 *
+		 */
+		struct TripWorkspace
+		{
+			/**
+			 * @brief First stop index reached on each trip, later trips of the route are limited by earlier ones
+			 *
+			 */
+			std::vector<size_t> reached;
+
+			/**
+			 * @brief Queue of reached segments, ordered by the number of transfers
+			 *
+			 */
+			std::vector<TripSegment> segments;
+
+			/**
+			 * @brief Stops from which ends are reached, sorted by route
+			 *
+			 */
+			std::vector<TripTarget> targets;
+		};
+
+		/**
+		 * @brief Builds indices of trips and stop events and footpaths, everything except transfers
+		 *
+		 */
+		void buildIndices();
+
+		/**
+		 * @brief Computes reduced transfers of all trips of `route`
+		 *
+		 * @param route A route
+		 * @param best Arrival to each stop, all of them are `raptor::inf_time` before and after the call
+		 * @param counts Number of transfers of each stop event of the route
+		 * @return Transfers of stop events of the route in order of stop events
+		 */
+		std::vector<TripTransfer> routeTransfers(size_t route, std::vector<Time_t>& best, std::vector<size_t>& counts) const;
+
+		/**
+		 * @brief Computes `transfers_` with `thread_count` threads
+		 *
+		 * @param thread_count Number of threads, 0 for the number of hardware threads
+		 */
+		void computeTransfers(size_t thread_count);
+
+		Time_t arrival(size_t trip, size_t stop_index) const;
+	public:
+		/**
+		 * @brief Precomputes transfers between trips of `routes`, both arguments must outlive the engine
+		 *
+		 * @param routes Routes of the timetable
+		 * @param stops Stops of the timetable
+		 * @param speed Walking speed used for footpaths
+		 * @param thread_count Number of threads used for precomputation, 0 for the number of hardware threads
+		 */
+		TripBasedEngine(const RouteTraversal& routes, const Stops& stops, WalkingSpeed speed, size_t thread_count = 0);
+
+		/**
+		 * @brief Loads transfers saved by `save` for the same timetable and walking speed
+		 *
+		 * @param routes Routes of the timetable
+		 * @param stops Stops of the timetable
+		 * @param speed Walking speed used for footpaths
+		 * @param in Stream with saved transfers, opened in binary mode
+		 * @throws std::runtime_error If the stream can't be read or it was saved for a different timetable or speed
+		 */
+		TripBasedEngine(const RouteTraversal& routes, const Stops& stops, WalkingSpeed speed, std::istream& in);
+
+		/**
+		 * @brief Writes precomputed transfers to `out`
+		 *
+		 * @param out Stream opened in binary mode
+		 */
+		void save(std::ostream& out) const;
+
+		/**
+		 * @brief Returns number of precomputed transfers
+		 *
+		 * @return Count of transfers
+		 */
+		size_t transferCount() const
+		{
+			return transfers_.size();
+		}
+
+		std::variant<path_t, std::string> findRoute(const std::vector<StopId>& start, const std::vector<StopId>& end, const Time_t departure) const override;
+	};
+}
+
+#endif // !TRIP_BASED_HPP_
@@ -1,7 +1,15 @@
 #include <gtest/gtest.h>
 #include <just_gtfs.h>
 #include <Algorithm.hpp>
+#include <CsvReader.hpp>
+#include <TripBased.hpp>
+#include <TransferPatterns.hpp>
 #include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <numbers>
+#include <filesystem>
 
 using namespace raptor;
 constexpr char feed_location[] = "example-data";
@@ -85,6 +93,1002 @@ TEST_P(RouteFinderTest, TestExampleData)
     out << '\n';
 }
 
+TEST_P(RouteFinderTest, TestWorkspaceReuse)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    const Time_t departure = 5*60*60;
+    auto starts = find_stops_by_name(start);
+    auto ends = find_stops_by_name(end);
+    QueryWorkspace workspace;
+    // dirty the workspace with a different query first
+    rf.findRoute(ends, starts, departure + 3*60*60, workspace);
+    auto reused = rf.findRoute(starts, ends, departure, workspace);
+    QueryWorkspace fresh;
+    auto expected = rf.findRoute(starts, ends, departure, fresh);
+    EXPECT_EQ(reused, expected);
+}
+
+TEST_P(RouteFinderTest, TestDateMatchesService)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    const Time_t departure = 5*60*60;
+    auto starts = find_stops_by_name(start);
+    auto ends = find_stops_by_name(end);
+    auto print = [&](auto&& result)
+    {
+        std::ostringstream str;
+        std::visit([&](auto&& arg)
+        {
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr (std::is_same_v<T, RouteFinder::result_t>)
+                str << std::tuple(arg, feed_, departure);
+            else if constexpr (std::is_same_v<T, std::string>)
+                str << arg;
+        }, result);
+        return str.str();
+    };
+    // on tuesday only service FULLW runs
+    const std::chrono::year_month_day tuesday = toDate("20070605");
+    const std::string by_service = print(rf.findRoute(starts, ends, departure));
+    // query with a date can also use trips of the next day
+    if (by_service != "End stop unreachable\n")
+    {
+        EXPECT_EQ(print(rf.findRoute(starts, ends, departure, tuesday)), by_service);
+    }
+    EXPECT_EQ(rf.findRoute(starts, ends, departure, toDate("20110101")), (std::variant<RouteFinder::result_t, std::string>("Date is outside of the feed validity period\n")));
+}
+
+TEST_P(RouteFinderTest, TestRangeMatchesSingleQueries)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    auto starts = find_stops_by_name(start);
+    auto ends = find_stops_by_name(end);
+    auto range = rf.findRoutes(starts, ends, 5*60*60, 13*60*60);
+    if (!std::holds_alternative<RouteFinder::profile_t>(range))
+        return;
+    auto&& journeys = std::get<RouteFinder::profile_t>(range);
+    for (auto&& journey : journeys)
+    {
+        for (auto&& other : journeys)
+        {
+            if (&other != &journey)
+            {
+                EXPECT_FALSE(other.departure >= journey.departure && other.arrival <= journey.arrival && other.transfers <= journey.transfers);
+            }
+        }
+        auto [last_stop, last_arrival] = std::get<std::pair<StopId, Time_t>>(journey.path.back());
+        EXPECT_EQ(journey.departure + last_arrival, journey.arrival);
+        // single query boards only trips departing strictly after its departure
+        auto single = rf.findRoute(starts, ends, journey.departure - 1);
+        ASSERT_TRUE(std::holds_alternative<RouteFinder::result_t>(single));
+        auto [stop, arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(single).back());
+        Time_t best = inf_time;
+        for (auto&& other : journeys)
+        {
+            if (other.departure >= journey.departure)
+                best = std::min(best, other.arrival);
+        }
+        EXPECT_EQ(journey.departure - 1 + arrival, best);
+    }
+}
+
+TEST_P(RouteFinderTest, TestParetoContainsFastest)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    const Time_t departure = 5*60*60;
+    auto starts = find_stops_by_name(start);
+    auto ends = find_stops_by_name(end);
+    auto pareto = rf.findParetoRoutes(starts, ends, departure);
+    auto fastest = rf.findRoute(starts, ends, departure);
+    ASSERT_EQ(pareto.index(), fastest.index());
+    if (std::holds_alternative<std::string>(fastest))
+    {
+        EXPECT_EQ(std::get<std::string>(pareto), std::get<std::string>(fastest));
+        return;
+    }
+    auto&& journeys = std::get<RouteFinder::pareto_t>(pareto);
+    ASSERT_FALSE(journeys.empty());
+    auto [stop, arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(fastest).back());
+    EXPECT_EQ(journeys.front().arrival, departure + arrival);
+    for (auto&& journey : journeys)
+    {
+        for (auto&& other : journeys)
+        {
+            if (&other != &journey)
+            {
+                EXPECT_FALSE(other.arrival <= journey.arrival && other.transfers <= journey.transfers && other.walking <= journey.walking);
+            }
+        }
+        auto [last_stop, last_arrival] = std::get<std::pair<StopId, Time_t>>(journey.path.back());
+        EXPECT_EQ(departure + last_arrival, journey.arrival);
+        const auto trips = std::ranges::count_if(journey.path, [](auto&& block) { return std::holds_alternative<RouteTraversal::trip_iterator>(block); });
+        EXPECT_EQ(trips, journey.transfers + 1);
+    }
+}
+
+TEST_P(RouteFinderTest, TestArriveByMatchesForward)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    const Time_t departure = 6*60*60;
+    auto starts = find_stops_by_name(start);
+    auto ends = find_stops_by_name(end);
+    auto forward = rf.findRoute(starts, ends, departure);
+    if (!std::holds_alternative<RouteFinder::result_t>(forward))
+        return;
+    auto [stop, arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(forward).back());
+    const Time_t latest_arrival = departure + arrival;
+    auto backward = rf.findRouteArriveBy(starts, ends, latest_arrival);
+    ASSERT_TRUE(std::holds_alternative<RouteFinder::Journey>(backward));
+    auto&& journey = std::get<RouteFinder::Journey>(backward);
+    // the forward journey leaves by a trip departing after `departure`, so the latest departure is not earlier
+    EXPECT_GT(journey.departure, departure);
+    EXPECT_LE(journey.arrival, latest_arrival);
+    auto [first_stop, first_time] = std::get<std::pair<StopId, Time_t>>(journey.path.front());
+    auto [last_stop, last_time] = std::get<std::pair<StopId, Time_t>>(journey.path.back());
+    EXPECT_EQ(first_time, 0);
+    EXPECT_EQ(journey.departure + last_time, journey.arrival);
+    auto again = rf.findRoute(starts, ends, journey.departure - 1);
+    ASSERT_TRUE(std::holds_alternative<RouteFinder::result_t>(again));
+    auto [again_stop, again_arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(again).back());
+    EXPECT_LE(journey.departure - 1 + again_arrival, latest_arrival);
+    auto latest = rf.latestDepartures(ends, latest_arrival);
+    Time_t best = undefined_time;
+    for (auto&& s : starts)
+        best = std::max(best, latest[s]);
+    EXPECT_EQ(best, journey.departure);
+}
+
+TEST_P(RouteFinderTest, TestArrivalsMatchSingleQueries)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    const Time_t departure = 6*60*60;
+    auto starts = find_stops_by_name(start);
+    auto ends = find_stops_by_name(end);
+    auto all = rf.earliestArrivals(starts, departure, true);
+    auto many = rf.earliestArrivals(starts, ends, departure, true);
+    ASSERT_EQ(all.arrivals.size(), feed_.get_stops().size());
+    ASSERT_EQ(many.arrivals.size(), ends.size());
+    ASSERT_EQ(many.trips.size(), ends.size());
+    for (auto&& s : starts)
+    {
+        EXPECT_EQ(all.arrivals[s], departure);
+        EXPECT_EQ(all.trips[s], 0);
+    }
+    for (size_t i = 0; i < ends.size(); ++i)
+    {
+        EXPECT_EQ(many.arrivals[i], all.arrivals[ends[i]]);
+        EXPECT_EQ(many.trips[i], all.trips[ends[i]]);
+    }
+    if (start == end)
+        return;
+    auto single = rf.findRoute(starts, ends, departure);
+    Time_t best = inf_time;
+    for (auto&& e : ends)
+        best = std::min(best, all.arrivals[e]);
+    if (std::holds_alternative<std::string>(single))
+    {
+        EXPECT_EQ(best, inf_time);
+        return;
+    }
+    auto [stop, arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(single).back());
+    EXPECT_EQ(best, departure + arrival);
+}
+
+TEST_P(RouteFinderTest, TestLanesMatchArrivals)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    auto starts = find_stops_by_name(start);
+    // more departures than lanes, so the last group is only partially used
+    std::vector<Time_t> departures;
+    for (size_t i = 0; i < lane_count + 3; ++i)
+        departures.push_back(5*60*60 + 7*60*i);
+    auto lanes = rf.earliestArrivalsForDepartures(starts, departures);
+    ASSERT_EQ(lanes.size(), departures.size());
+    for (size_t i = 0; i < departures.size(); ++i)
+    {
+        auto single = rf.earliestArrivals(starts, departures[i]);
+        EXPECT_EQ(lanes[i].arrivals, single.arrivals);
+    }
+}
+
+TEST_P(RouteFinderTest, TestConnectionScanMatchesRaptor)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    auto starts = find_stops_by_name(start);
+    auto ends = find_stops_by_name(end);
+    for (Time_t departure = 5*60*60; departure < 20*60*60; departure += 45*60)
+    {
+        rf.setEngine(Engine::Raptor);
+        auto raptor = rf.findRoute(starts, ends, departure);
+        rf.setEngine(Engine::ConnectionScan);
+        auto scan = rf.findRoute(starts, ends, departure);
+        ASSERT_EQ(raptor.index(), scan.index());
+        if (std::holds_alternative<std::string>(raptor))
+        {
+            EXPECT_EQ(std::get<std::string>(raptor), std::get<std::string>(scan));
+            continue;
+        }
+        auto [raptor_stop, raptor_arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(raptor).back());
+        auto [scan_stop, scan_arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(scan).back());
+        EXPECT_EQ(raptor_arrival, scan_arrival);
+        auto [first_stop, first_arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(scan).front());
+        EXPECT_NE(std::ranges::find(starts, first_stop), starts.end());
+        EXPECT_EQ(first_arrival, 0);
+    }
+}
+
+TEST_P(RouteFinderTest, TestTripBasedMatchesRaptor)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    auto starts = find_stops_by_name(start);
+    auto ends = find_stops_by_name(end);
+    for (Time_t departure = 5*60*60; departure < 20*60*60; departure += 45*60)
+    {
+        rf.setEngine(Engine::Raptor);
+        auto raptor = rf.findRoute(starts, ends, departure);
+        rf.setEngine(Engine::TripBased);
+        auto trip_based = rf.findRoute(starts, ends, departure);
+        ASSERT_EQ(raptor.index(), trip_based.index());
+        if (std::holds_alternative<std::string>(raptor))
+        {
+            EXPECT_EQ(std::get<std::string>(raptor), std::get<std::string>(trip_based));
+            continue;
+        }
+        auto&& path = std::get<RouteFinder::result_t>(trip_based);
+        auto [raptor_stop, raptor_arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(raptor).back());
+        auto [last_stop, last_arrival] = std::get<std::pair<StopId, Time_t>>(path.back());
+        EXPECT_EQ(raptor_arrival, last_arrival);
+        EXPECT_NE(std::ranges::find(ends, last_stop), ends.end());
+        auto [first_stop, first_arrival] = std::get<std::pair<StopId, Time_t>>(path.front());
+        EXPECT_NE(std::ranges::find(starts, first_stop), starts.end());
+        EXPECT_EQ(first_arrival, 0);
+    }
+}
+
+TEST_P(RouteFinderTest, TestTransferPatternsMatchRaptor)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    auto starts = find_stops_by_name(start);
+    auto ends = find_stops_by_name(end);
+    for (Time_t departure = 5*60*60; departure < 20*60*60; departure += 45*60)
+    {
+        rf.setEngine(Engine::Raptor);
+        auto raptor = rf.findRoute(starts, ends, departure);
+        rf.setEngine(Engine::TransferPatterns);
+        auto patterns = rf.findRoute(starts, ends, departure);
+        ASSERT_EQ(raptor.index(), patterns.index());
+        if (std::holds_alternative<std::string>(raptor))
+        {
+            EXPECT_EQ(std::get<std::string>(raptor), std::get<std::string>(patterns));
+            continue;
+        }
+        auto&& path = std::get<RouteFinder::result_t>(patterns);
+        auto [raptor_stop, raptor_arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(raptor).back());
+        auto [last_stop, last_arrival] = std::get<std::pair<StopId, Time_t>>(path.back());
+        EXPECT_EQ(raptor_arrival, last_arrival);
+        EXPECT_NE(std::ranges::find(ends, last_stop), ends.end());
+        auto [first_stop, first_arrival] = std::get<std::pair<StopId, Time_t>>(path.front());
+        EXPECT_NE(std::ranges::find(starts, first_stop), starts.end());
+        EXPECT_EQ(first_arrival, 0);
+    }
+}
+
+TEST_P(RouteFinderTest, TestGoalDirectedMatchesRaptor)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    auto starts = find_stops_by_name(start);
+    auto ends = find_stops_by_name(end);
+    const std::chrono::year_month_day tuesday = toDate("20070605");
+    auto arrival = [](const std::variant<RouteFinder::result_t, std::string>& result)
+    {
+        if (std::holds_alternative<std::string>(result))
+            return inf_time;
+        return std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(result).back()).second;
+    };
+    for (Time_t departure = 5*60*60; departure < 20*60*60; departure += 45*60)
+    {
+        rf.setGoalDirected(false);
+        auto plain = rf.findRoute(starts, ends, departure);
+        auto plain_on_date = rf.findRoute(starts, ends, departure, tuesday);
+        rf.setGoalDirected(true);
+        auto pruned = rf.findRoute(starts, ends, departure);
+        auto pruned_on_date = rf.findRoute(starts, ends, departure, tuesday);
+        ASSERT_EQ(plain.index(), pruned.index());
+        EXPECT_EQ(arrival(plain), arrival(pruned));
+        ASSERT_EQ(plain_on_date.index(), pruned_on_date.index());
+        EXPECT_EQ(arrival(plain_on_date), arrival(pruned_on_date));
+    }
+}
+
+TEST_P(RouteFinderTest, TestParallelScanMatchesSequential)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    auto&& [start, end] = GetParam();
+    auto starts = find_stops_by_name(start);
+    auto ends = find_stops_by_name(end);
+    const std::chrono::year_month_day tuesday = toDate("20070605");
+    auto print = [&](const std::variant<RouteFinder::result_t, std::string>& result, const Time_t departure)
+    {
+        std::ostringstream str;
+        if (std::holds_alternative<RouteFinder::result_t>(result))
+            str << std::tuple(std::get<RouteFinder::result_t>(result), feed_, departure);
+        else
+            str << std::get<std::string>(result);
+        return str.str();
+    };
+    for (Time_t departure = 5*60*60; departure < 20*60*60; departure += 45*60)
+    {
+        rf.setScanThreads(1);
+        auto sequential = print(rf.findRoute(starts, ends, departure), departure);
+        auto sequential_on_date = print(rf.findRoute(starts, ends, departure, tuesday), departure);
+        // every round is scanned in parallel
+        rf.setScanThreads(4, 1);
+        EXPECT_EQ(print(rf.findRoute(starts, ends, departure), departure), sequential);
+        EXPECT_EQ(print(rf.findRoute(starts, ends, departure, tuesday), departure), sequential_on_date);
+    }
+}
+
+TEST_F(RouteFinderTest, TestTripTransfersRoundTrip)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    std::stringstream saved(std::ios::in | std::ios::out | std::ios::binary);
+    rf.saveTripTransfers(saved);
+    auto starts = find_stops_by_name("Stagecoach Hotel & Casino (Demo)");
+    auto ends = find_stops_by_name("Nye County Airport (Demo)");
+    rf.setEngine(Engine::TripBased);
+    auto computed = rf.findRoute(starts, ends, 5*60*60);
+
+    RouteFinder loaded(&feed_);
+    loaded.setOptions(WalkingSpeed::Normal, "FULLW");
+    loaded.loadTripTransfers(saved);
+    auto from_file = loaded.findRoute(starts, ends, 5*60*60);
+    ASSERT_TRUE(std::holds_alternative<RouteFinder::result_t>(computed));
+    ASSERT_TRUE(std::holds_alternative<RouteFinder::result_t>(from_file));
+    auto&& computed_path = std::get<RouteFinder::result_t>(computed);
+    auto&& loaded_path = std::get<RouteFinder::result_t>(from_file);
+    ASSERT_EQ(computed_path.size(), loaded_path.size());
+    auto [computed_stop, computed_arrival] = std::get<std::pair<StopId, Time_t>>(computed_path.back());
+    auto [loaded_stop, loaded_arrival] = std::get<std::pair<StopId, Time_t>>(loaded_path.back());
+    EXPECT_EQ(computed_arrival, loaded_arrival);
+
+    // transfers depend on the walking speed
+    std::stringstream again(saved.str());
+    loaded.setOptions(WalkingSpeed::Slow, "FULLW");
+    EXPECT_THROW(loaded.loadTripTransfers(again), std::runtime_error);
+    std::stringstream truncated(saved.str().substr(0, saved.str().size() / 2));
+    loaded.setOptions(WalkingSpeed::Normal, "FULLW");
+    EXPECT_THROW(loaded.loadTripTransfers(truncated), std::runtime_error);
+}
+
+TEST_F(RouteFinderTest, TestTransferPatternsRoundTrip)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    rf.setEngine(Engine::TransferPatterns);
+    std::stringstream saved(std::ios::in | std::ios::out | std::ios::binary);
+    rf.saveTransferPatterns(saved);
+
+    RouteFinder loaded(&feed_);
+    loaded.setOptions(WalkingSpeed::Normal, "FULLW");
+    loaded.loadTransferPatterns(saved);
+    auto starts = find_stops_by_name("Stagecoach Hotel & Casino (Demo)");
+    auto ends = find_stops_by_name("Nye County Airport (Demo)");
+    for (Time_t departure = 5*60*60; departure < 8*60*60; departure += 30*60)
+    {
+        auto computed = rf.findRoute(starts, ends, departure);
+        auto from_file = loaded.findRoute(starts, ends, departure);
+        ASSERT_EQ(computed.index(), from_file.index());
+        if (std::holds_alternative<RouteFinder::result_t>(computed))
+        {
+            EXPECT_EQ(std::get<RouteFinder::result_t>(computed).size(), std::get<RouteFinder::result_t>(from_file).size());
+        }
+    }
+
+    // trip transfers are not transfer patterns
+    std::stringstream transfers(std::ios::in | std::ios::out | std::ios::binary);
+    rf.saveTripTransfers(transfers);
+    EXPECT_THROW(loaded.loadTransferPatterns(transfers), std::runtime_error);
+}
+
+TEST_F(RouteFinderTest, TestRangeOnDate)
+{
+    RouteFinder rf(&feed_);
+    IdTranslator::getInstance().lock();
+    // service WE runs on saturday
+    auto range = rf.findRoutes(find_stops_by_name("Nye County Airport (Demo)"), find_stops_by_name("Amargosa Valley (Demo)"), 0, seconds_per_day - 1, toDate("20070602"));
+    ASSERT_TRUE(std::holds_alternative<RouteFinder::profile_t>(range));
+    auto&& journeys = std::get<RouteFinder::profile_t>(range);
+    ASSERT_EQ(journeys.size(), 2);
+    EXPECT_EQ(journeys[0].departure, 8*60*60);
+    EXPECT_EQ(journeys[0].arrival, 9*60*60);
+    EXPECT_EQ(journeys[0].transfers, 0);
+    EXPECT_EQ(journeys[1].departure, 13*60*60);
+    EXPECT_EQ(journeys[1].arrival, 14*60*60);
+    EXPECT_EQ(std::get<0>(journeys[1].path.front()).second, 0);
+}
+
+TEST_F(RouteFinderTest, TestDateUsesNextDay)
+{
+    RouteFinder rf(&feed_);
+    IdTranslator::getInstance().lock();
+    const Time_t departure = 5*60*60;
+    auto result = rf.findRoute(find_stops_by_name("North Ave / D Ave N (Demo)"), find_stops_by_name("Nye County Airport (Demo)"), departure, toDate("20070605"));
+    ASSERT_TRUE(std::holds_alternative<RouteFinder::result_t>(result));
+    auto [stop, arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(result).back());
+    // the only trip to the airport leaves Stagecoach at 6:00, so it is taken on wednesday
+    EXPECT_EQ(departure + arrival, seconds_per_day + 6*60*60 + 20*60);
+}
+
+/**
+ * @brief Feed where the end stop is reached only by walking from a stop after a trip arrives there later than a walk
+ *
+ */
+class FootpathRuleTest : public testing::Test
+{
+protected:
+    gtfs::Feed feed_;
+    void SetUp() override
+    {
+        // ids of this feed must start from zero
+        IdTranslator::getInstance().reset();
+        feed_ = gtfs::Feed("footpath-data");
+        ASSERT_EQ(feed_.read_feed().code, gtfs::OK);
+    }
+
+    void TearDown() override
+    {
+        IdTranslator::getInstance().reset();
+    }
+
+    StopId stop(const std::string& id)
+    {
+        return IdTranslator::getInstance().at(id, IdTranslator::StopTag());
+    }
+};
+
+TEST_F(FootpathRuleTest, WalkStartsFromEveryArrivalByTrip)
+{
+    RouteFinder rf(&feed_);
+    rf.setOptions(WalkingSpeed::Normal, "FULLW");
+    IdTranslator::getInstance().lock();
+    const std::vector<StopId> starts{ stop("S") };
+    const std::vector<StopId> ends{ stop("Y") };
+    const Time_t departure = 7*60*60 + 55*60;
+    // Middle is reached at 8:19 by a walk from Walk Start, End only by a walk after the trip arriving to Middle at 8:30
+    auto raptor = rf.findRoute(starts, ends, departure);
+    ASSERT_TRUE(std::holds_alternative<RouteFinder::result_t>(raptor));
+    auto&& path = std::get<RouteFinder::result_t>(raptor);
+    ASSERT_GE(path.size(), 2);
+    auto [walk_from, walk_start] = std::get<std::pair<StopId, Time_t>>(path[path.size() - 2]);
+    auto [end, arrival] = std::get<std::pair<StopId, Time_t>>(path.back());
+    EXPECT_EQ(walk_from, stop("X"));
+    EXPECT_EQ(departure + walk_start, 8*60*60 + 30*60);
+    EXPECT_EQ(end, stop("Y"));
+
+    for (auto&& engine : { Engine::ConnectionScan, Engine::TripBased, Engine::TransferPatterns })
+    {
+        rf.setEngine(engine);
+        auto other = rf.findRoute(starts, ends, departure);
+        ASSERT_TRUE(std::holds_alternative<RouteFinder::result_t>(other));
+        auto [other_end, other_arrival] = std::get<std::pair<StopId, Time_t>>(std::get<RouteFinder::result_t>(other).back());
+        EXPECT_EQ(other_arrival, arrival);
+    }
+    rf.setEngine(Engine::Raptor);
+
+    // the other RAPTOR searches follow the same rule
+    EXPECT_EQ(rf.earliestArrivals(starts, departure).arrivals[stop("Y")], departure + arrival);
+    EXPECT_EQ(rf.earliestArrivalsForDepartures(starts, { departure })[0].arrivals[stop("Y")], departure + arrival);
+    auto range = rf.findRoutes(starts, ends, departure, 8*60*60);
+    ASSERT_TRUE(std::holds_alternative<RouteFinder::profile_t>(range));
+    ASSERT_EQ(std::get<RouteFinder::profile_t>(range).size(), 1);
+    EXPECT_EQ(std::get<RouteFinder::profile_t>(range)[0].arrival, departure + arrival);
+    auto pareto = rf.findParetoRoutes(starts, ends, departure);
+    ASSERT_TRUE(std::holds_alternative<RouteFinder::pareto_t>(pareto));
+    ASSERT_EQ(std::get<RouteFinder::pareto_t>(pareto).size(), 1);
+    EXPECT_EQ(std::get<RouteFinder::pareto_t>(pareto)[0].arrival, departure + arrival);
+}
+
+TEST(ServiceCalendarTest, WeekdaysAndExceptions)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(feed.read_feed().code, gtfs::OK);
+    GTFSFeedParser::parseFeed(feed);
+    IdTranslator::getInstance().lock();
+    ServiceCalendar calendar(feed);
+    const ServiceId full_week = IdTranslator::getInstance().at("FULLW", IdTranslator::ServiceTag());
+    const ServiceId weekend = IdTranslator::getInstance().at("WE", IdTranslator::ServiceTag());
+    EXPECT_EQ(calendar.dayCount(), 4*365 + 1);
+    EXPECT_FALSE(calendar.dayIndex(toDate("20061231")).has_value());
+    EXPECT_FALSE(calendar.dayIndex(toDate("20110101")).has_value());
+    ASSERT_EQ(calendar.dayIndex(toDate("20070101")), 0);
+    const size_t saturday = calendar.dayIndex(toDate("20070602")).value();
+    const size_t monday = calendar.dayIndex(toDate("20070604")).value();
+    const size_t tuesday = calendar.dayIndex(toDate("20070605")).value();
+    EXPECT_TRUE(calendar.isActive(full_week, saturday));
+    EXPECT_TRUE(calendar.isActive(weekend, saturday));
+    // removed in calendar_dates.txt
+    EXPECT_FALSE(calendar.isActive(full_week, monday));
+    EXPECT_TRUE(calendar.isActive(full_week, tuesday));
+    EXPECT_FALSE(calendar.isActive(weekend, tuesday));
+}
+
+TEST(RouteTraversalTest, EarliestTripMatchesLinearScan)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(feed.read_feed().code, gtfs::OK);
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed);
+    IdTranslator::getInstance().lock();
+    RouteTraversal rt = std::move(rd);
+    const ServiceId service = IdTranslator::getInstance().at("FULLW", IdTranslator::ServiceTag());
+    for (size_t route = 0; route < rt.size(); ++route)
+    {
+        auto stops = rt.getStops(route);
+        for (auto stop_iter = stops.begin(); stop_iter != stops.end(); ++stop_iter)
+        {
+            const size_t stop_index = stop_iter - stops.begin();
+            for (Time_t time = 0; time < 24*60*60; time += 15*60)
+            {
+                auto&& [first, last] = rt.getTripsFromStop(route, stop_iter);
+                auto expected = std::find_if(first, last, [&](const Trip& t) { return t.departure > time && t.sId == service; });
+                auto found = rt.findEarliestTrip(route, stop_index, time, service);
+                if (expected == last)
+                    EXPECT_EQ(found, undefined_trip);
+                else
+                    EXPECT_EQ(found, RouteTraversal::trip_iterator(expected));
+            }
+        }
+    }
+}
+
+TEST(RouteTraversalTest, ServiceTimetableKeepsOnlyServiceTrips)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(feed.read_feed().code, gtfs::OK);
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed);
+    IdTranslator::getInstance().lock();
+    RouteTraversal rt = std::move(rd);
+    Stops stops = std::move(sd);
+    const ServiceId service = IdTranslator::getInstance().at("WE", IdTranslator::ServiceTag());
+    ServiceTimetable timetable(rt, stops, service);
+    ASSERT_EQ(timetable.routes.size(), rt.size());
+    size_t kept_trips = 0;
+    for (size_t route = 0; route < rt.size(); ++route)
+    {
+        for (auto&& trip : timetable.routes.getTrips(route))
+        {
+            EXPECT_EQ(trip.sId, service);
+            ++kept_trips;
+        }
+        size_t expected_trips = 0;
+        for (auto&& trip : rt.getTrips(route))
+            expected_trips += trip.sId == service;
+        EXPECT_EQ(timetable.routes[route].trip_count, expected_trips);
+    }
+    EXPECT_GT(kept_trips, 0);
+    for (size_t stop = 0; stop < stops.size(); ++stop)
+    {
+        for (auto&& [route, stop_index] : timetable.stops.getRoutes(stop))
+        {
+            EXPECT_GT(timetable.routes[route].trip_count, 0);
+            EXPECT_EQ(*(timetable.routes.getStops(route).begin() + stop_index), StopId(stop));
+        }
+    }
+}
+
+TEST(RouteTraversalTest, TimelineCopiesTripsToFollowingDays)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(feed.read_feed().code, gtfs::OK);
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed);
+    IdTranslator::getInstance().lock();
+    RouteTraversal rt = std::move(rd);
+    const size_t service_count = IdTranslator::getInstance().service_count();
+    RouteTraversal timeline(rt, 3, service_count);
+    ASSERT_EQ(timeline.size(), rt.size());
+    for (size_t route = 0; route < rt.size(); ++route)
+    {
+        // no trip of the feed runs after midnight, so copies of the previous day are dropped
+        ASSERT_EQ(timeline[route].trips(), 2 * rt[route].trips());
+        for (size_t trip = 0; trip < rt[route].trips(); ++trip)
+        {
+            for (size_t stop = 0; stop < rt[route].stops_count; ++stop)
+            {
+                const Trip& original = *rt.tripAt(route, trip, stop);
+                const Trip& today = *timeline.tripAt(route, trip, stop);
+                const Trip& tomorrow = *timeline.tripAt(route, trip + rt[route].trips(), stop);
+                EXPECT_EQ(today.departure, original.departure);
+                EXPECT_EQ(today.sId, original.sId + service_count);
+                EXPECT_EQ(tomorrow.departure, original.departure + seconds_per_day);
+                EXPECT_EQ(tomorrow.sId, original.sId + 2 * service_count);
+                EXPECT_EQ(tomorrow.tId, original.tId);
+            }
+        }
+    }
+}
+
+TEST(RouteTraversalTest, TimelineRejectsTooManyServices)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(feed.read_feed().code, gtfs::OK);
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed);
+    IdTranslator::getInstance().lock();
+    RouteTraversal rt = std::move(rd);
+    // services of the last copy would not fit to `ServiceId`
+    const size_t service_stride = std::numeric_limits<ServiceId::value_type>::max() / 2;
+    EXPECT_THROW(RouteTraversal(rt, 3, service_stride), std::runtime_error);
+    EXPECT_NO_THROW(RouteTraversal(rt, 2, service_stride));
+}
+
+TEST(TripBasedTest, SavedTransfersNeedTheSameTimetable)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(feed.read_feed().code, gtfs::OK);
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed);
+    IdTranslator::getInstance().lock();
+    RouteTraversal rt = std::move(rd);
+    Stops stops = std::move(sd);
+    ServiceTimetable timetable(rt, stops, IdTranslator::getInstance().at("FULLW", IdTranslator::ServiceTag()));
+    std::stringstream saved(std::ios::in | std::ios::out | std::ios::binary);
+    TripBasedEngine(timetable.routes, timetable.stops, WalkingSpeed::Normal).save(saved);
+    std::stringstream again(saved.str());
+    EXPECT_NO_THROW(TripBasedEngine(timetable.routes, timetable.stops, WalkingSpeed::Normal, again));
+    // the reversed timetable has the same number of trips and stop events, but other times
+    ReversedTimetable reversed(timetable.routes, timetable.stops);
+    EXPECT_THROW(TripBasedEngine(reversed.routes, reversed.stops, WalkingSpeed::Normal, saved), std::runtime_error);
+}
+
+TEST(TransferPatternsTest, SavedPatternsNeedTheSameTimetable)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(feed.read_feed().code, gtfs::OK);
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed);
+    IdTranslator::getInstance().lock();
+    RouteTraversal rt = std::move(rd);
+    Stops stops = std::move(sd);
+    ServiceTimetable timetable(rt, stops, IdTranslator::getInstance().at("FULLW", IdTranslator::ServiceTag()));
+    std::stringstream saved(std::ios::in | std::ios::out | std::ios::binary);
+    TransferPatternsEngine(timetable.routes, timetable.stops, WalkingSpeed::Normal).save(saved);
+    std::stringstream again(saved.str());
+    EXPECT_NO_THROW(TransferPatternsEngine(timetable.routes, timetable.stops, WalkingSpeed::Normal, again));
+    // the reversed timetable has the same stops, but other times
+    ReversedTimetable reversed(timetable.routes, timetable.stops);
+    EXPECT_THROW(TransferPatternsEngine(reversed.routes, reversed.stops, WalkingSpeed::Normal, saved), std::runtime_error);
+}
+
+TEST(RouteTraversalTest, ReversedTraversalMirrorsTrips)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(feed.read_feed().code, gtfs::OK);
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed);
+    IdTranslator::getInstance().lock();
+    RouteTraversal rt = std::move(rd);
+    Stops stops = std::move(sd);
+    ReversedTimetable reversed(rt, stops);
+    ASSERT_EQ(reversed.routes.size(), rt.size());
+    for (size_t route = 0; route < rt.size(); ++route)
+    {
+        const size_t trips = rt[route].trips();
+        const size_t stops_count = rt[route].stops_count;
+        ASSERT_EQ(reversed.routes[route].trips(), trips);
+        for (size_t trip = 0; trip < trips; ++trip)
+        {
+            for (size_t stop = 0; stop < stops_count; ++stop)
+            {
+                auto original = rt.tripAt(route, trips - 1 - trip, stops_count - 1 - stop);
+                auto mirrored = reversed.routes.tripAt(route, trip, stop);
+                EXPECT_EQ(mirrored->tId, original->tId);
+                EXPECT_EQ(ReversedTimetable::toForward(mirrored->departure), original->arrival);
+                EXPECT_EQ(ReversedTimetable::toForward(mirrored->arrival), original->departure);
+                EXPECT_EQ(reversed.routes.routeOf(mirrored), RouteId(route));
+                if (stop + 1 < stops_count)
+                {
+                    // boarded at `stop` in reversed time means left there in forward time
+                    auto boarding = rt.tripAt(route, trips - 1 - trip, stops_count - 2 - stop);
+                    EXPECT_EQ(reversed.forwardTrip(rt, mirrored, boarding->stopId), boarding);
+                }
+            }
+        }
+    }
+    for (size_t stop = 0; stop < stops.size(); ++stop)
+    {
+        for (auto&& [route, stop_index] : reversed.stops.getRoutes(stop))
+            EXPECT_EQ(*(reversed.routes.getStops(route).begin() + stop_index), StopId(stop));
+    }
+}
+
+TEST(StopsTest, TransfersMatchAllPairs)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(feed.read_feed().code, gtfs::OK);
+    // stops of the example feed are far apart, a wide radius gives enough transfers
+    constexpr double radius = 20;
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed, radius);
+    IdTranslator::getInstance().lock();
+    Stops stops = std::move(sd);
+    auto&& feed_stops = feed.get_stops();
+    auto distance = [](const gtfs::Stop& a, const gtfs::Stop& b)
+    {
+        constexpr double to_radians = std::numbers::pi / 180;
+        const double dlat = (b.stop_lat - a.stop_lat) * to_radians;
+        const double dlon = (b.stop_lon - a.stop_lon) * to_radians;
+        const double h = std::pow(std::sin(dlat / 2), 2) + std::cos(a.stop_lat * to_radians) * std::cos(b.stop_lat * to_radians) * std::pow(std::sin(dlon / 2), 2);
+        return 2 * std::asin(std::sqrt(h)) * 6371;
+    };
+    size_t transfer_count = 0;
+    for (size_t from = 0; from < feed_stops.size(); ++from)
+    {
+        std::vector<size_t> expected;
+        for (size_t to = 0; to < feed_stops.size(); ++to)
+        {
+            if (to != from && distance(feed_stops[from], feed_stops[to]) < radius)
+                expected.push_back(to);
+        }
+        std::vector<size_t> found;
+        for (auto&& transfer : stops.getTransfers(from))
+        {
+            found.push_back(transfer.target_stop);
+            EXPECT_NEAR(transfer.distance, distance(feed_stops[from], feed_stops[transfer.target_stop]), 1e-9);
+        }
+        EXPECT_EQ(found, expected);
+        transfer_count += found.size();
+    }
+    EXPECT_GT(transfer_count, 0);
+}
+
+TEST(StopTimesTest, StreamedMatchesFeed)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(feed.read_feed().code, gtfs::OK);
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed);
+    IdTranslator::getInstance().lock();
+    gtfs::Feed partial(feed_location);
+    ASSERT_EQ(GTFSFeedParser::readFeed(partial).code, gtfs::OK);
+    EXPECT_TRUE(partial.get_stop_times().empty());
+    std::ifstream stop_times(std::string(feed_location) + "/stop_times.txt");
+    auto [streamed_rd, streamed_sd] = GTFSFeedParser::parseFeed(partial, stop_times);
+    EXPECT_EQ(std::get<1>(streamed_rd), std::get<1>(rd));
+    EXPECT_EQ(std::get<2>(streamed_rd), std::get<2>(rd));
+    auto&& routes = std::get<0>(rd);
+    auto&& streamed_routes = std::get<0>(streamed_rd);
+    ASSERT_EQ(streamed_routes.size(), routes.size());
+    for (size_t route = 0; route < routes.size(); ++route)
+    {
+        auto&& trips = routes[route].second;
+        auto&& streamed_trips = streamed_routes[route].second;
+        ASSERT_EQ(streamed_trips.size(), trips.size());
+        for (size_t trip = 0; trip < trips.size(); ++trip)
+        {
+            EXPECT_EQ(streamed_trips[trip].first, trips[trip].first);
+            ASSERT_EQ(streamed_trips[trip].second.size(), trips[trip].second.size());
+            for (size_t block = 0; block < trips[trip].second.size(); ++block)
+            {
+                auto&& expected = trips[trip].second[block];
+                auto&& streamed = streamed_trips[trip].second[block];
+                EXPECT_EQ(streamed.sId, expected.sId);
+                EXPECT_EQ(streamed.service, expected.service);
+                EXPECT_EQ(streamed.arrival, expected.arrival);
+                EXPECT_EQ(streamed.departure, expected.departure);
+            }
+        }
+    }
+    EXPECT_EQ(std::get<0>(streamed_sd).size(), std::get<0>(sd).size());
+    EXPECT_EQ(std::get<1>(streamed_sd), std::get<1>(sd));
+    EXPECT_EQ(std::get<2>(streamed_sd), std::get<2>(sd));
+}
+
+TEST(StopTimesTest, StreamedRowsAreParsed)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(GTFSFeedParser::readFeed(feed).code, gtfs::OK);
+    // byte order mark, quoted ids, Windows line ends and a time after midnight
+    std::istringstream stop_times("\xEF\xBB\xBFtrip_id,arrival_time,departure_time,stop_id,stop_sequence\r\n"
+                                  "\"STBA\",25:20:00,25:20:00,\"BEATTY_AIRPORT\",2\r\n"
+                                  "STBA,25:00:00,25:01:00,STAGECOACH,1\r\n");
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed, stop_times);
+    IdTranslator::getInstance().lock();
+    auto tr = IdTranslator::getInstance;
+    const TripId trip = tr().at("STBA", IdTranslator::TripTag());
+    size_t found = 0;
+    for (auto&& [route, trips] : std::get<0>(rd))
+    {
+        for (auto&& [tId, blocks] : trips)
+        {
+            if (tId != trip)
+                continue;
+            ++found;
+            ASSERT_EQ(blocks.size(), 2);
+            EXPECT_EQ(blocks[0].sId, tr().at("STAGECOACH", IdTranslator::StopTag()));
+            EXPECT_EQ(blocks[0].departure, 25*60*60 + 60);
+            EXPECT_EQ(blocks[1].sId, tr().at("BEATTY_AIRPORT", IdTranslator::StopTag()));
+            EXPECT_EQ(blocks[1].arrival, 25*60*60 + 20*60);
+        }
+    }
+    EXPECT_EQ(found, 1);
+    std::istringstream missing_column("trip_id,stop_id,stop_sequence\nSTBA,STAGECOACH,1\n");
+    EXPECT_THROW(GTFSFeedParser::parseFeed(feed, missing_column), std::runtime_error);
+    std::istringstream unknown_stop("trip_id,arrival_time,departure_time,stop_id,stop_sequence\nSTBA,6:00:00,6:00:00,NOWHERE,1\n");
+    EXPECT_THROW(GTFSFeedParser::parseFeed(feed, unknown_stop), std::runtime_error);
+}
+
+TEST(StopTimesTest, EmptyTimesAreInterpolated)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(GTFSFeedParser::readFeed(feed).code, gtfs::OK);
+    // NANAA has only its arrival, NADAV is not a timepoint
+    const std::string text = "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n"
+                             "CITY1,6:00:00,6:00:00,STAGECOACH,1\n"
+                             "CITY1,6:05:00,,NANAA,2\n"
+                             "CITY1,,,NADAV,3\n"
+                             "CITY1,6:19:00,6:21:00,DADAN,4\n"
+                             "CITY1,6:26:00,6:28:00,EMSI,5\n";
+    std::istringstream stop_times(text);
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed, stop_times);
+    IdTranslator::getInstance().lock();
+    auto tr = IdTranslator::getInstance;
+    const TripId trip = tr().at("CITY1", IdTranslator::TripTag());
+    size_t found = 0;
+    Time_t interpolated = undefined_time;
+    for (auto&& [route, trips] : std::get<0>(rd))
+    {
+        for (auto&& [tId, blocks] : trips)
+        {
+            if (tId != trip)
+                continue;
+            ++found;
+            ASSERT_EQ(blocks.size(), 5);
+            interpolated = blocks[2].arrival;
+            EXPECT_EQ(blocks[1].departure, 6*60*60 + 5*60);
+            EXPECT_EQ(blocks[2].sId, tr().at("NADAV", IdTranslator::StopTag()));
+            EXPECT_EQ(blocks[2].arrival, blocks[2].departure);
+            EXPECT_GT(blocks[2].arrival, blocks[1].departure);
+            EXPECT_LT(blocks[2].arrival, blocks[3].arrival);
+        }
+    }
+    EXPECT_EQ(found, 1);
+    // stop times read from a mapped file get the same times
+    const std::filesystem::path path = "empty-times.txt";
+    std::ofstream(path) << text;
+    auto [mapped_rd, mapped_sd] = GTFSFeedParser::parseFeed(feed, path);
+    std::filesystem::remove(path);
+    for (auto&& [route, trips] : std::get<0>(mapped_rd))
+    {
+        for (auto&& [tId, blocks] : trips)
+        {
+            if (tId == trip)
+            {
+                EXPECT_EQ(blocks[2].arrival, interpolated);
+            }
+        }
+    }
+    // a trip can't start or end at an unknown time
+    std::istringstream no_start("trip_id,arrival_time,departure_time,stop_id,stop_sequence\n"
+                                "STBA,,,STAGECOACH,1\n"
+                                "STBA,6:20:00,6:20:00,BEATTY_AIRPORT,2\n");
+    EXPECT_THROW(GTFSFeedParser::parseFeed(feed, no_start), std::runtime_error);
+}
+
+TEST(StopTimesTest, MappedMatchesStreamed)
+{
+    gtfs::Feed feed(feed_location);
+    ASSERT_EQ(GTFSFeedParser::readFeed(feed).code, gtfs::OK);
+    const std::string path = std::string(feed_location) + "/stop_times.txt";
+    std::ifstream stop_times(path);
+    auto [rd, sd] = GTFSFeedParser::parseFeed(feed, stop_times);
+    IdTranslator::getInstance().lock();
+    auto [mapped_rd, mapped_sd] = GTFSFeedParser::parseFeed(feed, std::filesystem::path(path));
+    EXPECT_EQ(std::get<1>(mapped_rd), std::get<1>(rd));
+    EXPECT_EQ(std::get<2>(mapped_rd), std::get<2>(rd));
+    auto&& routes = std::get<0>(rd);
+    auto&& mapped_routes = std::get<0>(mapped_rd);
+    ASSERT_EQ(mapped_routes.size(), routes.size());
+    for (size_t route = 0; route < routes.size(); ++route)
+    {
+        auto&& trips = routes[route].second;
+        auto&& mapped_trips = mapped_routes[route].second;
+        ASSERT_EQ(mapped_trips.size(), trips.size());
+        for (size_t trip = 0; trip < trips.size(); ++trip)
+        {
+            EXPECT_EQ(mapped_trips[trip].first, trips[trip].first);
+            ASSERT_EQ(mapped_trips[trip].second.size(), trips[trip].second.size());
+            for (size_t block = 0; block < trips[trip].second.size(); ++block)
+            {
+                EXPECT_EQ(mapped_trips[trip].second[block].sId, trips[trip].second[block].sId);
+                EXPECT_EQ(mapped_trips[trip].second[block].arrival, trips[trip].second[block].arrival);
+                EXPECT_EQ(mapped_trips[trip].second[block].departure, trips[trip].second[block].departure);
+            }
+        }
+    }
+    EXPECT_THROW(GTFSFeedParser::parseFeed(feed, std::filesystem::path("no-such-feed/stop_times.txt")), std::runtime_error);
+}
+
+TEST(CsvReaderTest, MatchesStreamReaderOnAllLevels)
+{
+    // quoted separators, rows crossing blocks, a quote crossing a block, empty fields and no newline at the end
+    std::string text = "a,\"b,c\",d\r\n\n\"x\"\"y\",,\n";
+    text += std::string(70, 'l') + ",\"" + std::string(60, 'q') + ",\n" + std::string(10, 'q') + "\",end\n";
+    for (size_t i = 0; i < 20; ++i)
+        text += "STBA,6:00:00,6:00:00,STAGECOACH," + std::to_string(i) + "\n";
+    text += "last,row";
+    std::vector<std::vector<std::string>> expected;
+    {
+        // the stream reader can't read newlines in quotes, so it reads rows split by the reader in memory
+        CsvReader reader(text, SimdLevel::Scalar);
+        std::vector<std::string_view> fields;
+        while (reader.next(fields))
+            expected.emplace_back(fields.begin(), fields.end());
+    }
+    ASSERT_EQ(expected.size(), 25);
+    EXPECT_EQ(expected[0], (std::vector<std::string>{ "a", "b,c", "d" }));
+    EXPECT_EQ(expected[1], (std::vector<std::string>{ "" }));
+    EXPECT_EQ(expected[2], (std::vector<std::string>{ "x\"\"y", "", "" }));
+    EXPECT_EQ(expected[3], (std::vector<std::string>{ std::string(70, 'l'), std::string(60, 'q') + ",\n" + std::string(10, 'q'), "end" }));
+    EXPECT_EQ(expected.back(), (std::vector<std::string>{ "last", "row" }));
+    for (auto level : { SimdLevel::SSE, SimdLevel::AVX2 })
+    {
+        if (level > detectSimdLevel())
+            continue;
+        CsvReader reader(text, level);
+        std::vector<std::string_view> fields;
+        for (auto&& row : expected)
+        {
+            ASSERT_TRUE(reader.next(fields));
+            EXPECT_EQ(std::vector<std::string>(fields.begin(), fields.end()), row);
+        }
+        EXPECT_FALSE(reader.next(fields));
+    }
+    std::string without_quoted_newline = text;
+    without_quoted_newline.erase(without_quoted_newline.find(",\n" + std::string(10, 'q')), 2);
+    std::istringstream in(without_quoted_newline);
+    CsvStreamReader stream_reader(in);
+    CsvReader reader(without_quoted_newline);
+    std::vector<std::string_view> fields, stream_fields;
+    while (reader.next(fields))
+    {
+        ASSERT_TRUE(stream_reader.next(stream_fields));
+        EXPECT_EQ(stream_fields, fields);
+        EXPECT_EQ(stream_reader.line(), reader.line());
+    }
+    EXPECT_FALSE(stream_reader.next(stream_fields));
+}
+
 std::string removeSpaces(const std::string& str)
 {
     std::string result = "";
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <SimdKernels.hpp>
+#include <random>
+#include <vector>
+
+using namespace raptor;
+
+TEST(SimdKernelsTest, FindFirstGreaterMatchesScalar)
+{
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<Time_t> times(0, 48*60*60);
+    const auto best = detectSimdLevel();
+    for (size_t count : { 0, 1, 3, 4, 7, 8, 9, 31, 33, 200, 257 })
+    {
+        std::vector<Time_t> data(count);
+        for (auto&& t : data)
+            t = times(generator);
+        for (int i = 0; i < 50; ++i)
+        {
+            const Time_t time = times(generator);
+            const size_t expected = findFirstGreater(SimdLevel::Scalar, data.data(), count, time);
+            for (auto level : { SimdLevel::SSE, SimdLevel::AVX2 })
+            {
+                if (level > best)
+                    continue;
+                EXPECT_EQ(findFirstGreater(level, data.data(), count, time), expected);
+            }
+            EXPECT_EQ(findFirstGreater(data.data(), count, time), expected);
+        }
+    }
+}
+
+TEST(SimdKernelsTest, LaneKernelsMatchScalar)
+{
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<Time_t> times(-24*60*60, 48*60*60);
+    for (int i = 0; i < 200; ++i)
+    {
+        TimeLanes a;
+        TimeLanes b;
+        for (size_t lane = 0; lane < lane_count; ++lane)
+        {
+            a[lane] = times(generator);
+            // some lanes are equal or unreached
+            b[lane] = lane % 3 == 0 ? a[lane] : lane % 5 == 0 ? inf_time : times(generator);
+        }
+        LaneMask expected_mask = 0;
+        TimeLanes expected_min;
+        for (size_t lane = 0; lane < lane_count; ++lane)
+        {
+            expected_mask |= LaneMask(a[lane] < b[lane]) << lane;
+            expected_min[lane] = std::min(a[lane], b[lane]);
+        }
+        EXPECT_EQ(lessLanes(a, b), expected_mask);
+        minLanes(a, b);
+        EXPECT_EQ(a, expected_min);
+    }
+}
+
+TEST(SimdKernelsTest, ClassifyCsvBlockMatchesCharacters)
+{
+    std::mt19937 generator(11);
+    const char alphabet[] = "ab1:\",\n\r ";
+    std::uniform_int_distribution<size_t> character(0, sizeof(alphabet) - 2);
+    const auto best = detectSimdLevel();
+    for (int i = 0; i < 100; ++i)
+    {
+        char block[csv_block_size];
+        CsvBlockMasks expected{ 0, 0, 0 };
+        for (size_t j = 0; j < csv_block_size; ++j)
+        {
+            block[j] = alphabet[character(generator)];
+            expected.quotes |= uint64_t(block[j] == '"') << j;
+            expected.commas |= uint64_t(block[j] == ',') << j;
+            expected.newlines |= uint64_t(block[j] == '\n') << j;
+        }
+        for (auto level : { SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2 })
+        {
+            if (level > best)
+                continue;
+            auto masks = classifyCsvBlock(level, block);
+            EXPECT_EQ(masks.quotes, expected.quotes);
+            EXPECT_EQ(masks.commas, expected.commas);
+            EXPECT_EQ(masks.newlines, expected.newlines);
+        }
+    }
+}
+
+#ifdef RAPTOR_NO_SIMD
+TEST(SimdKernelsTest, NoSimdBuildUsesScalarKernels)
+{
+    EXPECT_EQ(detectSimdLevel(), SimdLevel::Scalar);
+}
+#endif